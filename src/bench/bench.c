@@ -0,0 +1,751 @@
+/* headless micro-benchmarks for the T3F hot paths
+
+   every benchmark builds its own data in memory so the results only depend
+   on the code being measured, run with --json for JSON output, --output to
+   write to a file, --filter to run benchmarks whose names contain a string
+   and --scale to multiply the iteration counts */
+
+#include "t3f/t3f.h"
+#include "t3logo.h"
+
+#define BENCH_WIDTH  1280
+#define BENCH_HEIGHT  720
+
+#define BENCH_OUTPUT_CSV  0
+#define BENCH_OUTPUT_JSON 1
+
+typedef struct
+{
+
+	const char * name;
+	bool (*setup)(void ** data);
+	void (*run)(void * data, int iteration);
+	void (*cleanup)(void * data);
+	int iterations;
+	int ops; // operations run performs each iteration
+
+} BENCH_TEST;
+
+typedef struct
+{
+
+	const BENCH_TEST * test;
+	int iterations;
+	double mean;
+	double median;
+	double min;
+	double max;
+
+} BENCH_RESULT;
+
+/* deterministic data so every build measures the same work */
+static T3F_RNG_STATE bench_rng;
+
+static ALLEGRO_BITMAP * create_test_bitmap(int w, int h)
+{
+	ALLEGRO_BITMAP * bp;
+	ALLEGRO_STATE old_state;
+	int i;
+
+	bp = al_create_bitmap(w, h);
+	if(!bp)
+	{
+		return NULL;
+	}
+	al_store_state(&old_state, ALLEGRO_STATE_TARGET_BITMAP);
+	al_set_target_bitmap(bp);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	for(i = 0; i < 8; i++)
+	{
+		al_draw_filled_rectangle(t3f_random(&bench_rng, w), t3f_random(&bench_rng, h), t3f_random(&bench_rng, w), t3f_random(&bench_rng, h), al_map_rgba(t3f_random(&bench_rng, 256), t3f_random(&bench_rng, 256), t3f_random(&bench_rng, 256), 255));
+	}
+	al_restore_state(&old_state);
+	return bp;
+}
+
+/* write data to a memory file so loaders can be timed without disk access */
+static ALLEGRO_FILE * create_memory_file(void ** buffer, int64_t size)
+{
+	*buffer = malloc(size);
+	if(!*buffer)
+	{
+		return NULL;
+	}
+	return al_open_memfile(*buffer, size, "rw");
+}
+
+/* logo */
+static bool setup_logo(void ** data)
+{
+	*data = t3logo_create(T3LOGO_FLAG_SILENT);
+	return *data;
+}
+
+static void run_logo(void * data, int iteration)
+{
+	T3LOGO * lp = (T3LOGO *)data;
+	int i;
+
+	for(i = 0; i < 100; i++)
+	{
+		lp->angle += 0.01;
+		lp->tilt = sin(lp->angle) * 0.5;
+		t3logo_update(lp);
+	}
+}
+
+static void cleanup_logo(void * data)
+{
+	t3logo_destroy((T3LOGO *)data);
+}
+
+/* tilemap */
+typedef struct
+{
+
+	ALLEGRO_BITMAP * target;
+	T3F_TILESET * tileset;
+	T3F_TILEMAP * tilemap;
+
+} BENCH_TILEMAP_DATA;
+
+static void cleanup_tilemap(void * data)
+{
+	BENCH_TILEMAP_DATA * dp = (BENCH_TILEMAP_DATA *)data;
+
+	if(dp->tilemap)
+	{
+		t3f_destroy_tilemap(dp->tilemap);
+	}
+	if(dp->tileset)
+	{
+		t3f_destroy_tileset(dp->tileset);
+	}
+	if(dp->target)
+	{
+		al_destroy_bitmap(dp->target);
+	}
+	free(dp);
+}
+
+static bool setup_tilemap(void ** data)
+{
+	BENCH_TILEMAP_DATA * dp;
+	T3F_ANIMATION * ap;
+	ALLEGRO_BITMAP * bp;
+	int i, j;
+
+	dp = malloc(sizeof(BENCH_TILEMAP_DATA));
+	if(!dp)
+	{
+		return false;
+	}
+	memset(dp, 0, sizeof(BENCH_TILEMAP_DATA));
+	*data = dp;
+	dp->target = al_create_bitmap(BENCH_WIDTH, BENCH_HEIGHT);
+	dp->tileset = t3f_create_tileset(16, 16);
+	dp->tilemap = t3f_create_tilemap(256, 256, 1);
+	if(!dp->target || !dp->tileset || !dp->tilemap)
+	{
+		return false;
+	}
+	for(i = 0; i < 16; i++)
+	{
+		ap = t3f_create_animation();
+		bp = create_test_bitmap(16, 16);
+		if(!ap || !bp)
+		{
+			if(ap)
+			{
+				t3f_destroy_animation(ap);
+			}
+			if(bp)
+			{
+				al_destroy_bitmap(bp);
+			}
+			return false;
+		}
+
+		/* the animation owns the bitmap from here on */
+		t3f_animation_add_bitmap(ap, bp);
+		t3f_animation_add_frame(ap, 0, 0.0, 0.0, 0.0, 16.0, 16.0, 0.0, 1, 0);
+		if(!t3f_add_tile(dp->tileset, ap))
+		{
+			t3f_destroy_animation(ap);
+			return false;
+		}
+	}
+	for(i = 0; i < dp->tilemap->layer[0]->height; i++)
+	{
+		for(j = 0; j < dp->tilemap->layer[0]->width; j++)
+		{
+			dp->tilemap->layer[0]->data[i][j] = t3f_random(&bench_rng, 16);
+		}
+	}
+	return true;
+}
+
+static void run_tilemap(void * data, int iteration)
+{
+	BENCH_TILEMAP_DATA * dp = (BENCH_TILEMAP_DATA *)data;
+	ALLEGRO_STATE old_state;
+
+	al_store_state(&old_state, ALLEGRO_STATE_TARGET_BITMAP);
+	al_set_target_bitmap(dp->target);
+	t3f_render_tilemap(dp->tilemap, dp->tileset, 0, iteration, iteration % 512, iteration % 256, 0.0, t3f_color_white);
+	al_restore_state(&old_state);
+}
+
+/* collision */
+typedef struct
+{
+
+	T3F_COLLISION_TILEMAP * tilemap;
+	T3F_COLLISION_OBJECT * object;
+	int hits;
+
+} BENCH_COLLISION_DATA;
+
+static void cleanup_collision(void * data)
+{
+	BENCH_COLLISION_DATA * dp = (BENCH_COLLISION_DATA *)data;
+
+	if(dp->object)
+	{
+		t3f_destroy_collision_object(dp->object);
+	}
+	if(dp->tilemap)
+	{
+		t3f_destroy_collision_tilemap(dp->tilemap);
+	}
+	free(dp);
+}
+
+static bool setup_collision(void ** data)
+{
+	BENCH_COLLISION_DATA * dp;
+	int i, j;
+
+	dp = malloc(sizeof(BENCH_COLLISION_DATA));
+	if(!dp)
+	{
+		return false;
+	}
+	memset(dp, 0, sizeof(BENCH_COLLISION_DATA));
+	*data = dp;
+	dp->tilemap = t3f_create_collision_tilemap(256, 256, 16, 16);
+	dp->object = t3f_create_collision_object(0.0, 0.0, 16.0, 16.0, 16, 16, 0);
+	if(!dp->tilemap || !dp->object)
+	{
+		return false;
+	}
+	for(i = 0; i < dp->tilemap->height; i++)
+	{
+		for(j = 0; j < dp->tilemap->width; j++)
+		{
+			if(t3f_random(&bench_rng, 4) == 0)
+			{
+				dp->tilemap->data[i][j].flags = T3F_COLLISION_FLAG_SOLID_TOP | T3F_COLLISION_FLAG_SOLID_BOTTOM | T3F_COLLISION_FLAG_SOLID_LEFT | T3F_COLLISION_FLAG_SOLID_RIGHT;
+			}
+		}
+	}
+	return true;
+}
+
+static void run_collision(void * data, int iteration)
+{
+	BENCH_COLLISION_DATA * dp = (BENCH_COLLISION_DATA *)data;
+	int i;
+
+	for(i = 0; i < 1000; i++)
+	{
+		t3f_move_collision_object_xy(dp->object, t3f_random(&bench_rng, 4000), t3f_random(&bench_rng, 4000));
+		t3f_move_collision_object_xy(dp->object, dp->object->x + t3f_random(&bench_rng, 32) - 16, dp->object->y + t3f_random(&bench_rng, 32) - 16);
+		dp->hits += t3f_check_tilemap_collision_top(dp->object, dp->tilemap);
+		dp->hits += t3f_check_tilemap_collision_bottom(dp->object, dp->tilemap);
+		dp->hits += t3f_check_tilemap_collision_left(dp->object, dp->tilemap);
+		dp->hits += t3f_check_tilemap_collision_right(dp->object, dp->tilemap);
+	}
+}
+
+/* text line data */
+static const char * bench_text = "The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs! How vexingly quick daft zebras jump; sphinx of black quartz, judge my vow. The five boxing wizards jump quickly. Jackdaws love my big sphinx of quartz. The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs! How vexingly quick daft zebras jump; sphinx of black quartz, judge my vow. The five boxing wizards jump quickly. Jackdaws love my big sphinx of quartz.";
+
+typedef struct
+{
+
+	T3F_FONT * font;
+	T3F_TEXT_LINE_DATA lines;
+
+} BENCH_TEXT_DATA;
+
+/* build a glyph sheet in the format al_grab_font_from_bitmap() expects and
+   load it through the T3F font loader */
+static T3F_FONT * create_test_font(void)
+{
+	ALLEGRO_BITMAP * bp;
+	ALLEGRO_STATE old_state;
+	ALLEGRO_FILE * fp;
+	T3F_FONT * font = NULL;
+	void * buffer = NULL;
+	int i, x = 1, y = 1, w;
+
+	bp = al_create_bitmap(512, 64);
+	if(!bp)
+	{
+		return NULL;
+	}
+	al_store_state(&old_state, ALLEGRO_STATE_TARGET_BITMAP);
+	al_set_target_bitmap(bp);
+	al_clear_to_color(al_map_rgb(255, 0, 255));
+	for(i = 32; i <= 126; i++)
+	{
+		w = 4 + i % 6;
+		if(x + w + 1 >= al_get_bitmap_width(bp))
+		{
+			x = 1;
+			y += 14;
+		}
+		al_draw_filled_rectangle(x, y, x + w, y + 12, al_map_rgb(255, 255, 255));
+		x += w + 1;
+	}
+	al_restore_state(&old_state);
+	fp = create_memory_file(&buffer, 1024 * 1024);
+	if(fp)
+	{
+		if(al_save_bitmap_f(fp, ".png", bp))
+		{
+			al_fseek(fp, 0, ALLEGRO_SEEK_SET);
+			font = t3f_load_font_f("bench.png", fp, T3F_FONT_TYPE_ALLEGRO, 0, 0);
+		}
+		al_fclose(fp);
+	}
+	free(buffer);
+	al_destroy_bitmap(bp);
+	return font;
+}
+
+static bool setup_text(void ** data)
+{
+	BENCH_TEXT_DATA * dp;
+
+	dp = malloc(sizeof(BENCH_TEXT_DATA));
+	if(!dp)
+	{
+		return false;
+	}
+	memset(dp, 0, sizeof(BENCH_TEXT_DATA));
+	*data = dp;
+	dp->font = create_test_font();
+	return dp->font;
+}
+
+static void run_text(void * data, int iteration)
+{
+	BENCH_TEXT_DATA * dp = (BENCH_TEXT_DATA *)data;
+
+	t3f_create_text_line_data(&dp->lines, dp->font, 400.0, 0.0, bench_text);
+}
+
+static void cleanup_text(void * data)
+{
+	BENCH_TEXT_DATA * dp = (BENCH_TEXT_DATA *)data;
+
+	if(dp->font)
+	{
+		t3f_destroy_font(dp->font);
+	}
+	free(dp);
+}
+
+/* atlas */
+typedef struct
+{
+
+	T3F_ATLAS * atlas;
+	ALLEGRO_BITMAP * bitmap;
+
+} BENCH_ATLAS_DATA;
+
+static void cleanup_atlas(void * data)
+{
+	BENCH_ATLAS_DATA * dp = (BENCH_ATLAS_DATA *)data;
+
+	if(dp->bitmap)
+	{
+		al_destroy_bitmap(dp->bitmap);
+	}
+	if(dp->atlas)
+	{
+		t3f_destroy_atlas(dp->atlas);
+	}
+	free(dp);
+}
+
+static bool setup_atlas(void ** data)
+{
+	BENCH_ATLAS_DATA * dp;
+
+	dp = malloc(sizeof(BENCH_ATLAS_DATA));
+	if(!dp)
+	{
+		return false;
+	}
+	memset(dp, 0, sizeof(BENCH_ATLAS_DATA));
+	*data = dp;
+	dp->atlas = t3f_create_atlas(1024, 1024);
+	dp->bitmap = create_test_bitmap(32, 32);
+	return dp->atlas && dp->bitmap;
+}
+
+static void run_atlas(void * data, int iteration)
+{
+	BENCH_ATLAS_DATA * dp = (BENCH_ATLAS_DATA *)data;
+	ALLEGRO_BITMAP * bp;
+	int i;
+
+	/* start each iteration with an empty page */
+	t3f_clear_atlas(dp->atlas);
+	for(i = 0; i < 64; i++)
+	{
+		bp = t3f_put_bitmap_on_atlas(dp->atlas, &dp->bitmap, i % 2 ? T3F_ATLAS_SPRITE : T3F_ATLAS_TILE);
+		if(bp)
+		{
+			al_destroy_bitmap(bp);
+		}
+	}
+}
+
+/* high quality resize, the source isn't a resource so the resize leaves it
+   alone and we only have to clean up the result */
+static bool setup_resize(void ** data)
+{
+	*data = create_test_bitmap(256, 256);
+	return *data;
+}
+
+static void run_resize(void * data, int iteration)
+{
+	ALLEGRO_BITMAP * bp = (ALLEGRO_BITMAP *)data;
+
+	if(t3f_resize_bitmap(&bp, 192, 192, true, 0) && bp != data)
+	{
+		al_destroy_bitmap(bp);
+	}
+}
+
+static void cleanup_resize(void * data)
+{
+	al_destroy_bitmap((ALLEGRO_BITMAP *)data);
+}
+
+/* PNG and animation loading, the data is saved to a memory file once and
+   loaded back each iteration */
+typedef struct
+{
+
+	void * buffer;
+	ALLEGRO_FILE * fp;
+
+} BENCH_FILE_DATA;
+
+static void cleanup_file(void * data)
+{
+	BENCH_FILE_DATA * dp = (BENCH_FILE_DATA *)data;
+
+	if(dp->fp)
+	{
+		al_fclose(dp->fp);
+	}
+	free(dp->buffer);
+	free(dp);
+}
+
+static BENCH_FILE_DATA * create_file_data(void ** data)
+{
+	BENCH_FILE_DATA * dp;
+
+	dp = malloc(sizeof(BENCH_FILE_DATA));
+	if(!dp)
+	{
+		return NULL;
+	}
+	memset(dp, 0, sizeof(BENCH_FILE_DATA));
+	*data = dp;
+	dp->fp = create_memory_file(&dp->buffer, 4 * 1024 * 1024);
+	if(!dp->fp)
+	{
+		return NULL;
+	}
+	return dp;
+}
+
+/* internal_png.c only replaces Allegro's loader when built with T3F_PNG,
+   without it this would time the wrong loader so the test is left out */
+#ifdef T3F_PNG
+static bool setup_png(void ** data)
+{
+	BENCH_FILE_DATA * dp;
+	ALLEGRO_BITMAP * bp;
+	bool ret;
+
+	dp = create_file_data(data);
+	bp = create_test_bitmap(256, 256);
+	if(!dp || !bp)
+	{
+		return false;
+	}
+	ret = al_save_bitmap_f(dp->fp, ".png", bp);
+	al_destroy_bitmap(bp);
+	return ret;
+}
+
+static void run_png(void * data, int iteration)
+{
+	BENCH_FILE_DATA * dp = (BENCH_FILE_DATA *)data;
+	ALLEGRO_BITMAP * bp;
+
+	al_fseek(dp->fp, 0, ALLEGRO_SEEK_SET);
+	bp = al_load_bitmap_f(dp->fp, ".png");
+	if(bp)
+	{
+		al_destroy_bitmap(bp);
+	}
+}
+#endif
+
+static bool setup_animation(void ** data)
+{
+	BENCH_FILE_DATA * dp;
+	T3F_ANIMATION * ap;
+	ALLEGRO_BITMAP * bp;
+	int i;
+	bool ret;
+
+	dp = create_file_data(data);
+	ap = t3f_create_animation();
+	if(!dp || !ap)
+	{
+		return false;
+	}
+	for(i = 0; i < 4; i++)
+	{
+		bp = create_test_bitmap(32, 32);
+		if(!bp)
+		{
+			t3f_destroy_animation(ap);
+			return false;
+		}
+		t3f_animation_add_bitmap(ap, bp);
+	}
+	for(i = 0; i < 16; i++)
+	{
+		t3f_animation_add_frame(ap, i % 4, 0.0, 0.0, 0.0, 32.0, 32.0, 0.0, 4, 0);
+	}
+	ret = t3f_save_animation_f(ap, dp->fp);
+	t3f_destroy_animation(ap);
+	return ret;
+}
+
+static void run_animation(void * data, int iteration)
+{
+	BENCH_FILE_DATA * dp = (BENCH_FILE_DATA *)data;
+	T3F_ANIMATION * ap;
+
+	al_fseek(dp->fp, 0, ALLEGRO_SEEK_SET);
+	ap = t3f_load_animation_f(dp->fp, "bench.t3a");
+	if(ap)
+	{
+		t3f_destroy_animation(ap);
+	}
+}
+
+static const BENCH_TEST bench_test[] =
+{
+	{"logo_update", setup_logo, run_logo, cleanup_logo, 200, 100},
+	{"tilemap_render", setup_tilemap, run_tilemap, cleanup_tilemap, 100, 1},
+	{"tilemap_collision", setup_collision, run_collision, cleanup_collision, 200, 1000},
+	{"text_line_data", setup_text, run_text, cleanup_text, 500, 1},
+	{"atlas_put", setup_atlas, run_atlas, cleanup_atlas, 50, 64},
+	{"resize_bitmap_hq", setup_resize, run_resize, cleanup_resize, 50, 1},
+	#ifdef T3F_PNG
+		{"png_load", setup_png, run_png, cleanup_file, 100, 1},
+	#endif
+	{"animation_load", setup_animation, run_animation, cleanup_file, 100, 1},
+	{NULL, NULL, NULL, NULL, 0, 0}
+};
+
+static int compare_times(const void * a, const void * b)
+{
+	double d = *(const double *)a - *(const double *)b;
+
+	return d < 0.0 ? -1 : (d > 0.0 ? 1 : 0);
+}
+
+static bool run_test(const BENCH_TEST * tp, double scale, BENCH_RESULT * rp)
+{
+	double * time;
+	double start;
+	void * data = NULL;
+	int i, warmup;
+	bool ret = false;
+
+	memset(rp, 0, sizeof(BENCH_RESULT));
+	rp->test = tp;
+	rp->iterations = tp->iterations * scale;
+	if(rp->iterations < 1)
+	{
+		rp->iterations = 1;
+	}
+	time = malloc(sizeof(double) * rp->iterations);
+	if(!time)
+	{
+		return false;
+	}
+	t3f_srand(&bench_rng, 0);
+	if(!tp->setup(&data))
+	{
+		fprintf(stderr, "%s: setup failed\n", tp->name);
+		goto fail;
+	}
+	warmup = rp->iterations / 10;
+	for(i = 0; i < warmup; i++)
+	{
+		tp->run(data, i);
+	}
+	for(i = 0; i < rp->iterations; i++)
+	{
+		start = al_get_time();
+		tp->run(data, warmup + i);
+		time[i] = al_get_time() - start;
+		rp->mean += time[i];
+	}
+	rp->mean /= rp->iterations;
+	qsort(time, rp->iterations, sizeof(double), compare_times);
+	rp->min = time[0];
+	rp->max = time[rp->iterations - 1];
+	rp->median = time[rp->iterations / 2];
+	ret = true;
+
+	fail:
+	{
+		if(data)
+		{
+			tp->cleanup(data);
+		}
+		free(time);
+	}
+	return ret;
+}
+
+static void write_results(FILE * fp, BENCH_RESULT * result, int results, int format)
+{
+	int i;
+
+	if(format == BENCH_OUTPUT_JSON)
+	{
+		fprintf(fp, "{\n\t\"benchmarks\": [\n");
+		for(i = 0; i < results; i++)
+		{
+			fprintf(fp, "\t\t{\"name\": \"%s\", \"iterations\": %d, \"ops\": %d, \"mean_us\": %.3f, \"median_us\": %.3f, \"min_us\": %.3f, \"max_us\": %.3f, \"median_ns_per_op\": %.3f}%s\n", result[i].test->name, result[i].iterations, result[i].test->ops, result[i].mean * 1000000.0, result[i].median * 1000000.0, result[i].min * 1000000.0, result[i].max * 1000000.0, result[i].median * 1000000000.0 / result[i].test->ops, i < results - 1 ? "," : "");
+		}
+		fprintf(fp, "\t]\n}\n");
+	}
+	else
+	{
+		fprintf(fp, "name,iterations,ops,mean_us,median_us,min_us,max_us,median_ns_per_op\n");
+		for(i = 0; i < results; i++)
+		{
+			fprintf(fp, "%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n", result[i].test->name, result[i].iterations, result[i].test->ops, result[i].mean * 1000000.0, result[i].median * 1000000.0, result[i].min * 1000000.0, result[i].max * 1000000.0, result[i].median * 1000000000.0 / result[i].test->ops);
+		}
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	BENCH_RESULT result[sizeof(bench_test) / sizeof(bench_test[0])];
+	FILE * fp = NULL;
+	const char * output = NULL;
+	const char * filter = NULL;
+	double scale = 1.0;
+	int format = BENCH_OUTPUT_CSV;
+	int i, results = 0;
+	int ret = 0;
+
+	for(i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--json"))
+		{
+			format = BENCH_OUTPUT_JSON;
+		}
+		else if(!strcmp(argv[i], "--csv"))
+		{
+			format = BENCH_OUTPUT_CSV;
+		}
+		else if(!strcmp(argv[i], "--output") && i + 1 < argc)
+		{
+			output = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--filter") && i + 1 < argc)
+		{
+			filter = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--scale") && i + 1 < argc)
+		{
+			scale = atof(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [--csv | --json] [--output file] [--filter name] [--scale n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if(!t3f_initialize(T3F_APP_TITLE, BENCH_WIDTH, BENCH_HEIGHT, 60.0, NULL, NULL, T3F_NO_DISPLAY, NULL))
+	{
+		fprintf(stderr, "Error initializing T3F\n");
+		return 1;
+	}
+
+	/* there is no display so all bitmaps are memory bitmaps */
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP | ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR);
+	for(i = 0; bench_test[i].name; i++)
+	{
+		if(filter && !strstr(bench_test[i].name, filter))
+		{
+			continue;
+		}
+		if(run_test(&bench_test[i], scale, &result[results]))
+		{
+			results++;
+		}
+		else
+		{
+			ret = 1;
+		}
+	}
+
+	if(output)
+	{
+		fp = fopen(output, "w");
+		if(!fp)
+		{
+			fprintf(stderr, "Unable to open %s!\n", output);
+			ret = 1;
+		}
+	}
+	else
+	{
+		fp = stdout;
+	}
+	if(fp)
+	{
+		write_results(fp, result, results, format);
+		if(fp != stdout)
+		{
+			fclose(fp);
+		}
+	}
+	t3f_finish();
+	return ret;
+}
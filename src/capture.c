@@ -0,0 +1,395 @@
+#include "t3f/t3f.h"
+#include "t3logo.h"
+#include "capture.h"
+
+/* the logo state only depends on the tick, so independent ranges of ticks
+   can be rendered by separate workers and put back in order afterwards
+
+   frames go through a ring of slots in three stages which all run at the
+   same time: workers render into a free slot, the readback thread locks the
+   rendered slots in order and the calling thread hands them to frame_proc
+   before freeing the slot again, slots are never copied between stages */
+
+#define _T3LOGO_CAPTURE_SLOT_FREE     0
+#define _T3LOGO_CAPTURE_SLOT_RENDERED 1
+#define _T3LOGO_CAPTURE_SLOT_READY    2
+
+typedef struct
+{
+
+	T3LOGO_CAPTURE_FRAME frame;
+	int state;
+
+} T3LOGO_CAPTURE_SLOT;
+
+typedef struct
+{
+
+	T3LOGO_CAPTURE_SETTINGS * settings;
+	T3LOGO_CAPTURE_STATS stats;
+	ALLEGRO_MUTEX * mutex;
+	ALLEGRO_COND * cond;
+
+	/* slot for tick is slot[tick % slots] */
+	T3LOGO_CAPTURE_SLOT * slot;
+	int next_tick; // first tick not yet handed to a worker
+	int free_tick; // first tick whose slot hasn't been given back
+	bool failed;
+
+} T3LOGO_CAPTURE_STATE;
+
+void t3logo_capture_default_settings(T3LOGO_CAPTURE_SETTINGS * sp, int width, int height, int ticks)
+{
+	memset(sp, 0, sizeof(T3LOGO_CAPTURE_SETTINGS));
+	sp->width = width;
+	sp->height = height;
+	sp->start_tick = 0;
+	sp->end_tick = ticks;
+	sp->chunk_ticks = T3LOGO_CAPTURE_DEFAULT_CHUNK_TICKS;
+	t3logo_capture_set_threads(sp, al_get_cpu_count());
+	sp->background = al_map_rgb(0, 0, 0);
+	sp->logo_flags = T3LOGO_FLAG_AUTO | T3LOGO_FLAG_SILENT;
+}
+
+/* two chunks per worker keeps them busy, but frames are encoded one at a
+   time so a big ring buffer only fills up, cap it by the memory it takes */
+void t3logo_capture_set_threads(T3LOGO_CAPTURE_SETTINGS * sp, int threads)
+{
+	size_t frame_size = (size_t)sp->width * sp->height * al_get_pixel_size(T3LOGO_CAPTURE_PIXEL_FORMAT);
+
+	sp->threads = threads > 0 ? threads : 1;
+	sp->slots = sp->chunk_ticks * sp->threads * 2;
+	if(frame_size > 0 && (size_t)sp->slots * frame_size > T3LOGO_CAPTURE_DEFAULT_MEMORY)
+	{
+		sp->slots = T3LOGO_CAPTURE_DEFAULT_MEMORY / frame_size;
+	}
+	if(sp->slots < sp->chunk_ticks)
+	{
+		sp->slots = sp->chunk_ticks;
+	}
+}
+
+static void set_failed(T3LOGO_CAPTURE_STATE * cp)
+{
+	al_lock_mutex(cp->mutex);
+	cp->failed = true;
+	al_broadcast_cond(cp->cond);
+	al_unlock_mutex(cp->mutex);
+}
+
+/* wait for the slot belonging to tick to reach state, returns NULL if the
+   capture failed in the meantime */
+static T3LOGO_CAPTURE_SLOT * wait_slot(T3LOGO_CAPTURE_STATE * cp, int tick, int state)
+{
+	T3LOGO_CAPTURE_SLOT * slot = &cp->slot[tick % cp->settings->slots];
+
+	al_lock_mutex(cp->mutex);
+	while(!cp->failed && !(slot->state == state && slot->frame.tick == tick))
+	{
+		al_wait_cond(cp->cond, cp->mutex);
+	}
+	if(cp->failed)
+	{
+		slot = NULL;
+	}
+	al_unlock_mutex(cp->mutex);
+	return slot;
+}
+
+static void set_slot_state(T3LOGO_CAPTURE_STATE * cp, T3LOGO_CAPTURE_SLOT * slot, int state)
+{
+	al_lock_mutex(cp->mutex);
+	slot->state = state;
+	al_broadcast_cond(cp->cond);
+	al_unlock_mutex(cp->mutex);
+}
+
+static void render_frame(T3LOGO_CAPTURE_SETTINGS * sp, T3LOGO * lp, ALLEGRO_BITMAP * bp, int tick)
+{
+	ALLEGRO_TRANSFORM transform;
+
+	t3logo_seek(lp, tick);
+	al_set_target_bitmap(bp);
+	al_identity_transform(&transform);
+	al_scale_transform(&transform, (float)sp->width / (float)t3f_virtual_display_width, (float)sp->height / (float)t3f_virtual_display_height);
+	al_use_transform(&transform);
+	al_clear_to_color(sp->background);
+	t3logo_render(lp);
+	al_set_target_bitmap(NULL);
+}
+
+/* hand out the next chunk of ticks, waiting while its slots are still held
+   by earlier frames, returns false when there is nothing left to do */
+static bool get_chunk(T3LOGO_CAPTURE_STATE * cp, int * start, int * end)
+{
+	T3LOGO_CAPTURE_SETTINGS * sp = cp->settings;
+	bool ret = false;
+	bool stalled = false;
+
+	al_lock_mutex(cp->mutex);
+	while(!cp->failed && cp->next_tick < sp->end_tick)
+	{
+		*start = cp->next_tick;
+		*end = *start + sp->chunk_ticks;
+		if(*end > sp->end_tick)
+		{
+			*end = sp->end_tick;
+		}
+		if(*end <= cp->free_tick + sp->slots)
+		{
+			cp->next_tick = *end;
+			if(cp->next_tick - cp->free_tick > cp->stats.peak_slots)
+			{
+				cp->stats.peak_slots = cp->next_tick - cp->free_tick;
+			}
+			ret = true;
+			break;
+		}
+		if(!stalled)
+		{
+			cp->stats.render_stalls++;
+			stalled = true;
+		}
+		al_wait_cond(cp->cond, cp->mutex);
+	}
+	al_unlock_mutex(cp->mutex);
+	return ret;
+}
+
+static void * render_thread_proc(ALLEGRO_THREAD * thread, void * arg)
+{
+	T3LOGO_CAPTURE_STATE * cp = (T3LOGO_CAPTURE_STATE *)arg;
+	T3LOGO_CAPTURE_SETTINGS * sp = cp->settings;
+	T3LOGO_CAPTURE_SLOT * slot;
+	T3LOGO * lp;
+	int start, end, i;
+
+	/* this thread has no display so everything ends up in memory bitmaps,
+	   using the readback format means locking them doesn't convert */
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP | ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR);
+	lp = t3logo_create(sp->logo_flags);
+	if(!lp)
+	{
+		goto fail;
+	}
+	al_set_new_bitmap_format(T3LOGO_CAPTURE_PIXEL_FORMAT);
+	while(get_chunk(cp, &start, &end))
+	{
+		for(i = start; i < end; i++)
+		{
+			/* the slot is ours until we mark it rendered */
+			slot = &cp->slot[i % sp->slots];
+			if(!slot->frame.bitmap)
+			{
+				slot->frame.bitmap = al_create_bitmap(sp->width, sp->height);
+				if(!slot->frame.bitmap)
+				{
+					goto fail;
+				}
+				al_lock_mutex(cp->mutex);
+				cp->stats.allocated_slots++;
+				al_unlock_mutex(cp->mutex);
+			}
+			render_frame(sp, lp, slot->frame.bitmap, i);
+			al_lock_mutex(cp->mutex);
+			slot->frame.tick = i;
+			slot->state = _T3LOGO_CAPTURE_SLOT_RENDERED;
+			al_broadcast_cond(cp->cond);
+			al_unlock_mutex(cp->mutex);
+		}
+	}
+	t3logo_destroy(lp);
+	return NULL;
+
+	fail:
+	{
+		set_failed(cp);
+		if(lp)
+		{
+			t3logo_destroy(lp);
+		}
+	}
+	return NULL;
+}
+
+static void * readback_thread_proc(ALLEGRO_THREAD * thread, void * arg)
+{
+	T3LOGO_CAPTURE_STATE * cp = (T3LOGO_CAPTURE_STATE *)arg;
+	T3LOGO_CAPTURE_SETTINGS * sp = cp->settings;
+	T3LOGO_CAPTURE_SLOT * slot;
+	int i;
+
+	for(i = sp->start_tick; i < sp->end_tick; i++)
+	{
+		slot = wait_slot(cp, i, _T3LOGO_CAPTURE_SLOT_RENDERED);
+		if(!slot)
+		{
+			break;
+		}
+		slot->frame.region = al_lock_bitmap(slot->frame.bitmap, T3LOGO_CAPTURE_PIXEL_FORMAT, ALLEGRO_LOCK_READONLY);
+		if(!slot->frame.region)
+		{
+			set_failed(cp);
+			break;
+		}
+		set_slot_state(cp, slot, _T3LOGO_CAPTURE_SLOT_READY);
+	}
+	return NULL;
+}
+
+/* render the requested ticks on worker threads and pass the frames to
+   frame_proc in order on the calling thread */
+bool t3logo_capture(T3LOGO_CAPTURE_SETTINGS * sp, T3LOGO_CAPTURE_STATS * stats)
+{
+	T3LOGO_CAPTURE_STATE capture;
+	ALLEGRO_THREAD ** thread = NULL;
+	ALLEGRO_THREAD * readback_thread = NULL;
+	T3LOGO_CAPTURE_SLOT * slot;
+	int encode_state = _T3LOGO_CAPTURE_SLOT_READY;
+	double start_time;
+	int i, threads = 0;
+	bool ret = false;
+
+	if(stats)
+	{
+		memset(stats, 0, sizeof(T3LOGO_CAPTURE_STATS));
+	}
+	if(sp->threads < 1 || sp->chunk_ticks < 1 || sp->slots < sp->chunk_ticks)
+	{
+		return false;
+	}
+	memset(&capture, 0, sizeof(T3LOGO_CAPTURE_STATE));
+	capture.settings = sp;
+	capture.next_tick = sp->start_tick;
+	capture.free_tick = sp->start_tick;
+	capture.slot = malloc(sizeof(T3LOGO_CAPTURE_SLOT) * sp->slots);
+	if(!capture.slot)
+	{
+		goto fail;
+	}
+	memset(capture.slot, 0, sizeof(T3LOGO_CAPTURE_SLOT) * sp->slots);
+	for(i = 0; i < sp->slots; i++)
+	{
+		capture.slot[i].frame.tick = -1;
+	}
+	capture.mutex = al_create_mutex();
+	if(!capture.mutex)
+	{
+		goto fail;
+	}
+	capture.cond = al_create_cond();
+	if(!capture.cond)
+	{
+		goto fail;
+	}
+	thread = malloc(sizeof(ALLEGRO_THREAD *) * sp->threads);
+	if(!thread)
+	{
+		goto fail;
+	}
+	start_time = al_get_time();
+	for(i = 0; i < sp->threads; i++)
+	{
+		thread[i] = al_create_thread(render_thread_proc, &capture);
+		if(!thread[i])
+		{
+			break;
+		}
+		al_start_thread(thread[i]);
+		threads++;
+	}
+	if(threads < 1)
+	{
+		goto fail;
+	}
+	if(sp->flags & T3LOGO_CAPTURE_FLAG_NO_READBACK)
+	{
+		encode_state = _T3LOGO_CAPTURE_SLOT_RENDERED;
+	}
+	else
+	{
+		readback_thread = al_create_thread(readback_thread_proc, &capture);
+		if(!readback_thread)
+		{
+			set_failed(&capture);
+			goto fail;
+		}
+		al_start_thread(readback_thread);
+	}
+
+	/* encode stage, frames arrive in order */
+	for(i = sp->start_tick; i < sp->end_tick; i++)
+	{
+		slot = wait_slot(&capture, i, encode_state);
+		if(!slot)
+		{
+			break;
+		}
+		if(sp->frame_proc && !sp->frame_proc(&slot->frame, sp->data))
+		{
+			set_failed(&capture);
+			break;
+		}
+		if(slot->frame.region)
+		{
+			al_unlock_bitmap(slot->frame.bitmap);
+			slot->frame.region = NULL;
+		}
+		al_lock_mutex(capture.mutex);
+		slot->state = _T3LOGO_CAPTURE_SLOT_FREE;
+		capture.free_tick = i + 1;
+		al_broadcast_cond(capture.cond);
+		al_unlock_mutex(capture.mutex);
+	}
+	ret = i >= sp->end_tick;
+	if(stats)
+	{
+		memcpy(stats, &capture.stats, sizeof(T3LOGO_CAPTURE_STATS));
+		stats->frames = i - sp->start_tick;
+		stats->time = al_get_time() - start_time;
+		stats->frames_per_second = stats->time > 0.0 ? stats->frames / stats->time : 0.0;
+		stats->peak_bytes = (size_t)stats->allocated_slots * sp->width * sp->height * al_get_pixel_size(T3LOGO_CAPTURE_PIXEL_FORMAT);
+	}
+
+	fail:
+	{
+		for(i = 0; i < threads; i++)
+		{
+			al_join_thread(thread[i], NULL);
+			al_destroy_thread(thread[i]);
+		}
+		if(readback_thread)
+		{
+			al_join_thread(readback_thread, NULL);
+			al_destroy_thread(readback_thread);
+		}
+		if(thread)
+		{
+			free(thread);
+		}
+		if(capture.slot)
+		{
+			for(i = 0; i < sp->slots; i++)
+			{
+				if(capture.slot[i].frame.region)
+				{
+					al_unlock_bitmap(capture.slot[i].frame.bitmap);
+				}
+				if(capture.slot[i].frame.bitmap)
+				{
+					al_destroy_bitmap(capture.slot[i].frame.bitmap);
+				}
+			}
+			free(capture.slot);
+		}
+		if(capture.cond)
+		{
+			al_destroy_cond(capture.cond);
+		}
+		if(capture.mutex)
+		{
+			al_destroy_mutex(capture.mutex);
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,72 @@
+#ifndef T3LOGO_CAPTURE_H
+#define T3LOGO_CAPTURE_H
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+#include "t3f/t3f.h"
+
+#define T3LOGO_CAPTURE_DEFAULT_CHUNK_TICKS 4
+
+/* the default ring buffer holds no more frames than fit in this many bytes */
+#define T3LOGO_CAPTURE_DEFAULT_MEMORY (256 * 1024 * 1024)
+
+/* frames are read back as R, G, B, A bytes */
+#define T3LOGO_CAPTURE_PIXEL_FORMAT ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE
+
+/* skip the readback stage, frames are passed to frame_proc unlocked */
+#define T3LOGO_CAPTURE_FLAG_NO_READBACK 1
+
+/* a frame slot passed to frame_proc by reference, the slot is reused once
+   frame_proc returns so nothing in here may be kept */
+typedef struct
+{
+
+	ALLEGRO_BITMAP * bitmap;
+	ALLEGRO_LOCKED_REGION * region; // NULL with T3LOGO_CAPTURE_FLAG_NO_READBACK
+	int tick;
+
+} T3LOGO_CAPTURE_FRAME;
+
+/* called on the capturing thread with each frame in tick order */
+typedef bool (*T3LOGO_CAPTURE_FRAME_PROC)(const T3LOGO_CAPTURE_FRAME * fp, void * data);
+
+typedef struct
+{
+
+	int width, height;         // size of the captured frames
+	int start_tick, end_tick;  // capture ticks start_tick through end_tick - 1
+	int threads;               // number of render workers
+	int chunk_ticks;           // consecutive ticks handed to a worker at once
+	int slots;                 // frame slots in the ring buffer
+	int flags;
+	ALLEGRO_COLOR background;
+	int logo_flags;
+	T3LOGO_CAPTURE_FRAME_PROC frame_proc;
+	void * data;
+
+} T3LOGO_CAPTURE_SETTINGS;
+
+typedef struct
+{
+
+	int frames;
+	double time;
+	double frames_per_second;
+	int peak_slots;      // most slots in use at once
+	int allocated_slots; // slots which had a bitmap created for them
+	size_t peak_bytes;   // pixel memory held by the allocated slots
+	int render_stalls;   // times a worker waited for the encoder to free a slot
+
+} T3LOGO_CAPTURE_STATS;
+
+void t3logo_capture_default_settings(T3LOGO_CAPTURE_SETTINGS * sp, int width, int height, int ticks);
+void t3logo_capture_set_threads(T3LOGO_CAPTURE_SETTINGS * sp, int threads);
+bool t3logo_capture(T3LOGO_CAPTURE_SETTINGS * sp, T3LOGO_CAPTURE_STATS * stats);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif
@@ -1,406 +1,254 @@
 #include "t3f/t3f.h"
 #include "avc/avc.h"
+#include "t3logo.h"
+#include "capture.h"
 
-#define _T3LOGO_MAX_VERTICES 64
-
-#define _T3LOGO_TARGET_TILT  (0.5)
-#define _T3LOGO_TARGET_ANGLE (ALLEGRO_PI * 2.25)
-#define _T3LOGO_LIGHT_ANGLE  (ALLEGRO_PI * 1.25)
-#define _T3LOGO_BOTTOM 1.595
-#define _T3LOGO_BAR_BOTTOM -1.235
-#define _T3LOGO_OUTLINE_SIZE 16.0
-#define _T3LOGO_OUTLINE_COLOR al_map_rgb(150, 189, 224)
 #define _T3LOGO_BACKGROUND_COLOR al_map_rgb(16, 16, 16)
-#define _T3LOGO_SCALE 47.75
-#define _T3LOGO_FADE_IN 0.015
-#define _T3LOGO_Y_OFFSET 26
-
-#define _T3LOGO_BITMAP_SIZE 540
-
-#define _T3LOGO_STATE_FADE_IN      0
-#define _T3LOGO_STATE_WAIT         1
-#define _T3LOGO_STATE_SPIN         2
-#define _T3LOGO_STATE_FADE_OUTLINE 3
-#define _T3LOGO_STATE_FADE_FLASH   4
-#define _T3LOGO_STATE_DONE         5
-#define _T3LOGO_STATE_FADE_OUT     6
-
-/* shape constructed of triplets of vertices */
-typedef struct
-{
-
-	ALLEGRO_VERTEX vertex[_T3LOGO_MAX_VERTICES];
-	int vertex_count;
-
-	ALLEGRO_VERTEX transformed_vertex[_T3LOGO_MAX_VERTICES];
-	float z_depth;
-	float angle;
-
-} SHAPE;
+#define _T3LOGO_CAPTURE_TICKS  1300
+#define _T3LOGO_CAPTURE_WIDTH  1920
+#define _T3LOGO_CAPTURE_HEIGHT 1080
 
 /* structure to hold all of our app-specific data */
 typedef struct
 {
 
-	ALLEGRO_BITMAP * logo_bitmap;
-	ALLEGRO_BITMAP * logo_outline_bitmap;
-	ALLEGRO_SAMPLE * logo_bump_sound;
-	ALLEGRO_SAMPLE * logo_click_sound;
-	SHAPE logo_side[3];
-	SHAPE * logo_side_zsort[3];
+	T3LOGO * logo;
 	char * capture_path;
-	float fade;
-	float logo_fade;
-	float logo_vfade;
-	float logo_overlay_fade;
-	float angle;
-	float tilt;
-	float v_tilt;   // tilt velocity
-	float vf_tilt;  // tilt velocity friction
-	float v_angle;  // angle velocity
-	float vf_angle; // angle velocity friction
-	int state;
-	int spin_tick;
-	int tick;
+	bool headless;
+	int capture_threads;
+	ALLEGRO_FILE * capture_file;
+	char * profile_path;
+	char * trace_path;
 
 } APP_INSTANCE;
 
-static int side_z_depth_qsort_proc(const void * p1, const void * p2)
+static bool setup_logo(void * data)
 {
-	SHAPE * side1 = *(SHAPE **)p1;
-	SHAPE * side2 = *(SHAPE **)p2;
-
-	return side2->z_depth < side1->z_depth;
-}
+	APP_INSTANCE * app = (APP_INSTANCE *)data;
 
-static void init_shape(SHAPE * sp)
-{
-	memset(sp, 0, sizeof(SHAPE));
-}
+	t3logo_reset(app->logo);
 
-static void add_vertex(SHAPE * sp, float x, float y, float z)
-{
-	sp->vertex[sp->vertex_count].x = x;
-	sp->vertex[sp->vertex_count].y = y;
-	sp->vertex[sp->vertex_count].z = z;
-	sp->vertex_count++;
+	return true;
 }
 
-static float linear_spread(float angle_1, float angle_2, float val_min, float val_max)
+/* manual controls for tweaking the starting orientation */
+static void handle_manual_controls(APP_INSTANCE * app)
 {
-	float d = fabs(val_max - val_min);
-	float d_angle = angle_2 - angle_1;
-
-	if(d_angle < 0)
+	if(t3f_key[ALLEGRO_KEY_LEFT])
 	{
-		d_angle += ALLEGRO_PI;
+		app->logo->timeline.start_angle -= ALLEGRO_PI / 16.0;
+		printf("angle %f\n", app->logo->timeline.start_angle);
+		t3f_key[ALLEGRO_KEY_LEFT] = 0;
 	}
-	d_angle = fmod(d_angle, ALLEGRO_PI); // loop at ALLEGRO_PI intervals
-	d_angle -= ALLEGRO_PI / 2.0; // subtract 90 degrees
-	if(d_angle < 0)
+	if(t3f_key[ALLEGRO_KEY_RIGHT])
 	{
-		return val_min - d * (d_angle / (ALLEGRO_PI / 2.0));
+		app->logo->timeline.start_angle += ALLEGRO_PI / 16.0;
+		printf("angle %f\n", app->logo->timeline.start_angle);
+		t3f_key[ALLEGRO_KEY_RIGHT] = 0;
 	}
-	return val_min + d * (d_angle / (ALLEGRO_PI / 2.0));
-}
-
-static ALLEGRO_COLOR get_lit_color(ALLEGRO_COLOR base_color, float light_angle, float side_normal_angle)
-{
-	float r, g, b;
-	float h, s, l;
-	float target_l;
-
-	al_unmap_rgb_f(base_color, &r, &g, &b);
-	al_color_rgb_to_hsl(r, g, b, &h, &s, &l);
-	target_l = linear_spread(light_angle, side_normal_angle, l * 0.75, l);
-
-	return al_color_hsl(h, s, target_l);
-}
-
-static void set_shape_orientation(SHAPE * sp, float ox, float oy, float angle, float tilt, float scale)
-{
-	int i;
-	float vangle;
-	float vdistance;
-	float temp_z;
-
-	sp->z_depth = 1000000;
-	for(i = 0; i < sp->vertex_count; i++)
+	if(t3f_key[ALLEGRO_KEY_UP])
 	{
-		vangle = atan2(sp->vertex[i].z, sp->vertex[i].x);
-		vdistance = hypot(sp->vertex[i].x, sp->vertex[i].z);
-		temp_z = sin(vangle + angle) * vdistance;
-		if(temp_z < sp->z_depth)
-		{
-			sp->z_depth = temp_z;
-		}
-		sp->transformed_vertex[i].x = ox + cos(vangle + angle) * vdistance * scale;
-		sp->transformed_vertex[i].y = oy + (sp->vertex[i].y + temp_z * tilt) * scale;
-		sp->transformed_vertex[i].z = 0;
-		sp->transformed_vertex[i].color = get_lit_color(al_map_rgb(46, 104, 158), _T3LOGO_LIGHT_ANGLE, sp->angle);
+		app->logo->timeline.start_tilt -= 0.1;
+		printf("tilt %f\n", app->logo->timeline.start_tilt);
+		t3f_key[ALLEGRO_KEY_UP] = 0;
 	}
-}
-
-static void set_shape_color(SHAPE * sp, ALLEGRO_COLOR color)
-{
-	int i;
-
-	for(i = 0; i < sp->vertex_count; i++)
+	if(t3f_key[ALLEGRO_KEY_DOWN])
 	{
-		sp->transformed_vertex[i].color = color;
+		app->logo->timeline.start_tilt += 0.1;
+		printf("tilt %f\n", app->logo->timeline.start_tilt);
+		t3f_key[ALLEGRO_KEY_DOWN] = 0;
 	}
 }
 
-static void render_shape(SHAPE * sp, bool outline)
-{
-	al_draw_prim(sp->transformed_vertex, NULL, NULL, 0, sp->vertex_count + 1, ALLEGRO_PRIM_TRIANGLE_LIST);
-}
-
-static float get_punch_velocity(float start_angle, float end_angle, float friction)
+/* main logic routine */
+void app_logic(void * data)
 {
-	float current_angle = end_angle;
-	float v = 0.0;
+	APP_INSTANCE * app = (APP_INSTANCE *)data;
 
-	while(current_angle > start_angle)
+	if(app->logo->state == T3LOGO_STATE_WAIT)
 	{
-		v += friction;
-		current_angle -= v;
+		handle_manual_controls(app);
 	}
-	return v;
-}
-
-static float get_punch_tilt(float start_tilt, float end_tilt, float friction)
-{
-	float current_tilt = end_tilt;
-	float v = 0.0;
-
-	while(current_tilt > start_tilt)
+	/* the logo sits still while waiting and when done, don't redraw then */
+	if(!t3logo_logic(app->logo))
+	{
+		t3f_set_frame_unchanged();
+	}
+	if(t3logo_done(app->logo))
 	{
-		v += friction;
-		current_tilt -= v;
+		t3f_exit();
 	}
-	return v;
 }
 
-static float get_acceleration(float distance, float t)
+static bool avc_logic_wrapper(void * data)
 {
-	return (2.0 * distance) / (t * t);
-}
+	APP_INSTANCE * app = (APP_INSTANCE *)data;
 
-static void update_logo(APP_INSTANCE * app)
-{
-	set_shape_orientation(&app->logo_side[0], t3f_virtual_display_width / 2, t3f_virtual_display_height / 2 + _T3LOGO_Y_OFFSET, app->angle, app->tilt, _T3LOGO_SCALE);
-	app->logo_side[0].angle = app->angle + ALLEGRO_PI / 2.0;
-	set_shape_orientation(&app->logo_side[1], t3f_virtual_display_width / 2, t3f_virtual_display_height / 2 + _T3LOGO_Y_OFFSET, app->angle, app->tilt, _T3LOGO_SCALE);
-	app->logo_side[1].angle = app->angle + ALLEGRO_PI;
-	set_shape_orientation(&app->logo_side[2], t3f_virtual_display_width / 2, t3f_virtual_display_height / 2 + _T3LOGO_Y_OFFSET, app->angle, app->tilt, _T3LOGO_SCALE);
-	app->logo_side[2].angle = app->angle + ALLEGRO_PI * 1.5;
-	qsort(app->logo_side_zsort, 3, sizeof(SHAPE *), side_z_depth_qsort_proc);
+	app_logic(data);
+	if(app->logo->tick < _T3LOGO_CAPTURE_TICKS)
+	{
+		return true;
+	}
+	return false;
 }
 
-static bool setup_logo(void * data)
+/* main rendering routine */
+void app_render(void * data)
 {
 	APP_INSTANCE * app = (APP_INSTANCE *)data;
 
-	app->logo_fade = 0.0;
-	app->logo_vfade = 0.0;
-	app->state = _T3LOGO_STATE_FADE_IN;
-	app->fade = 1.0;
-	app->logo_fade = 0.0;
-	app->logo_vfade = _T3LOGO_FADE_IN;
-	app->spin_tick = 60;
-	app->angle = 0;
-	app->vf_angle = -get_acceleration(_T3LOGO_TARGET_ANGLE, app->spin_tick);
-	app->v_angle = get_punch_velocity(0, _T3LOGO_TARGET_ANGLE, -app->vf_angle);
-	app->tilt = 0;
-	app->vf_tilt = -get_acceleration(_T3LOGO_TARGET_TILT, app->spin_tick);
-	app->v_tilt = get_punch_tilt(0.0, _T3LOGO_TARGET_TILT, -app->vf_tilt);
-	update_logo(app);
-
-	return true;
+	t3f_select_view(t3f_default_view);
+	al_clear_to_color(_T3LOGO_BACKGROUND_COLOR);
+	t3logo_render(app->logo);
 }
 
-/* main logic routine */
-void app_logic(void * data)
+static bool handle_arguments(APP_INSTANCE * app, int argc, char * argv[])
 {
-	APP_INSTANCE * app = (APP_INSTANCE *)data;
+	int i;
 
-	switch(app->state)
+	for(i = 1; i < argc; i++)
 	{
-		case _T3LOGO_STATE_FADE_IN:
-		{
-			app->fade -= _T3LOGO_FADE_IN;
-			if(app->fade <= 0.0)
-			{
-				app->state = _T3LOGO_STATE_WAIT;
-				app->fade = 0.0;
-			}
-			break;
-		}
-		case _T3LOGO_STATE_WAIT:
+		if(!strcmp(argv[i], "--capture"))
 		{
-			if(t3f_key[ALLEGRO_KEY_SPACE] || app->tick >= 300)
-			{
-				t3f_play_sample(app->logo_bump_sound, 1.0, 0.0, 1.0);
-				app->state = _T3LOGO_STATE_SPIN;
-				t3f_key[ALLEGRO_KEY_SPACE] = 0;
-			}
-			/* manual controls */
-			if(t3f_key[ALLEGRO_KEY_LEFT])
-			{
-				app->angle -= ALLEGRO_PI / 16.0;
-				printf("angle %f\n", app->angle);
-				t3f_key[ALLEGRO_KEY_LEFT] = 0;
-			}
-			if(t3f_key[ALLEGRO_KEY_RIGHT])
-			{
-				app->angle += ALLEGRO_PI / 16.0;
-				printf("angle %f\n", app->angle);
-				t3f_key[ALLEGRO_KEY_RIGHT] = 0;
-			}
-			if(t3f_key[ALLEGRO_KEY_UP])
+			if(argc < i + 2)
 			{
-				app->tilt -= 0.1;
-				printf("tilt %f\n", app->tilt);
-				t3f_key[ALLEGRO_KEY_UP] = 0;
+				printf("Missing path argument!\n");
+				return false;
 			}
-			if(t3f_key[ALLEGRO_KEY_DOWN])
+			else
 			{
-				app->tilt += 0.1;
-				printf("tilt %f\n", app->tilt);
-				t3f_key[ALLEGRO_KEY_DOWN] = 0;
+				app->capture_path = argv[i + 1];
 			}
-			break;
 		}
-		case _T3LOGO_STATE_SPIN:
+		else if(!strcmp(argv[i], "--headless"))
 		{
-			if(app->spin_tick > -8)
-			{
-				app->tilt += app->v_tilt;
-				app->v_tilt += app->vf_tilt;
-				app->angle += app->v_angle;
-				app->v_angle += app->vf_angle;
-				app->spin_tick--;
-			}
-			else if(app->spin_tick == -8)
-			{
-				t3f_play_sample(app->logo_click_sound, 1.0, 0.0, 1.0);
-				app->tilt = _T3LOGO_TARGET_TILT;
-				app->angle = _T3LOGO_TARGET_ANGLE;
-				app->state = _T3LOGO_STATE_FADE_OUTLINE;
-				app->spin_tick--;
-			}
-			update_logo(app);
-			break;
+			app->headless = true;
 		}
-		case _T3LOGO_STATE_FADE_OUTLINE:
+		else if(!strcmp(argv[i], "--threads"))
 		{
-			app->logo_fade += app->logo_vfade;
-			if(app->logo_fade >= 1.0)
+			if(argc < i + 2)
 			{
-				app->logo_overlay_fade = 0.75;
-				app->logo_fade = 1.0;
-				app->state = _T3LOGO_STATE_FADE_FLASH;
+				printf("Missing thread count argument!\n");
+				return false;
 			}
-			break;
-		}
-		case _T3LOGO_STATE_FADE_FLASH:
-		{
-			app->logo_overlay_fade -= app->logo_vfade;
-			if(app->logo_overlay_fade <= 0.0)
+			else
 			{
-				app->logo_overlay_fade = 0.0;
-				app->state = _T3LOGO_STATE_DONE;
-				t3f_clear_keys();
+				app->capture_threads = atoi(argv[i + 1]);
 			}
-			break;
 		}
-		case _T3LOGO_STATE_DONE:
+		else if(!strcmp(argv[i], "--profile"))
 		{
-			if(t3f_key[ALLEGRO_KEY_R])
+			if(argc < i + 2)
 			{
-				setup_logo(app);
-				t3f_key[ALLEGRO_KEY_R] = 0;
+				printf("Missing path argument!\n");
+				return false;
 			}
-			else if(t3f_key_pressed() || app->tick >= 1200)
+			else
 			{
-				t3f_clear_keys();
-				app->state = _T3LOGO_STATE_FADE_OUT;
+				app->profile_path = argv[i + 1];
 			}
-			break;
 		}
-		case _T3LOGO_STATE_FADE_OUT:
+		else if(!strcmp(argv[i], "--trace"))
 		{
-			app->fade += _T3LOGO_FADE_IN;
-			if(app->fade >= 1.0)
+			if(argc < i + 2)
+			{
+				printf("Missing path argument!\n");
+				return false;
+			}
+			else
 			{
-				app->fade = 1.0;
-				t3f_exit();
+				app->trace_path = argv[i + 1];
 			}
 		}
 	}
-	if(app->capture_path)
+	if(app->headless && !app->capture_path)
 	{
-		app->tick++;
+		printf("Headless mode requires --capture!\n");
+		return false;
 	}
+	return true;
 }
 
-static bool avc_logic_wrapper(void * data)
+static bool save_capture_frame(const T3LOGO_CAPTURE_FRAME * fp, void * data)
 {
 	APP_INSTANCE * app = (APP_INSTANCE *)data;
+	char buf[1024];
 
-	app_logic(data);
-	if(app->tick < 1300)
-	{
-		return true;
-	}
-	return false;
+	snprintf(buf, 1024, "%s/frame_%05d.png", app->capture_path, fp->tick);
+	return al_save_bitmap(buf, fp->bitmap);
 }
 
-static void render_logo(APP_INSTANCE * app, bool outline)
+/* write the locked pixels straight out as a raw RGBA video stream */
+static bool write_capture_frame(const T3LOGO_CAPTURE_FRAME * fp, void * data)
 {
+	APP_INSTANCE * app = (APP_INSTANCE *)data;
+	int w = al_get_bitmap_width(fp->bitmap);
+	int h = al_get_bitmap_height(fp->bitmap);
+	size_t row_size = w * fp->region->pixel_size;
 	int i;
 
-	for(i = 0; i < 3; i++)
+	for(i = 0; i < h; i++)
 	{
-		render_shape(app->logo_side_zsort[i], outline);
+		if(al_fwrite(app->capture_file, (char *)fp->region->data + i * fp->region->pitch, row_size) != row_size)
+		{
+			return false;
+		}
 	}
+	return true;
 }
 
-/* main rendering routine */
-void app_render(void * data)
+static bool is_raw_capture_path(const char * path)
 {
-	APP_INSTANCE * app = (APP_INSTANCE *)data;
+	size_t l = strlen(path);
 
-	t3f_select_view(t3f_default_view);
-	al_clear_to_color(_T3LOGO_BACKGROUND_COLOR);
-	render_logo(app, true);
-	render_logo(app, false);
-	t3f_draw_scaled_bitmap(app->logo_bitmap, al_map_rgba_f(app->logo_fade, app->logo_fade, app->logo_fade, app->logo_fade), t3f_virtual_display_width / 2 - _T3LOGO_BITMAP_SIZE / 2, t3f_virtual_display_height / 2 - _T3LOGO_BITMAP_SIZE / 2 - 42 + _T3LOGO_Y_OFFSET, 0, _T3LOGO_BITMAP_SIZE, _T3LOGO_BITMAP_SIZE, 0);
-	t3f_draw_scaled_bitmap(app->logo_outline_bitmap, al_map_rgba_f(app->logo_overlay_fade, app->logo_overlay_fade, app->logo_overlay_fade, app->logo_overlay_fade), t3f_virtual_display_width / 2 - _T3LOGO_BITMAP_SIZE / 2, t3f_virtual_display_height / 2 - _T3LOGO_BITMAP_SIZE / 2 - 42 + _T3LOGO_Y_OFFSET, 0, _T3LOGO_BITMAP_SIZE, _T3LOGO_BITMAP_SIZE, 0);
-	al_draw_filled_rectangle(0, 0, t3f_virtual_display_width, t3f_virtual_display_height, al_map_rgba_f(0.0, 0.0, 0.0, app->fade));
+	return l > 4 && !strcmp(&path[l - 4], ".raw");
 }
 
-static bool handle_arguments(APP_INSTANCE * app, int argc, char * argv[])
+/* render the whole capture to memory bitmaps as fast as we can instead of
+   recording the display in real time, paths ending in .raw get a raw RGBA
+   stream and anything else is treated as a directory of PNG frames */
+static bool run_headless_capture(APP_INSTANCE * app)
 {
-	int i;
+	T3LOGO_CAPTURE_SETTINGS settings;
+	T3LOGO_CAPTURE_STATS stats;
+	bool ret;
 
-	for(i = 1; i < argc; i++)
+	t3logo_capture_default_settings(&settings, _T3LOGO_CAPTURE_WIDTH, _T3LOGO_CAPTURE_HEIGHT, _T3LOGO_CAPTURE_TICKS);
+	if(is_raw_capture_path(app->capture_path))
 	{
-		if(!strcmp(argv[i], "--capture"))
+		app->capture_file = al_fopen(app->capture_path, "wb");
+		if(!app->capture_file)
 		{
-			if(argc < i + 2)
-			{
-				printf("Missing path argument!\n");
-				return false;
-			}
-			else
-			{
-				app->capture_path = argv[i + 1];
-			}
+			printf("Unable to open capture file!\n");
+			return false;
 		}
+		settings.frame_proc = write_capture_frame;
 	}
-	return true;
+	else
+	{
+		if(!al_make_directory(app->capture_path))
+		{
+			printf("Unable to create capture directory!\n");
+			return false;
+		}
+		settings.flags |= T3LOGO_CAPTURE_FLAG_NO_READBACK;
+		settings.frame_proc = save_capture_frame;
+	}
+	if(app->capture_threads > 0)
+	{
+		t3logo_capture_set_threads(&settings, app->capture_threads);
+	}
+	settings.background = _T3LOGO_BACKGROUND_COLOR;
+	settings.data = app;
+	ret = t3logo_capture(&settings, &stats);
+	if(app->capture_file)
+	{
+		al_fclose(app->capture_file);
+		app->capture_file = NULL;
+	}
+	printf("Captured %d frames in %0.2f seconds (%0.1f fps)\n", stats.frames, stats.time, stats.frames_per_second);
+	printf("Peak memory: %d of %d slots in use, %lu bytes of frames, %d render stalls\n", stats.peak_slots, settings.slots, (unsigned long)stats.peak_bytes, stats.render_stalls);
+	return ret;
 }
 
 /* initialize our app, load graphics, etc. */
@@ -418,6 +266,16 @@ bool app_initialize(APP_INSTANCE * app, int argc, char * argv[])
 	{
 		startup_flags &= ~T3F_USE_FULLSCREEN;
 	}
+	if(app->headless)
+	{
+		startup_flags = T3F_NO_DISPLAY;
+		if(!t3f_initialize(T3F_APP_TITLE, 1280, 720, 60.0, app_logic, app_render, startup_flags, app))
+		{
+			printf("Error initializing T3F\n");
+			return false;
+		}
+		return true;
+	}
 
 	/* initialize T3F */
 	if(!t3f_initialize(T3F_APP_TITLE, 1280, 720, 60.0, app_logic, app_render, startup_flags, app))
@@ -433,71 +291,25 @@ bool app_initialize(APP_INSTANCE * app, int argc, char * argv[])
 	al_resize_display(t3f_display, 1920, 1080);
 	al_hide_mouse_cursor(t3f_display);
 
-	app->logo_bitmap = al_load_bitmap("data/logo.png");
-	if(!app->logo_bitmap)
-	{
-		return false;
-	}
-	app->logo_outline_bitmap = al_load_bitmap("data/logo_outline.png");
-	if(!app->logo_outline_bitmap)
+	/* show frame timings and write them out when we exit */
+	if(app->profile_path)
 	{
-		return false;
+		t3f_enable_profiler(true, true);
+		t3f_set_profile_dump(app->profile_path);
 	}
-	app->logo_bump_sound = al_load_sample("data/movefail.wav");
-	if(!app->logo_bump_sound)
+	if(app->trace_path)
 	{
-		return false;
+		if(!t3f_start_trace(app->trace_path))
+		{
+			printf("Unable to start trace!\n");
+		}
 	}
-	app->logo_click_sound = al_load_sample("data/ncd.wav");
-	if(!app->logo_click_sound)
+
+	app->logo = t3logo_create(app->capture_path ? T3LOGO_FLAG_AUTO : 0);
+	if(!app->logo)
 	{
 		return false;
 	}
-	init_shape(&app->logo_side[0]);
-	add_vertex(&app->logo_side[0], -3, -3, -3);
-	add_vertex(&app->logo_side[0], 3, -3, -3);
-	add_vertex(&app->logo_side[0], -3, _T3LOGO_BAR_BOTTOM, -3);
-	add_vertex(&app->logo_side[0], 3, -3, -3);
-	add_vertex(&app->logo_side[0], 3, _T3LOGO_BAR_BOTTOM, -3);
-	add_vertex(&app->logo_side[0], -3, _T3LOGO_BAR_BOTTOM, -3);
-	add_vertex(&app->logo_side[0], -1, _T3LOGO_BAR_BOTTOM, -3);
-	add_vertex(&app->logo_side[0], 1, _T3LOGO_BAR_BOTTOM, -3);
-	add_vertex(&app->logo_side[0], -1, _T3LOGO_BOTTOM, -3);
-	add_vertex(&app->logo_side[0], 1, _T3LOGO_BAR_BOTTOM, -3);
-	add_vertex(&app->logo_side[0], 1, _T3LOGO_BOTTOM, -3);
-	add_vertex(&app->logo_side[0], -1, _T3LOGO_BOTTOM, -3);
-
-	init_shape(&app->logo_side[1]);
-	add_vertex(&app->logo_side[1], 3, -3, -3);
-	add_vertex(&app->logo_side[1], 3, -3, 3);
-	add_vertex(&app->logo_side[1], 3, _T3LOGO_BAR_BOTTOM, -3);
-	add_vertex(&app->logo_side[1], 3, -3, 3);
-	add_vertex(&app->logo_side[1], 3, _T3LOGO_BAR_BOTTOM, 3);
-	add_vertex(&app->logo_side[1], 3, _T3LOGO_BAR_BOTTOM, -3);
-	add_vertex(&app->logo_side[1], 3, _T3LOGO_BAR_BOTTOM, -1);
-	add_vertex(&app->logo_side[1], 3, _T3LOGO_BAR_BOTTOM, 1);
-	add_vertex(&app->logo_side[1], 3, _T3LOGO_BOTTOM, -1);
-	add_vertex(&app->logo_side[1], 3, _T3LOGO_BAR_BOTTOM, 1);
-	add_vertex(&app->logo_side[1], 3, _T3LOGO_BOTTOM, 1);
-	add_vertex(&app->logo_side[1], 3, _T3LOGO_BOTTOM, -1);
-
-	init_shape(&app->logo_side[2]);
-	add_vertex(&app->logo_side[2], -3, -3, 3);
-	add_vertex(&app->logo_side[2], 3, -3, 3);
-	add_vertex(&app->logo_side[2], -3, _T3LOGO_BAR_BOTTOM, 3);
-	add_vertex(&app->logo_side[2], 3, -3, 3);
-	add_vertex(&app->logo_side[2], 3, _T3LOGO_BAR_BOTTOM, 3);
-	add_vertex(&app->logo_side[2], -3, _T3LOGO_BAR_BOTTOM, 3);
-	add_vertex(&app->logo_side[2], -1, _T3LOGO_BAR_BOTTOM, 3);
-	add_vertex(&app->logo_side[2], 1, _T3LOGO_BAR_BOTTOM, 3);
-	add_vertex(&app->logo_side[2], -1, _T3LOGO_BOTTOM, 3);
-	add_vertex(&app->logo_side[2], 1, _T3LOGO_BAR_BOTTOM, 3);
-	add_vertex(&app->logo_side[2], 1, _T3LOGO_BOTTOM, 3);
-	add_vertex(&app->logo_side[2], -1, _T3LOGO_BOTTOM, 3);
-
-	app->logo_side_zsort[0] = &app->logo_side[0];
-	app->logo_side_zsort[1] = &app->logo_side[1];
-	app->logo_side_zsort[2] = &app->logo_side[2];
 
 	if(app->capture_path)
 	{
@@ -506,10 +318,6 @@ bool app_initialize(APP_INSTANCE * app, int argc, char * argv[])
 			printf("Unable to start capture!\n");
 		}
 	}
-	else
-	{
-		setup_logo(app);
-	}
 
 	return true;
 }
@@ -520,12 +328,26 @@ int main(int argc, char * argv[])
 
 	if(app_initialize(&app, argc, argv))
 	{
-		t3f_run();
+		if(app.headless)
+		{
+			if(!run_headless_capture(&app))
+			{
+				printf("Headless capture failed!\n");
+			}
+		}
+		else
+		{
+			t3f_run();
+		}
 	}
 	else
 	{
 		printf("Error: could not initialize T3F!\n");
 	}
+	if(app.logo)
+	{
+		t3logo_destroy(app.logo);
+	}
 	t3f_finish();
 	return 0;
 }
@@ -26,6 +26,7 @@ T3F_ANIMATION * t3f_create_animation(void)
 			return NULL;
 		}
 		ap->bitmaps->count = 0;
+		ap->frame_pool = NULL;
 		ap->frames = 0;
 		ap->frame_list_total = 0;
 		ap->flags = 0;
@@ -76,7 +77,14 @@ void t3f_destroy_animation(T3F_ANIMATION * ap)
 
 	for(i = 0; i < ap->frames; i++)
 	{
-		al_free(ap->frame[i]);
+		if(!t3f_pool_owns(ap->frame_pool, ap->frame[i]))
+		{
+			al_free(ap->frame[i]);
+		}
+	}
+	if(ap->frame_pool)
+	{
+		t3f_destroy_pool(ap->frame_pool);
 	}
 	if(!(ap->flags & T3F_ANIMATION_FLAG_EXTERNAL_BITMAPS))
 	{
@@ -85,7 +93,7 @@ void t3f_destroy_animation(T3F_ANIMATION * ap)
 			/* Attempt to destroy resource. If it fails, that means the user
 			 * probably constructed the animation manually, so destroy the bitmap
 			 * directly. */
-			if(!t3f_destroy_resource(ap->bitmaps->bitmap[i]))
+			if(!t3f_destroy_resource_ptr((void **)&ap->bitmaps->bitmap[i]))
 			{
 				al_destroy_bitmap(ap->bitmaps->bitmap[i]);
 			}
@@ -95,6 +103,33 @@ void t3f_destroy_animation(T3F_ANIMATION * ap)
 	al_free(ap);
 }
 
+/* frames come from a pool owned by the animation, the loaders size the first
+   slab to hold every frame in the file */
+static T3F_ANIMATION_FRAME * alloc_frame(T3F_ANIMATION * ap, int slab_frames)
+{
+	if(!ap->frame_pool)
+	{
+		ap->frame_pool = t3f_create_pool(sizeof(T3F_ANIMATION_FRAME), slab_frames > 0 ? slab_frames : T3F_ANIMATION_FRAME_SLAB);
+		if(!ap->frame_pool)
+		{
+			return NULL;
+		}
+	}
+	return t3f_pool_alloc(ap->frame_pool);
+}
+
+static void free_frame(T3F_ANIMATION * ap, T3F_ANIMATION_FRAME * fp)
+{
+	if(t3f_pool_owns(ap->frame_pool, fp))
+	{
+		t3f_pool_free(ap->frame_pool, fp);
+	}
+	else
+	{
+		al_free(fp);
+	}
+}
+
 /* see if header matches and return the version number, -1 is no match */
 static int check_header(char * h)
 {
@@ -142,7 +177,7 @@ T3F_ANIMATION * t3f_load_animation_f(ALLEGRO_FILE * fp, const char * fn)
 				ap->frames = al_fread16le(fp);
 				for(i = 0; i < ap->frames; i++)
 				{
-					ap->frame[i] = al_malloc(sizeof(T3F_ANIMATION_FRAME));
+					ap->frame[i] = alloc_frame(ap, ap->frames);
 					if(!ap->frame[i])
 					{
 						return NULL;
@@ -192,7 +227,7 @@ T3F_ANIMATION * t3f_load_animation_f(ALLEGRO_FILE * fp, const char * fn)
 				ap->frames = al_fread16le(fp);
 				for(i = 0; i < ap->frames; i++)
 				{
-					ap->frame[i] = al_malloc(sizeof(T3F_ANIMATION_FRAME));
+					ap->frame[i] = alloc_frame(ap, ap->frames);
 					if(!ap->frame[i])
 					{
 						return NULL;
@@ -311,7 +346,7 @@ int t3f_animation_delete_bitmap(T3F_ANIMATION * ap, int bitmap)
 
 	if(bitmap < ap->bitmaps->count)
 	{
-		if(!t3f_destroy_resource(ap->bitmaps->bitmap[bitmap]))
+		if(!t3f_destroy_resource_ptr((void **)&ap->bitmaps->bitmap[bitmap]))
 		{
 			al_destroy_bitmap(ap->bitmaps->bitmap[bitmap]);
 		}
@@ -330,7 +365,7 @@ int t3f_animation_delete_bitmap(T3F_ANIMATION * ap, int bitmap)
 
 int t3f_animation_add_frame(T3F_ANIMATION * ap, int bitmap, float x, float y, float z, float w, float h, float angle, int ticks, int flags)
 {
-	ap->frame[ap->frames] = al_malloc(sizeof(T3F_ANIMATION_FRAME));
+	ap->frame[ap->frames] = alloc_frame(ap, T3F_ANIMATION_FRAME_SLAB);
 	if(ap->frame[ap->frames])
 	{
 		ap->frame[ap->frames]->bitmap = bitmap;
@@ -369,7 +404,7 @@ int t3f_animation_delete_frame(T3F_ANIMATION * ap, int frame)
 
 	if(frame < ap->frames)
 	{
-		al_free(ap->frame[frame]);
+		free_frame(ap, ap->frame[frame]);
 	}
 	else
 	{
@@ -402,23 +437,15 @@ int t3f_animation_build_frame_list(T3F_ANIMATION * ap)
 
 bool t3f_add_animation_to_atlas(T3F_ATLAS * sap, T3F_ANIMATION * ap, int type)
 {
-	int i, failed = 0;
+	ALLEGRO_BITMAP ** bitmap[T3F_ANIMATION_MAX_BITMAPS];
+	int i;
 
 	/* add bitmaps to sprite sheet */
 	for(i = 0; i < ap->bitmaps->count; i++)
 	{
-		if(!t3f_add_bitmap_to_atlas(sap, &ap->bitmaps->bitmap[i], type))
-		{
-			failed = 1;
-		}
-	}
-
-	/* if all bitmaps added successfully, point ap bitmaps to new ones */
-	if(failed)
-	{
-		return false;
+		bitmap[i] = &ap->bitmaps->bitmap[i];
 	}
-	return true;
+	return t3f_add_bitmaps_to_atlas(sap, bitmap, ap->bitmaps->count, type);
 }
 
 /* in-game */
@@ -7,6 +7,7 @@
 
 #include <allegro5/allegro5.h>
 #include "atlas.h"
+#include "pool.h"
 
 #define T3F_ANIMATION_MAX_BITMAPS  256
 #define T3F_ANIMATION_MAX_FRAMES  1024
@@ -15,6 +16,9 @@
 #define T3F_ANIMATION_FLAG_ONCE             1
 #define T3F_ANIMATION_FLAG_EXTERNAL_BITMAPS 2
 
+/* frames added one at a time are pooled in slabs of this many */
+#define T3F_ANIMATION_FRAME_SLAB 8
+
 typedef struct
 {
 
@@ -44,6 +48,7 @@ typedef struct
     T3F_ANIMATION_BITMAPS * bitmaps;
 
 	T3F_ANIMATION_FRAME * frame[T3F_ANIMATION_MAX_FRAMES];
+	T3F_POOL * frame_pool;
 	int frames;
 
 	int frame_list[T3F_ANIMATION_MAX_FRAMES];
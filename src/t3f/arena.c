@@ -0,0 +1,200 @@
+#include "t3f.h"
+#include "arena.h"
+
+/* bump allocator for data that only lives until the next reset, t3f_run()
+   resets the main thread's arena every logic tick so nothing allocated from
+   it may be kept past the frame it was allocated in
+
+   each thread has its own arena so allocating never takes a lock, threads
+   without an arena get NULL back and need to fall back to the heap */
+
+typedef struct T3F_FRAME_ARENA_OVERFLOW T3F_FRAME_ARENA_OVERFLOW;
+
+struct T3F_FRAME_ARENA_OVERFLOW
+{
+
+	T3F_FRAME_ARENA_OVERFLOW * next;
+
+};
+
+typedef struct
+{
+
+	char * data;
+	T3F_FRAME_ARENA_OVERFLOW * overflow;
+	size_t overflow_size;
+	T3F_FRAME_ARENA_STATS stats;
+
+} T3F_FRAME_ARENA;
+
+static T3F_THREAD_LOCAL T3F_FRAME_ARENA * t3f_frame_arena = NULL;
+
+static size_t align_size(size_t size)
+{
+	return (size + T3F_FRAME_ARENA_ALIGN - 1) & ~((size_t)T3F_FRAME_ARENA_ALIGN - 1);
+}
+
+static void free_overflow(T3F_FRAME_ARENA * ap)
+{
+	T3F_FRAME_ARENA_OVERFLOW * op;
+
+	while(ap->overflow)
+	{
+		op = ap->overflow;
+		ap->overflow = op->next;
+		free(op);
+	}
+	ap->overflow_size = 0;
+}
+
+/* give the calling thread an arena, pass 0 for the default size */
+bool t3f_create_frame_arena(size_t size)
+{
+	T3F_FRAME_ARENA * ap;
+
+	if(t3f_frame_arena)
+	{
+		return true;
+	}
+	if(!size)
+	{
+		size = T3F_FRAME_ARENA_DEFAULT_SIZE;
+	}
+	size = align_size(size);
+	ap = malloc(sizeof(T3F_FRAME_ARENA));
+	if(!ap)
+	{
+		return false;
+	}
+	memset(ap, 0, sizeof(T3F_FRAME_ARENA));
+	ap->data = malloc(size);
+	if(!ap->data)
+	{
+		free(ap);
+		return false;
+	}
+	ap->stats.size = size;
+	t3f_frame_arena = ap;
+	return true;
+}
+
+void t3f_destroy_frame_arena(void)
+{
+	if(t3f_frame_arena)
+	{
+		free_overflow(t3f_frame_arena);
+		free(t3f_frame_arena->data);
+		free(t3f_frame_arena);
+		t3f_frame_arena = NULL;
+	}
+}
+
+/* if the last frame overflowed, grow so the next one fits without going to
+   the heap */
+void t3f_reset_frame_arena(void)
+{
+	T3F_FRAME_ARENA * ap = t3f_frame_arena;
+	char * new_data;
+	size_t new_size;
+
+	if(!ap)
+	{
+		return;
+	}
+	if(ap->overflow)
+	{
+		free_overflow(ap);
+		new_size = align_size(ap->stats.high_water + ap->stats.high_water / 4);
+		new_data = malloc(new_size);
+		if(new_data)
+		{
+			free(ap->data);
+			ap->data = new_data;
+			ap->stats.size = new_size;
+		}
+	}
+	ap->stats.used = 0;
+	ap->stats.resets++;
+}
+
+bool t3f_get_frame_arena_stats(T3F_FRAME_ARENA_STATS * sp)
+{
+	if(!t3f_frame_arena)
+	{
+		return false;
+	}
+	memcpy(sp, &t3f_frame_arena->stats, sizeof(T3F_FRAME_ARENA_STATS));
+	return true;
+}
+
+/* memory is aligned to T3F_FRAME_ARENA_ALIGN and freed at the next reset */
+void * t3f_frame_alloc(size_t size)
+{
+	T3F_FRAME_ARENA * ap = t3f_frame_arena;
+	T3F_FRAME_ARENA_OVERFLOW * op;
+	void * p;
+
+	if(!ap)
+	{
+		return NULL;
+	}
+	size = align_size(size);
+	if(ap->stats.used + size <= ap->stats.size)
+	{
+		p = ap->data + ap->stats.used;
+		ap->stats.used += size;
+		if(ap->stats.used + ap->overflow_size > ap->stats.high_water)
+		{
+			ap->stats.high_water = ap->stats.used + ap->overflow_size;
+		}
+		return p;
+	}
+
+	/* out of room, keep working from the heap until the next reset */
+	op = malloc(align_size(sizeof(T3F_FRAME_ARENA_OVERFLOW)) + size);
+	if(!op)
+	{
+		return NULL;
+	}
+	op->next = ap->overflow;
+	ap->overflow = op;
+	ap->overflow_size += size;
+	ap->stats.overflows++;
+	if(ap->stats.used + ap->overflow_size > ap->stats.high_water)
+	{
+		ap->stats.high_water = ap->stats.used + ap->overflow_size;
+	}
+	return (char *)op + align_size(sizeof(T3F_FRAME_ARENA_OVERFLOW));
+}
+
+char * t3f_frame_vsprintf(const char * format, va_list vap)
+{
+	va_list vap_copy;
+	char * buf;
+	int size;
+
+	va_copy(vap_copy, vap);
+	size = vsnprintf(NULL, 0, format, vap_copy);
+	va_end(vap_copy);
+	if(size < 0)
+	{
+		return NULL;
+	}
+	buf = t3f_frame_alloc(size + 1);
+	if(buf)
+	{
+		vsnprintf(buf, size + 1, format, vap);
+	}
+	return buf;
+}
+
+char * t3f_frame_sprintf(const char * format, ...)
+{
+	va_list vap;
+	char * buf;
+
+	va_start(vap, format);
+	buf = t3f_frame_vsprintf(format, vap);
+	va_end(vap);
+	return buf;
+}
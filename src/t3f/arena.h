@@ -0,0 +1,30 @@
+#ifndef T3F_ARENA_H
+#define T3F_ARENA_H
+
+#include <allegro5/allegro5.h>
+#include <stdarg.h>
+
+#define T3F_FRAME_ARENA_DEFAULT_SIZE (256 * 1024)
+#define T3F_FRAME_ARENA_ALIGN        16
+
+typedef struct
+{
+
+	size_t size;
+	size_t used;
+	size_t high_water;         // most used at once since the arena was created, including overflow
+	unsigned long resets;
+	unsigned long overflows;   // allocations that didn't fit and went to the heap
+
+} T3F_FRAME_ARENA_STATS;
+
+bool t3f_create_frame_arena(size_t size);
+void t3f_destroy_frame_arena(void);
+void t3f_reset_frame_arena(void);
+bool t3f_get_frame_arena_stats(T3F_FRAME_ARENA_STATS * sp);
+
+void * t3f_frame_alloc(size_t size);
+char * t3f_frame_vsprintf(const char * format, va_list vap);
+char * t3f_frame_sprintf(const char * format, ...);
+
+#endif
@@ -1,50 +1,131 @@
 #include "t3f.h"
+#include "file.h"
 #include "resource.h"
 
+#define _T3F_ATLAS_CACHE_MAGIC "T3FA"
+
+/* a bitmap on a cached atlas that still has to be composed */
+typedef struct
+{
+
+	T3F_ATLAS * page;
+	ALLEGRO_BITMAP * bitmap;
+	bool owned; // destroy the bitmap once it has been composed
+	int type;
+	int x, y;
+
+} T3F_ATLAS_PENDING;
+
+struct T3F_ATLAS_CACHE
+{
+
+	char filename[1024];
+	uint64_t key;
+	bool keyed; // false if anything that can't be keyed was added
+
+	T3F_ATLAS_PENDING * pending;
+	int pending_count;
+	int pending_size;
+
+};
+
+/* a bitmap uploaded to a page with a compressed shadow, the pixels follow */
+struct T3F_ATLAS_PATCH
+{
+
+	int x, y, width, height;
+	unsigned char * data;
+	T3F_ATLAS_PATCH * next;
+
+};
+
 static T3F_ATLAS * t3f_atlas[T3F_MAX_ATLASES] = {NULL};
 static int t3f_atlases = 0;
 
+static void free_atlas_cache(T3F_ATLAS * ap);
+static void free_atlas_shadow(T3F_ATLAS * ap);
+
+/* the page keeps a one pixel border free for consistency with filtered bitmaps */
+static void reset_atlas_packer(T3F_ATLAS * ap)
+{
+	ap->skyline[0].x = 1;
+	ap->skyline[0].y = 1;
+	ap->skyline[0].width = ap->width - 2;
+	ap->skyline_nodes = 1;
+	ap->used_area = 0;
+	ap->drawn = false;
+}
+
+static void clear_atlas_page(T3F_ATLAS * ap)
+{
+	ALLEGRO_STATE old_state;
+
+	al_store_state(&old_state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+	al_set_target_bitmap(ap->page);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+	al_clear_to_color(al_map_rgba_f(0.0, 0.0, 0.0, 0.0));
+	al_restore_state(&old_state);
+}
+
 /* create an empty atlas of the specified type and size */
 T3F_ATLAS * t3f_create_atlas(int w, int h)
 {
 	T3F_ATLAS * ap;
-	ALLEGRO_STATE old_state;
 
-	ap = al_malloc(sizeof(T3F_ATLAS));
+	if(t3f_atlases >= T3F_MAX_ATLASES || w < 3 || h < 3)
+	{
+		return NULL;
+	}
+	t3f_push_memory_tag(T3F_MEMORY_TAG_ATLAS);
+	ap = al_calloc(1, sizeof(T3F_ATLAS));
 	if(!ap)
 	{
+		t3f_pop_memory_tag();
+		return NULL;
+	}
+
+	/* every node is at least a pixel wide so the width bounds the count */
+	ap->skyline = al_malloc(sizeof(T3F_ATLAS_SKYLINE_NODE) * w);
+	if(!ap->skyline)
+	{
+		t3f_pop_memory_tag();
+		al_free(ap);
 		return NULL;
 	}
 	ap->page = al_create_bitmap(w, h);
+	t3f_pop_memory_tag();
 	if(!ap->page)
 	{
+		al_free(ap->skyline);
 		al_free(ap);
 		return NULL;
 	}
-	ap->x = 1; // start at 1 so we get consistency with filtered bitmaps
-	ap->y = 1;
 	ap->width = w;
 	ap->height = h;
-	ap->line_height = 0;
-	ap->bitmaps = 0;
-
-	al_store_state(&old_state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
-	al_set_target_bitmap(ap->page);
-	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
-	al_clear_to_color(al_map_rgba_f(0.0, 0.0, 0.0, 0.0));
-	al_restore_state(&old_state);
+	reset_atlas_packer(ap);
+	clear_atlas_page(ap);
 
 	t3f_atlas[t3f_atlases] = ap;
 	t3f_atlases++;
 	return ap;
 }
 
-/* destroy the atlas */
+/* destroy the atlas along with any pages it spilled onto */
 void t3f_destroy_atlas(T3F_ATLAS * ap)
 {
 	int i, j;
 
+	if(ap->cache)
+	{
+		free_atlas_cache(ap);
+	}
+	if(ap->next)
+	{
+		t3f_destroy_atlas(ap->next);
+	}
 	al_destroy_bitmap(ap->page);
+	free_atlas_shadow(ap);
+	al_free(ap->skyline);
 	al_free(ap);
 	for(i = 0; i < t3f_atlases; i++)
 	{
@@ -60,195 +141,1212 @@ void t3f_destroy_atlas(T3F_ATLAS * ap)
 	}
 }
 
-#ifndef ALLEGRO_ANDROID
+/* empty the atlas so it can be filled again, bitmaps that were placed on it
+   should be destroyed first */
+void t3f_clear_atlas(T3F_ATLAS * ap)
+{
+	if(ap->cache)
+	{
+		free_atlas_cache(ap);
+	}
+	if(ap->next)
+	{
+		t3f_destroy_atlas(ap->next);
+		ap->next = NULL;
+	}
+	ap->bitmaps = 0;
+	free_atlas_shadow(ap);
+	reset_atlas_packer(ap);
+	if(ap->page)
+	{
+		clear_atlas_page(ap);
+	}
+}
+
+/* lowest y a w wide rectangle can sit at starting from node i, or -1 if it
+   runs off the page */
+static int skyline_fit(T3F_ATLAS * ap, int i, int w, int h)
+{
+	int x = ap->skyline[i].x;
+	int y = 0;
+	int left = w;
 
-	static void t3f_actually_put_bitmap_on_atlas_fbo(T3F_ATLAS * ap, ALLEGRO_BITMAP * bp, int type)
+	if(x + w > ap->width - 1)
+	{
+		return -1;
+	}
+	while(left > 0)
 	{
-		switch(type)
+		if(ap->skyline[i].y > y)
 		{
-			case T3F_ATLAS_TILE:
-			{
-				/* need to extend edges of tiles so they don't have soft edges */
-				al_draw_bitmap(bp, ap->x, ap->y, 0);
-				al_draw_bitmap(bp, ap->x + 2, ap->y, 0);
-				al_draw_bitmap(bp, ap->x, ap->y + 2, 0);
-				al_draw_bitmap(bp, ap->x + 2, ap->y + 2, 0);
-				al_draw_bitmap(bp, ap->x + 1, ap->y, 0);
-				al_draw_bitmap(bp, ap->x + 1, ap->y + 2, 0);
-				al_draw_bitmap(bp, ap->x, ap->y + 1, 0);
-				al_draw_bitmap(bp, ap->x + 2, ap->y + 1, 0);
-				al_draw_bitmap(bp, ap->x + 1, ap->y + 1, 0);
-				break;
-			}
-			case T3F_ATLAS_SPRITE:
+			y = ap->skyline[i].y;
+		}
+		if(y + h > ap->height - 1)
+		{
+			return -1;
+		}
+		left -= ap->skyline[i].width;
+		i++;
+	}
+	return y;
+}
+
+/* find a spot for a w by h rectangle, lowest top edge wins and ties go to
+   the narrowest node so gaps get filled before open space */
+static int skyline_find(T3F_ATLAS * ap, int w, int h, int * x, int * y)
+{
+	int i, fit_y;
+	int best = -1;
+	int best_bottom = 0, best_width = 0;
+
+	for(i = 0; i < ap->skyline_nodes; i++)
+	{
+		fit_y = skyline_fit(ap, i, w, h);
+		if(fit_y >= 0)
+		{
+			if(best < 0 || fit_y + h < best_bottom || (fit_y + h == best_bottom && ap->skyline[i].width < best_width))
 			{
-				al_draw_bitmap(bp, ap->x + 1, ap->y + 1, 0);
-				break;
+				best = i;
+				best_bottom = fit_y + h;
+				best_width = ap->skyline[i].width;
+				*x = ap->skyline[i].x;
+				*y = fit_y;
 			}
 		}
 	}
+	return best;
+}
 
-#endif
+/* raise the skyline over a rectangle placed at node i */
+static void skyline_add(T3F_ATLAS * ap, int i, int x, int y, int w, int h)
+{
+	int j, shrink;
 
-#ifdef ALLEGRO_ANDROID
+	memmove(&ap->skyline[i + 1], &ap->skyline[i], sizeof(T3F_ATLAS_SKYLINE_NODE) * (ap->skyline_nodes - i));
+	ap->skyline[i].x = x;
+	ap->skyline[i].y = y + h;
+	ap->skyline[i].width = w;
+	ap->skyline_nodes++;
 
-	static void t3f_pixel_copy_bitmap(ALLEGRO_BITMAP * src, ALLEGRO_BITMAP * dest, int x, int y)
+	/* trim or remove the nodes the new one covers */
+	for(j = i + 1; j < ap->skyline_nodes; j++)
 	{
-		int i, j;
-		ALLEGRO_STATE old_state;
+		shrink = ap->skyline[j - 1].x + ap->skyline[j - 1].width - ap->skyline[j].x;
+		if(shrink <= 0)
+		{
+			break;
+		}
+		ap->skyline[j].x += shrink;
+		ap->skyline[j].width -= shrink;
+		if(ap->skyline[j].width > 0)
+		{
+			break;
+		}
+		memmove(&ap->skyline[j], &ap->skyline[j + 1], sizeof(T3F_ATLAS_SKYLINE_NODE) * (ap->skyline_nodes - j - 1));
+		ap->skyline_nodes--;
+		j--;
+	}
 
-		al_store_state(&old_state, ALLEGRO_STATE_TARGET_BITMAP);
-		al_lock_bitmap_region(dest, x, y, al_get_bitmap_width(src), al_get_bitmap_height(src), ALLEGRO_PIXEL_FORMAT_RGBA_8888, ALLEGRO_LOCK_WRITEONLY);
-		al_lock_bitmap(src, ALLEGRO_PIXEL_FORMAT_RGBA_8888, ALLEGRO_LOCK_READONLY);
-		al_set_target_bitmap(dest);
-		for(i = 0; i < al_get_bitmap_height(src); i++)
+	/* merge neighbors at the same height */
+	for(j = 0; j < ap->skyline_nodes - 1; j++)
+	{
+		if(ap->skyline[j].y == ap->skyline[j + 1].y)
 		{
-			for(j = 0; j < al_get_bitmap_width(src); j++)
-			{
-				al_put_pixel(x + j, y + i, al_get_pixel(src, j, i));
-			}
+			ap->skyline[j].width += ap->skyline[j + 1].width;
+			memmove(&ap->skyline[j + 1], &ap->skyline[j + 2], sizeof(T3F_ATLAS_SKYLINE_NODE) * (ap->skyline_nodes - j - 2));
+			ap->skyline_nodes--;
+			j--;
 		}
-		al_unlock_bitmap(src);
-		al_unlock_bitmap(dest);
-		al_restore_state(&old_state);
 	}
+	ap->used_area += w * h;
+}
 
-	static void t3f_actually_put_bitmap_on_atlas_pixel_copy(T3F_ATLAS * ap, ALLEGRO_BITMAP * bp, int type)
+/* runs of three or more equal pixels become a count with the high bit set
+   followed by the pixel, anything else is a count followed by the pixels,
+   pass NULL for out to find the size */
+static int encode_atlas_shadow(const uint32_t * src, int count, uint32_t * out)
+{
+	int i = 0, j, n = 0;
+	int literal = -1;
+
+	while(i < count)
 	{
-		switch(type)
+		for(j = i + 1; j < count && src[j] == src[i]; j++);
+		if(j - i >= 3)
 		{
-			case T3F_ATLAS_TILE:
+			if(out)
 			{
-				/* need to extend edges of tiles so they don't have soft edges */
-				t3f_pixel_copy_bitmap(bp, ap->page, ap->x, ap->y);
-				t3f_pixel_copy_bitmap(bp, ap->page, ap->x + 2, ap->y);
-				t3f_pixel_copy_bitmap(bp, ap->page, ap->x, ap->y + 2);
-				t3f_pixel_copy_bitmap(bp, ap->page, ap->x + 2, ap->y + 2);
-				t3f_pixel_copy_bitmap(bp, ap->page, ap->x + 1, ap->y);
-				t3f_pixel_copy_bitmap(bp, ap->page, ap->x + 1, ap->y + 2);
-				t3f_pixel_copy_bitmap(bp, ap->page, ap->x, ap->y + 1);
-				t3f_pixel_copy_bitmap(bp, ap->page, ap->x + 2, ap->y + 1);
-				t3f_pixel_copy_bitmap(bp, ap->page, ap->x + 1, ap->y + 1);
-				break;
+				out[n] = 0x80000000u | (j - i);
+				out[n + 1] = src[i];
+			}
+			n += 2;
+			literal = -1;
+			i = j;
+		}
+		else
+		{
+			if(literal < 0)
+			{
+				literal = n;
+				if(out)
+				{
+					out[n] = 0;
+				}
+				n++;
 			}
-			case T3F_ATLAS_SPRITE:
+			if(out)
 			{
-				t3f_pixel_copy_bitmap(bp, ap->page, ap->x + 1, ap->y + 1);
-				break;
+				out[literal]++;
+				out[n] = src[i];
 			}
+			n++;
+			i++;
 		}
 	}
+	return n;
+}
 
-#endif
+static void decode_atlas_shadow(const uint32_t * src, int size, unsigned char * dest, int pitch, int width)
+{
+	unsigned char * row = dest;
+	uint32_t count, k;
+	int i = 0, x = 0;
 
-ALLEGRO_BITMAP * t3f_put_bitmap_on_atlas(T3F_ATLAS * ap, ALLEGRO_BITMAP ** bp, int type)
+	while(i < size)
+	{
+		count = src[i] & 0x7FFFFFFFu;
+		for(k = 0; k < count; k++)
+		{
+			memcpy(row + x * 4, (src[i] & 0x80000000u) ? &src[i + 1] : &src[i + 1 + k], 4);
+			x++;
+			if(x == width)
+			{
+				x = 0;
+				row += pitch;
+			}
+		}
+		i += (src[i] & 0x80000000u) ? 2 : 1 + count;
+	}
+}
+
+/* replace the compressed copy of the page with a whole page of pixels */
+static bool shadow_atlas_page(T3F_ATLAS * ap, const unsigned char * pixels)
 {
-	ALLEGRO_STATE old_state;
-	ALLEGRO_BITMAP * retbp = NULL;
-	ALLEGRO_TRANSFORM identity_transform;
+	int size;
 
-	if(ap->y >= al_get_bitmap_height(ap->page))
+	size = encode_atlas_shadow((const uint32_t *)pixels, ap->width * ap->height, NULL);
+	if(ap->shadow)
 	{
-		return NULL;
+		al_free(ap->shadow);
+		ap->shadow = NULL;
+	}
+	t3f_push_memory_tag(T3F_MEMORY_TAG_ATLAS);
+	ap->shadow = al_malloc(size * sizeof(uint32_t));
+	t3f_pop_memory_tag();
+	if(!ap->shadow)
+	{
+		ap->shadow_size = 0;
+		return false;
 	}
+	encode_atlas_shadow((const uint32_t *)pixels, ap->width * ap->height, ap->shadow);
+	ap->shadow_size = size;
+	return true;
+}
 
-	al_store_state(&old_state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER | ALLEGRO_STATE_TRANSFORM);
-	al_set_target_bitmap(ap->page);
-	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
-	al_identity_transform(&identity_transform);
-	al_use_transform(&identity_transform);
+static void free_atlas_patches(T3F_ATLAS * ap)
+{
+	T3F_ATLAS_PATCH * next;
 
-	/* move position if we need to */
-	if(ap->x + al_get_bitmap_width(*bp) + 2 >= al_get_bitmap_width(ap->page))
+	while(ap->patch)
 	{
-		ap->x = 1; // start at 1 so we get consistency with filtered bitmaps
-		ap->y += ap->line_height;
+		next = ap->patch->next;
+		al_free(ap->patch);
+		ap->patch = next;
+	}
+	ap->patch_size = 0;
+}
 
-		/* if it still doesn't fit, fail */
-		if(ap->y  + al_get_bitmap_height(*bp) + 2 >= al_get_bitmap_height(ap->page))
+static void apply_atlas_patches(T3F_ATLAS * ap, unsigned char * dest, int pitch)
+{
+	T3F_ATLAS_PATCH * pp;
+	int i;
+
+	for(pp = ap->patch; pp; pp = pp->next)
+	{
+		for(i = 0; i < pp->height; i++)
 		{
-			al_restore_state(&old_state);
-			return NULL;
+			memcpy(dest + (pp->y + i) * pitch + pp->x * 4, pp->data + i * pp->width * 4, pp->width * 4);
 		}
 	}
-	#ifdef ALLEGRO_ANDROID
-		t3f_actually_put_bitmap_on_atlas_pixel_copy(ap, *bp, type);
-	#else
-		t3f_actually_put_bitmap_on_atlas_fbo(ap, *bp, type);
-	#endif
-	retbp = al_create_sub_bitmap(ap->page, ap->x + 1, ap->y + 1, al_get_bitmap_width(*bp), al_get_bitmap_height(*bp));
-	ap->x += al_get_bitmap_width(*bp) + 2;
-	if(al_get_bitmap_height(*bp) + 2 > ap->line_height)
+}
+
+/* encoding means going over the whole page so the patches are only folded
+   into the shadow when the display goes away or they take up too much
+   memory */
+static bool fold_atlas_patches(T3F_ATLAS * ap)
+{
+	unsigned char * pixels;
+	bool ret;
+
+	if(!ap->patch)
 	{
-		ap->line_height = al_get_bitmap_height(*bp) + 2;
+		return true;
 	}
-	al_restore_state(&old_state);
-	return retbp;
+	t3f_push_memory_tag(T3F_MEMORY_TAG_ATLAS);
+	pixels = al_calloc(1, ap->width * ap->height * 4);
+	t3f_pop_memory_tag();
+	if(!pixels)
+	{
+		return false;
+	}
+	if(ap->shadow)
+	{
+		decode_atlas_shadow(ap->shadow, ap->shadow_size, pixels, ap->width * 4, ap->width);
+	}
+	apply_atlas_patches(ap, pixels, ap->width * 4);
+	ret = shadow_atlas_page(ap, pixels);
+	if(ret)
+	{
+		free_atlas_patches(ap);
+	}
+	al_free(pixels);
+	return ret;
 }
 
-/* fix for when you have exceeded the size of the sprite sheet */
-bool t3f_add_bitmap_to_atlas(T3F_ATLAS * ap, ALLEGRO_BITMAP ** bp, int type)
+static void free_atlas_shadow(T3F_ATLAS * ap)
 {
-	ALLEGRO_BITMAP * retbp = NULL;
+	free_atlas_patches(ap);
+	if(ap->shadow)
+	{
+		al_free(ap->shadow);
+		ap->shadow = NULL;
+		ap->shadow_size = 0;
+	}
+	if(ap->staging)
+	{
+		al_free(ap->staging);
+		ap->staging = NULL;
+	}
+}
 
-	if(!bp || !*bp)
+/* the staging buffer holds the whole page, it is only used while the page
+   is empty or kept as a raw shadow, so the page itself is never read back */
+static bool stage_atlas_page(T3F_ATLAS * ap)
+{
+	if(ap->staging)
+	{
+		return true;
+	}
+	t3f_push_memory_tag(T3F_MEMORY_TAG_ATLAS);
+	ap->staging = al_calloc(1, ap->width * ap->height * 4);
+	t3f_pop_memory_tag();
+	if(!ap->staging)
 	{
 		return false;
 	}
-	retbp = t3f_put_bitmap_on_atlas(ap, bp, type);
-	if(retbp)
+	ap->dirty_x1 = ap->width;
+	ap->dirty_y1 = ap->height;
+	ap->dirty_x2 = 0;
+	ap->dirty_y2 = 0;
+	return true;
+}
+
+/* copy the bitmap with its padding to dest, tiles have their edges extruded
+   into the padding so filtering doesn't pull in the neighbors, sprites get a
+   transparent border */
+static bool compose_pixels(unsigned char * dest, int pitch, ALLEGRO_BITMAP * bp, int type)
+{
+	ALLEGRO_LOCKED_REGION * lr;
+	int w = al_get_bitmap_width(bp);
+	int h = al_get_bitmap_height(bp);
+	unsigned char * dp;
+	const unsigned char * sp;
+	int i;
+
+	lr = al_lock_bitmap(bp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+	if(!lr)
 	{
-		al_destroy_bitmap(*bp);
-		*bp = retbp;
-		ap->bitmap[ap->bitmaps] = bp;
-		ap->bitmap_type[ap->bitmaps] = type;
-		ap->bitmaps++;
+		return false;
 	}
+	for(i = 0; i < h; i++)
+	{
+		sp = (const unsigned char *)lr->data + i * lr->pitch;
+		dp = dest + (1 + i) * pitch;
+		memcpy(dp + 4, sp, w * 4);
+		if(type == T3F_ATLAS_TILE)
+		{
+			memcpy(dp, sp, 4);
+			memcpy(dp + (w + 1) * 4, sp + (w - 1) * 4, 4);
+		}
+		else
+		{
+			memset(dp, 0, 4);
+			memset(dp + (w + 1) * 4, 0, 4);
+		}
+	}
+	al_unlock_bitmap(bp);
+	if(type == T3F_ATLAS_TILE)
+	{
+		memcpy(dest, dest + pitch, (w + 2) * 4);
+		memcpy(dest + (h + 1) * pitch, dest + h * pitch, (w + 2) * 4);
+	}
+	else
+	{
+		memset(dest, 0, (w + 2) * 4);
+		memset(dest + (h + 1) * pitch, 0, (w + 2) * 4);
+	}
+	return true;
+}
 
+/* compose the bitmap into the staging buffer at x, y */
+static bool compose_bitmap(T3F_ATLAS * ap, ALLEGRO_BITMAP * bp, int type, int x, int y)
+{
+	int w = al_get_bitmap_width(bp);
+	int h = al_get_bitmap_height(bp);
+
+	if(!compose_pixels(ap->staging + (y * ap->width + x) * 4, ap->width * 4, bp, type))
+	{
+		return false;
+	}
+	if(x < ap->dirty_x1)
+	{
+		ap->dirty_x1 = x;
+	}
+	if(y < ap->dirty_y1)
+	{
+		ap->dirty_y1 = y;
+	}
+	if(x + w + 2 > ap->dirty_x2)
+	{
+		ap->dirty_x2 = x + w + 2;
+	}
+	if(y + h + 2 > ap->dirty_y2)
+	{
+		ap->dirty_y2 = y + h + 2;
+	}
 	return true;
 }
 
-void t3f_unload_atlases(void)
+/* compose the bitmap into a buffer just big enough for it and upload it at
+   x, y, for pages that already have bitmaps on them, a compressed shadow
+   keeps the buffer as a patch */
+static bool upload_bitmap(T3F_ATLAS * ap, ALLEGRO_BITMAP * bp, int type, int x, int y)
 {
+	ALLEGRO_LOCKED_REGION * lr;
+	T3F_ATLAS_PATCH * pp;
+	int w = al_get_bitmap_width(bp) + 2;
+	int h = al_get_bitmap_height(bp) + 2;
 	int i;
+	bool ret = false;
 
-	for(i = 0; i < t3f_atlases; i++)
+	t3f_push_memory_tag(T3F_MEMORY_TAG_ATLAS);
+	pp = al_malloc(sizeof(T3F_ATLAS_PATCH) + w * h * 4);
+	t3f_pop_memory_tag();
+	if(!pp)
 	{
-		al_destroy_bitmap(t3f_atlas[i]->page);
-		t3f_atlas[i]->page = NULL;
+		return false;
+	}
+	pp->x = x;
+	pp->y = y;
+	pp->width = w;
+	pp->height = h;
+	pp->data = (unsigned char *)(pp + 1);
+	if(compose_pixels(pp->data, w * 4, bp, type))
+	{
+		lr = al_lock_bitmap_region(ap->page, x, y, w, h, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+		if(lr)
+		{
+			for(i = 0; i < h; i++)
+			{
+				memcpy((char *)lr->data + i * lr->pitch, pp->data + i * w * 4, w * 4);
+			}
+			al_unlock_bitmap(ap->page);
+			ret = true;
+		}
+	}
+	if(ret && ap->shadow_mode == T3F_ATLAS_SHADOW_COMPRESSED)
+	{
+		pp->next = ap->patch;
+		ap->patch = pp;
+		ap->patch_size += w * h * 4;
+
+		/* don't let the patches grow past a quarter of the page */
+		if(ap->patch_size > ap->width * ap->height)
+		{
+			fold_atlas_patches(ap);
+		}
+	}
+	else
+	{
+		al_free(pp);
 	}
+	return ret;
 }
 
-bool t3f_rebuild_atlases(void)
+/* upload everything composed since the last flush with one lock */
+static bool flush_atlas_page(T3F_ATLAS * ap)
 {
-	ALLEGRO_STATE old_state;
-	int i, j;
-	ALLEGRO_BITMAP * bp;
+	ALLEGRO_LOCKED_REGION * lr;
+	int w, h, i;
+	bool ret = true;
 
-	for(i = 0; i < t3f_atlases; i++)
+	if(!ap->staging)
 	{
-		t3f_atlas[i]->page = al_create_bitmap(t3f_atlas[i]->width, t3f_atlas[i]->height);
-		if(!t3f_atlas[i]->page)
+		return true;
+	}
+	w = ap->dirty_x2 - ap->dirty_x1;
+	h = ap->dirty_y2 - ap->dirty_y1;
+	if(w > 0 && h > 0)
+	{
+		lr = al_lock_bitmap_region(ap->page, ap->dirty_x1, ap->dirty_y1, w, h, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+		if(lr)
 		{
-			return false;
+			for(i = 0; i < h; i++)
+			{
+				memcpy((char *)lr->data + i * lr->pitch, ap->staging + ((ap->dirty_y1 + i) * ap->width + ap->dirty_x1) * 4, w * 4);
+			}
+			al_unlock_bitmap(ap->page);
+			ap->drawn = true;
 		}
-		al_store_state(&old_state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
-		al_set_target_bitmap(t3f_atlas[i]->page);
-		al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
-		al_clear_to_color(al_map_rgba_f(0.0, 0.0, 0.0, 0.0));
-		al_restore_state(&old_state);
-		t3f_atlas[i]->x = 1; // start at 1 so we get consistency with filtered bitmaps
-		t3f_atlas[i]->y = 1;
-		t3f_atlas[i]->line_height = 0;
-		for(j = 0; j < t3f_atlas[i]->bitmaps; j++)
+		else
+		{
+			ret = false;
+		}
+		if(ap->shadow_mode == T3F_ATLAS_SHADOW_COMPRESSED && !shadow_atlas_page(ap, ap->staging))
+		{
+			ret = false;
+		}
+	}
+	ap->dirty_x1 = ap->width;
+	ap->dirty_y1 = ap->height;
+	ap->dirty_x2 = 0;
+	ap->dirty_y2 = 0;
+
+	/* raw shadows are the staging buffer */
+	if(ap->shadow_mode != T3F_ATLAS_SHADOW_RAW)
+	{
+		al_free(ap->staging);
+		ap->staging = NULL;
+	}
+	return ret;
+}
+
+/* put the shadow back on a recreated page with one upload */
+static bool restore_atlas_page(T3F_ATLAS * ap)
+{
+	ALLEGRO_LOCKED_REGION * lr;
+	int i;
+
+	lr = al_lock_bitmap(ap->page, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+	if(!lr)
+	{
+		return false;
+	}
+	if(ap->staging)
+	{
+		for(i = 0; i < ap->height; i++)
+		{
+			memcpy((char *)lr->data + i * lr->pitch, ap->staging + i * ap->width * 4, ap->width * 4);
+		}
+	}
+	else
+	{
+		if(ap->shadow)
+		{
+			decode_atlas_shadow(ap->shadow, ap->shadow_size, lr->data, lr->pitch, ap->width);
+		}
+		apply_atlas_patches(ap, lr->data, lr->pitch);
+	}
+	al_unlock_bitmap(ap->page);
+	return true;
+}
+
+static void flush_atlas(T3F_ATLAS * ap)
+{
+	for(; ap; ap = ap->next)
+	{
+		flush_atlas_page(ap);
+	}
+}
+
+/* find room for the bitmap and compose it, an empty page isn't touched until
+   the staging buffer is flushed */
+static ALLEGRO_BITMAP * place_bitmap_on_atlas(T3F_ATLAS * ap, ALLEGRO_BITMAP ** bp, int type, bool compose, int * px, int * py)
+{
+	ALLEGRO_BITMAP * retbp = NULL;
+	int w = al_get_bitmap_width(*bp);
+	int h = al_get_bitmap_height(*bp);
+	int node, x, y;
+
+	/* bitmaps get a pixel of padding on each side */
+	node = skyline_find(ap, w + 2, h + 2, &x, &y);
+	if(node < 0)
+	{
+		return NULL;
+	}
+	if(compose)
+	{
+		/* only the new bitmap goes up on a page that already has bitmaps */
+		if(ap->drawn && !ap->staging)
 		{
-			bp = t3f_put_bitmap_on_atlas(t3f_atlas[i], t3f_atlas[i]->bitmap[j], t3f_atlas[i]->bitmap_type[j]);
+			if(!upload_bitmap(ap, *bp, type, x, y))
+			{
+				return NULL;
+			}
+		}
+		else if(!stage_atlas_page(ap) || !compose_bitmap(ap, *bp, type, x, y))
+		{
+			return NULL;
+		}
+	}
+	t3f_push_memory_tag(T3F_MEMORY_TAG_ATLAS);
+	retbp = al_create_sub_bitmap(ap->page, x + 1, y + 1, w, h);
+	t3f_pop_memory_tag();
+	if(retbp)
+	{
+		skyline_add(ap, node, x, y, w + 2, h + 2);
+		if(px)
+		{
+			*px = x;
+			*py = y;
+		}
+	}
+	return retbp;
+}
+
+ALLEGRO_BITMAP * t3f_put_bitmap_on_atlas(T3F_ATLAS * ap, ALLEGRO_BITMAP ** bp, int type)
+{
+	ALLEGRO_BITMAP * retbp;
+
+	retbp = place_bitmap_on_atlas(ap, bp, type, true, NULL, NULL);
+	flush_atlas_page(ap);
+	return retbp;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void * data, int size)
+{
+	const unsigned char * p = data;
+	int i;
+
+	for(i = 0; i < size; i++)
+	{
+		h ^= p[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+static uint64_t hash_int(uint64_t h, int64_t val)
+{
+	unsigned char b[8];
+	int i;
+
+	/* byte by byte so the key is the same on every platform */
+	for(i = 0; i < 8; i++)
+	{
+		b[i] = (val >> (i * 8)) & 0xFF;
+	}
+	return hash_bytes(h, b, 8);
+}
+
+/* the key covers where each bitmap came from rather than its pixels, reading
+   the pixels back is what the cache is there to avoid */
+static void hash_atlas_input(T3F_ATLAS_CACHE * cp, ALLEGRO_BITMAP ** bp, int type)
+{
+	const T3F_RESOURCE * rp;
+	uint64_t size;
+	time_t mtime;
+
+	rp = t3f_get_resource_info((void **)bp);
+	if(!rp || rp->proc != t3f_bitmap_resource_handler_proc)
+	{
+		cp->keyed = false;
+		return;
+	}
+	cp->key = hash_int(cp->key, type);
+	cp->key = hash_int(cp->key, al_get_bitmap_width(*bp));
+	cp->key = hash_int(cp->key, al_get_bitmap_height(*bp));
+	cp->key = hash_bytes(cp->key, rp->filename, strlen(rp->filename) + 1);
+	cp->key = hash_int(cp->key, rp->offset);
+	cp->key = hash_int(cp->key, rp->option);
+	cp->key = hash_int(cp->key, rp->flags);
+
+	/* look where the resource was loaded from, a rebuilt pack has to change
+	   the key */
+	if(rp->fi != t3f_get_pack_file_interface() || !t3f_get_packed_file_info(rp->filename, &size, &mtime))
+	{
+		size = t3f_file_size(rp->filename);
+		mtime = t3f_get_file_mtime(rp->filename);
+	}
+	cp->key = hash_int(cp->key, size);
+	cp->key = hash_int(cp->key, mtime);
+}
+
+static bool add_pending_bitmap(T3F_ATLAS_CACHE * cp, T3F_ATLAS * page, ALLEGRO_BITMAP * bp, bool owned, int type, int x, int y)
+{
+	T3F_ATLAS_PENDING * new_pending;
+	int new_size;
+
+	if(cp->pending_count >= cp->pending_size)
+	{
+		new_size = cp->pending_size ? cp->pending_size * 2 : 64;
+		new_pending = al_realloc(cp->pending, sizeof(T3F_ATLAS_PENDING) * new_size);
+		if(!new_pending)
+		{
+			return false;
+		}
+		cp->pending = new_pending;
+		cp->pending_size = new_size;
+	}
+	cp->pending[cp->pending_count].page = page;
+	cp->pending[cp->pending_count].bitmap = bp;
+	cp->pending[cp->pending_count].owned = owned;
+	cp->pending[cp->pending_count].type = type;
+	cp->pending[cp->pending_count].x = x;
+	cp->pending[cp->pending_count].y = y;
+	cp->pending_count++;
+	return true;
+}
+
+/* places the bitmap on the first page with room for it, adding a page when
+   none has, and swaps the original for the piece of the atlas */
+static bool add_bitmap_to_atlas(T3F_ATLAS * ap, ALLEGRO_BITMAP ** bp, int type)
+{
+	ALLEGRO_BITMAP * retbp = NULL;
+	T3F_ATLAS * page;
+	bool shared;
+	int x, y;
+
+	if(!bp || !*bp)
+	{
+		return false;
+	}
+
+	/* too big for any page */
+	if(al_get_bitmap_width(*bp) + 2 > ap->width - 2 || al_get_bitmap_height(*bp) + 2 > ap->height - 2)
+	{
+		return false;
+	}
+	T3F_TRACE_BEGIN("add_bitmap_to_atlas");
+	for(page = ap; page; page = page->next)
+	{
+		if(page->page && page->bitmaps < T3F_ATLAS_MAX_BITMAPS)
+		{
+			retbp = place_bitmap_on_atlas(page, bp, type, !ap->cache, &x, &y);
+			if(retbp)
+			{
+				break;
+			}
+		}
+		if(!page->next)
+		{
+			page->next = t3f_create_atlas(ap->width, ap->height);
+			if(page->next)
+			{
+				page->next->shadow_mode = ap->shadow_mode;
+			}
+		}
+	}
+	T3F_TRACE_END();
+	if(!retbp)
+	{
+		return false;
+	}
+	if(ap->cache)
+	{
+		hash_atlas_input(ap->cache, bp, type);
+	}
+
+	/* other resources may still be using the original */
+	shared = t3f_detach_resource((void **)bp);
+
+	/* a shadowed page restores the bitmap itself */
+	if(ap->shadow_mode != T3F_ATLAS_SHADOW_NONE)
+	{
+		t3f_forget_resource((void **)bp);
+	}
+	if(ap->cache)
+	{
+		if(!add_pending_bitmap(ap->cache, page, *bp, !shared, type, x, y))
+		{
+			/* can't wait for the atlas to be finished */
+			stage_atlas_page(page);
+			compose_bitmap(page, *bp, type, x, y);
+			ap->cache->keyed = false;
+			if(!shared)
+			{
+				al_destroy_bitmap(*bp);
+			}
+		}
+	}
+	else if(!shared)
+	{
+		al_destroy_bitmap(*bp);
+	}
+	*bp = retbp;
+	page->bitmap[page->bitmaps] = bp;
+	page->bitmap_type[page->bitmaps] = type;
+	page->bitmap_rect[page->bitmaps].x = x + 1;
+	page->bitmap_rect[page->bitmaps].y = y + 1;
+	page->bitmap_rect[page->bitmaps].width = al_get_bitmap_width(retbp);
+	page->bitmap_rect[page->bitmaps].height = al_get_bitmap_height(retbp);
+	page->bitmaps++;
+	return true;
+}
+
+bool t3f_add_bitmap_to_atlas(T3F_ATLAS * ap, ALLEGRO_BITMAP ** bp, int type)
+{
+	bool ret;
+
+	ret = add_bitmap_to_atlas(ap, bp, type);
+	if(!ap->cache)
+	{
+		flush_atlas(ap);
+	}
+	return ret;
+}
+
+/* tallest first keeps the skyline flat */
+static int atlas_bitmap_sorter(const void * item1, const void * item2)
+{
+	ALLEGRO_BITMAP * bp1 = **(ALLEGRO_BITMAP ***)item1;
+	ALLEGRO_BITMAP * bp2 = **(ALLEGRO_BITMAP ***)item2;
+
+	if(al_get_bitmap_height(bp1) != al_get_bitmap_height(bp2))
+	{
+		return al_get_bitmap_height(bp2) - al_get_bitmap_height(bp1);
+	}
+	return al_get_bitmap_width(bp2) - al_get_bitmap_width(bp1);
+}
+
+/* add a batch of bitmaps, they pack tighter when the atlas sees them all at
+   once, returns false if any of them didn't make it */
+bool t3f_add_bitmaps_to_atlas(T3F_ATLAS * ap, ALLEGRO_BITMAP ** bp[], int count, int type)
+{
+	ALLEGRO_BITMAP *** sorted;
+	int i, sorted_count = 0;
+	bool ret = true;
+
+	sorted = al_malloc(sizeof(ALLEGRO_BITMAP **) * (count > 0 ? count : 1));
+	if(!sorted)
+	{
+		return false;
+	}
+	for(i = 0; i < count; i++)
+	{
+		if(bp[i] && *bp[i])
+		{
+			sorted[sorted_count] = bp[i];
+			sorted_count++;
+		}
+		else
+		{
+			ret = false;
+		}
+	}
+	qsort(sorted, sorted_count, sizeof(ALLEGRO_BITMAP **), atlas_bitmap_sorter);
+	for(i = 0; i < sorted_count; i++)
+	{
+		if(!add_bitmap_to_atlas(ap, sorted[i], type))
+		{
+			ret = false;
+		}
+	}
+	if(!ap->cache)
+	{
+		flush_atlas(ap);
+	}
+	al_free(sorted);
+	return ret;
+}
+
+/* keep a copy of the pages in memory so they can be put back after the
+   display is lost without reloading and recomposing the bitmaps on them, the
+   bitmaps are taken over from the resource manager so the atlas has to be
+   empty */
+bool t3f_set_atlas_shadow(T3F_ATLAS * ap, int mode)
+{
+	if(ap->bitmaps || ap->next || ap->cache)
+	{
+		return false;
+	}
+	ap->shadow_mode = mode;
+	return true;
+}
+
+/* bytes of memory used by the shadows of all the atlas pages */
+int t3f_get_atlas_shadow_size(T3F_ATLAS * ap)
+{
+	int size = 0;
+
+	for(; ap; ap = ap->next)
+	{
+		if(ap->shadow)
+		{
+			size += ap->shadow_size * sizeof(uint32_t);
+		}
+		else if(ap->staging && ap->shadow_mode == T3F_ATLAS_SHADOW_RAW)
+		{
+			size += ap->width * ap->height * 4;
+		}
+		size += ap->patch_size;
+	}
+	return size;
+}
+
+int t3f_get_atlas_pages(T3F_ATLAS * ap)
+{
+	int pages = 0;
+
+	for(; ap; ap = ap->next)
+	{
+		pages++;
+	}
+	return pages;
+}
+
+int t3f_get_atlas_bitmaps(T3F_ATLAS * ap)
+{
+	int bitmaps = 0;
+
+	for(; ap; ap = ap->next)
+	{
+		bitmaps += ap->bitmaps;
+	}
+	return bitmaps;
+}
+
+/* fraction of the atlas pages covered by bitmaps */
+float t3f_get_atlas_occupancy(T3F_ATLAS * ap)
+{
+	double used = 0.0, total = 0.0;
+
+	for(; ap; ap = ap->next)
+	{
+		used += ap->used_area;
+		total += (double)ap->width * (double)ap->height;
+	}
+	return total > 0.0 ? used / total : 0.0;
+}
+
+/* drop the cache along with the pending bitmaps without composing them */
+static void free_atlas_cache(T3F_ATLAS * ap)
+{
+	int i;
+
+	for(i = 0; i < ap->cache->pending_count; i++)
+	{
+		if(ap->cache->pending[i].owned)
+		{
+			al_destroy_bitmap(ap->cache->pending[i].bitmap);
+		}
+	}
+	if(ap->cache->pending)
+	{
+		al_free(ap->cache->pending);
+	}
+	al_free(ap->cache);
+	ap->cache = NULL;
+}
+
+/* defer composing until t3f_finish_atlas() so a cached copy of the pages can
+   be used instead, only works on an empty atlas, the cache is stored under
+   name in the temp directory */
+bool t3f_cache_atlas(T3F_ATLAS * ap, const char * name)
+{
+	char fn[256];
+
+	if(ap->cache || ap->bitmaps || ap->next || !t3f_temp_path)
+	{
+		return false;
+	}
+	ap->cache = al_calloc(1, sizeof(T3F_ATLAS_CACHE));
+	if(!ap->cache)
+	{
+		return false;
+	}
+	#ifdef T3F_PACKAGE_NAME
+		snprintf(fn, 256, "%s-atlas-%s.cache", T3F_PACKAGE_NAME, name);
+	#else
+		snprintf(fn, 256, "t3f-atlas-%s.cache", name);
+	#endif
+	if(!t3f_get_filename(t3f_temp_path, fn, ap->cache->filename, 1024))
+	{
+		free_atlas_cache(ap);
+		return false;
+	}
+	ap->cache->keyed = true;
+	ap->cache->key = hash_int(14695981039346656037ull, T3F_ATLAS_CACHE_VERSION);
+	ap->cache->key = hash_int(ap->cache->key, ap->width);
+	ap->cache->key = hash_int(ap->cache->key, ap->height);
+	return true;
+}
+
+/* cache file layout, all values little endian
+
+   magic, version, key (low and high word), pages, width, height, bitmaps
+   page, x, y for each bitmap in the order they were added
+   raw ABGR_8888_LE pixels for each page */
+static bool load_atlas_cache(T3F_ATLAS * ap)
+{
+	T3F_ATLAS_CACHE * cp = ap->cache;
+	ALLEGRO_FILE * fp;
+	T3F_ATLAS * page;
+	char magic[4];
+	int i, pages = t3f_get_atlas_pages(ap);
+	bool ret = false;
+
+	fp = al_fopen(cp->filename, "rb");
+	if(!fp)
+	{
+		return false;
+	}
+	if(al_fread(fp, magic, 4) != 4 || memcmp(magic, _T3F_ATLAS_CACHE_MAGIC, 4) || al_fread32le(fp) != T3F_ATLAS_CACHE_VERSION)
+	{
+		goto done;
+	}
+	if((uint32_t)al_fread32le(fp) != (uint32_t)cp->key || (uint32_t)al_fread32le(fp) != (uint32_t)(cp->key >> 32))
+	{
+		goto done;
+	}
+	if(al_fread32le(fp) != pages || al_fread32le(fp) != ap->width || al_fread32le(fp) != ap->height || al_fread32le(fp) != cp->pending_count)
+	{
+		goto done;
+	}
+
+	/* the packer is deterministic so the layout should match, a mismatch
+	   means the cache was written by something else */
+	for(i = 0; i < cp->pending_count; i++)
+	{
+		for(pages = 0, page = ap; page != cp->pending[i].page; page = page->next, pages++);
+		if(al_fread32le(fp) != pages || al_fread32le(fp) != cp->pending[i].x || al_fread32le(fp) != cp->pending[i].y)
+		{
+			goto done;
+		}
+	}
+	for(page = ap; page; page = page->next)
+	{
+		if(!stage_atlas_page(page))
+		{
+			goto done;
+		}
+		if(al_fread(fp, page->staging, page->width * page->height * 4) != page->width * page->height * 4)
+		{
+			goto done;
+		}
+	}
+	ret = true;
+
+	done:
+	{
+		al_fclose(fp);
+		return ret;
+	}
+}
+
+static bool save_atlas_cache(T3F_ATLAS * ap)
+{
+	T3F_ATLAS_CACHE * cp = ap->cache;
+	ALLEGRO_FILE * fp;
+	T3F_ATLAS * page;
+	int i, pages;
+	bool ret = true;
+
+	fp = al_fopen(cp->filename, "wb");
+	if(!fp)
+	{
+		return false;
+	}
+	al_fwrite(fp, _T3F_ATLAS_CACHE_MAGIC, 4);
+	al_fwrite32le(fp, T3F_ATLAS_CACHE_VERSION);
+	al_fwrite32le(fp, (uint32_t)cp->key);
+	al_fwrite32le(fp, (uint32_t)(cp->key >> 32));
+	al_fwrite32le(fp, t3f_get_atlas_pages(ap));
+	al_fwrite32le(fp, ap->width);
+	al_fwrite32le(fp, ap->height);
+	al_fwrite32le(fp, cp->pending_count);
+	for(i = 0; i < cp->pending_count; i++)
+	{
+		for(pages = 0, page = ap; page != cp->pending[i].page; page = page->next, pages++);
+		al_fwrite32le(fp, pages);
+		al_fwrite32le(fp, cp->pending[i].x);
+		al_fwrite32le(fp, cp->pending[i].y);
+	}
+	for(page = ap; page; page = page->next)
+	{
+		if(!stage_atlas_page(page) || al_fwrite(fp, page->staging, page->width * page->height * 4) != page->width * page->height * 4)
+		{
+			ret = false;
+			break;
+		}
+	}
+	if(al_ferror(fp))
+	{
+		ret = false;
+	}
+	al_fclose(fp);
+
+	/* don't leave a broken cache around */
+	if(!ret)
+	{
+		al_remove_filename(cp->filename);
+	}
+	return ret;
+}
+
+/* compose the bitmaps added since t3f_cache_atlas(), or load the pages from
+   the cache if it was made from the same bitmaps, and upload the pages */
+bool t3f_finish_atlas(T3F_ATLAS * ap)
+{
+	T3F_ATLAS_CACHE * cp = ap->cache;
+	T3F_ATLAS_PENDING * pp;
+	T3F_ATLAS * page;
+	bool ret = true;
+	int i;
+
+	if(!cp)
+	{
+		return true;
+	}
+	T3F_TRACE_BEGIN("finish_atlas");
+	if(!cp->keyed || !load_atlas_cache(ap))
+	{
+		/* throw away whatever a failed load left behind */
+		for(page = ap; cp->keyed && page; page = page->next)
+		{
+			if(page->staging)
+			{
+				memset(page->staging, 0, page->width * page->height * 4);
+			}
+		}
+		for(i = 0; i < cp->pending_count; i++)
+		{
+			pp = &cp->pending[i];
+			if(!stage_atlas_page(pp->page) || !compose_bitmap(pp->page, pp->bitmap, pp->type, pp->x, pp->y))
+			{
+				ret = false;
+			}
+		}
+		if(ret && cp->keyed)
+		{
+			save_atlas_cache(ap);
+		}
+	}
+
+	/* a cached page is uploaded whole */
+	for(page = ap; page; page = page->next)
+	{
+		if(page->staging)
+		{
+			page->dirty_x1 = 0;
+			page->dirty_y1 = 0;
+			page->dirty_x2 = page->width;
+			page->dirty_y2 = page->height;
+		}
+	}
+	flush_atlas(ap);
+	free_atlas_cache(ap);
+	T3F_TRACE_END();
+	return ret;
+}
+
+void t3f_unload_atlases(void)
+{
+	int i, j;
+
+	/* compose anything still waiting so the bitmaps can be let go of */
+	for(i = 0; i < t3f_atlases; i++)
+	{
+		if(t3f_atlas[i]->cache)
+		{
+			t3f_finish_atlas(t3f_atlas[i]);
+		}
+	}
+	for(i = 0; i < t3f_atlases; i++)
+	{
+		/* shadowed pages own their bitmaps, the rest are reloaded by the
+		   resource manager */
+		if(t3f_atlas[i]->shadow_mode != T3F_ATLAS_SHADOW_NONE)
+		{
+			for(j = 0; j < t3f_atlas[i]->bitmaps; j++)
+			{
+				if(*t3f_atlas[i]->bitmap[j])
+				{
+					al_destroy_bitmap(*t3f_atlas[i]->bitmap[j]);
+					*t3f_atlas[i]->bitmap[j] = NULL;
+				}
+			}
+		}
+		al_destroy_bitmap(t3f_atlas[i]->page);
+		t3f_atlas[i]->page = NULL;
+		if(t3f_atlas[i]->shadow_mode == T3F_ATLAS_SHADOW_COMPRESSED)
+		{
+			fold_atlas_patches(t3f_atlas[i]);
+		}
+		if(t3f_atlas[i]->staging && t3f_atlas[i]->shadow_mode != T3F_ATLAS_SHADOW_RAW)
+		{
+			al_free(t3f_atlas[i]->staging);
+			t3f_atlas[i]->staging = NULL;
+		}
+	}
+}
+
+bool t3f_rebuild_atlases(void)
+{
+	int i, j;
+	ALLEGRO_BITMAP * bp;
+
+	T3F_TRACE_BEGIN("rebuild_atlases");
+	for(i = 0; i < t3f_atlases; i++)
+	{
+		t3f_push_memory_tag(T3F_MEMORY_TAG_ATLAS);
+		t3f_atlas[i]->page = al_create_bitmap(t3f_atlas[i]->width, t3f_atlas[i]->height);
+		t3f_pop_memory_tag();
+		if(!t3f_atlas[i]->page)
+		{
+			T3F_TRACE_END();
+			return false;
+		}
+		clear_atlas_page(t3f_atlas[i]);
+
+		/* one upload puts the whole page back */
+		if(t3f_atlas[i]->shadow_mode != T3F_ATLAS_SHADOW_NONE)
+		{
+			if(t3f_atlas[i]->drawn && (t3f_atlas[i]->staging || t3f_atlas[i]->shadow || t3f_atlas[i]->patch) && !restore_atlas_page(t3f_atlas[i]))
+			{
+				T3F_TRACE_END();
+				return false;
+			}
+			for(j = 0; j < t3f_atlas[i]->bitmaps; j++)
+			{
+				t3f_push_memory_tag(T3F_MEMORY_TAG_ATLAS);
+				*t3f_atlas[i]->bitmap[j] = al_create_sub_bitmap(t3f_atlas[i]->page, t3f_atlas[i]->bitmap_rect[j].x, t3f_atlas[i]->bitmap_rect[j].y, t3f_atlas[i]->bitmap_rect[j].width, t3f_atlas[i]->bitmap_rect[j].height);
+				t3f_pop_memory_tag();
+			}
+			continue;
+		}
+		reset_atlas_packer(t3f_atlas[i]);
+		for(j = 0; j < t3f_atlas[i]->bitmaps; j++)
+		{
+			/* still being recovered */
+			if(!*t3f_atlas[i]->bitmap[j])
+			{
+				continue;
+			}
+			bp = place_bitmap_on_atlas(t3f_atlas[i], t3f_atlas[i]->bitmap[j], t3f_atlas[i]->bitmap_type[j], true, &t3f_atlas[i]->bitmap_rect[j].x, &t3f_atlas[i]->bitmap_rect[j].y);
 			if(bp)
 			{
-				al_destroy_bitmap(*t3f_atlas[i]->bitmap[j]);
+				t3f_atlas[i]->bitmap_rect[j].x++;
+				t3f_atlas[i]->bitmap_rect[j].y++;
+				if(!t3f_detach_resource((void **)t3f_atlas[i]->bitmap[j]))
+				{
+					al_destroy_bitmap(*t3f_atlas[i]->bitmap[j]);
+				}
 				*t3f_atlas[i]->bitmap[j] = bp;
 			}
 		}
+		flush_atlas_page(t3f_atlas[i]);
 	}
+	T3F_TRACE_END();
 	return true;
 }
@@ -6,22 +6,86 @@
 #define T3F_ATLAS_MAX_BITMAPS 1024
 #define T3F_MAX_ATLASES   32
 
+/* CPU copies of atlas pages for restoring them after display loss */
+#define T3F_ATLAS_SHADOW_NONE       0
+#define T3F_ATLAS_SHADOW_RAW        1
+#define T3F_ATLAS_SHADOW_COMPRESSED 2
+
+/* bump when the packer or the cache file changes so old caches are ignored */
+#define T3F_ATLAS_CACHE_VERSION 1
+
+/* one horizontal segment of the top edge of the packed area */
 typedef struct
 {
 
-	ALLEGRO_BITMAP * page;
 	int x, y;
+	int width;
+
+} T3F_ATLAS_SKYLINE_NODE;
+
+typedef struct
+{
+
+	int x, y;
+	int width, height;
+
+} T3F_ATLAS_RECT;
+
+typedef struct T3F_ATLAS T3F_ATLAS;
+typedef struct T3F_ATLAS_CACHE T3F_ATLAS_CACHE;
+typedef struct T3F_ATLAS_PATCH T3F_ATLAS_PATCH;
+
+struct T3F_ATLAS
+{
+
+	ALLEGRO_BITMAP * page;
 	int width, height;
-	int line_height;
+
+	/* skyline packer, nodes are sorted by x and cover the whole usable width */
+	T3F_ATLAS_SKYLINE_NODE * skyline;
+	int skyline_nodes;
+	int used_area; // pixels taken up by bitmaps and their padding
+
+	/* empty pages are composed on the CPU and uploaded in one go, later
+	   bitmaps are uploaded one at a time */
+	unsigned char * staging;
+	int dirty_x1, dirty_y1, dirty_x2, dirty_y2;
+	bool drawn; // the page has pixels the staging buffer doesn't
+
+	/* bitmaps wait here to be composed until a cached atlas is finished */
+	T3F_ATLAS_CACHE * cache;
+
 	ALLEGRO_BITMAP ** bitmap[T3F_ATLAS_MAX_BITMAPS];
 	int bitmap_type[T3F_ATLAS_MAX_BITMAPS];
+	T3F_ATLAS_RECT bitmap_rect[T3F_ATLAS_MAX_BITMAPS];
 	int bitmaps;
 
-} T3F_ATLAS;
+	/* raw shadows keep the staging buffer, compressed shadows run length
+	   encode it into shadow and keep bitmaps added later as patches until
+	   they are folded in */
+	int shadow_mode;
+	uint32_t * shadow;
+	int shadow_size;
+	T3F_ATLAS_PATCH * patch;
+	int patch_size; // bytes of pixels held by the patches
+
+	T3F_ATLAS * next; // page bitmaps spill onto when this one is full
+
+};
 
 T3F_ATLAS * t3f_create_atlas(int w, int h);
 void t3f_destroy_atlas(T3F_ATLAS * ap);
+ALLEGRO_BITMAP * t3f_put_bitmap_on_atlas(T3F_ATLAS * ap, ALLEGRO_BITMAP ** bp, int type);
 bool t3f_add_bitmap_to_atlas(T3F_ATLAS * ap, ALLEGRO_BITMAP ** bp, int type);
+bool t3f_add_bitmaps_to_atlas(T3F_ATLAS * ap, ALLEGRO_BITMAP ** bp[], int count, int type);
+void t3f_clear_atlas(T3F_ATLAS * ap);
+bool t3f_set_atlas_shadow(T3F_ATLAS * ap, int mode);
+int t3f_get_atlas_shadow_size(T3F_ATLAS * ap);
+bool t3f_cache_atlas(T3F_ATLAS * ap, const char * name);
+bool t3f_finish_atlas(T3F_ATLAS * ap);
+int t3f_get_atlas_pages(T3F_ATLAS * ap);
+int t3f_get_atlas_bitmaps(T3F_ATLAS * ap);
+float t3f_get_atlas_occupancy(T3F_ATLAS * ap);
 void t3f_unload_atlases(void);
 bool t3f_rebuild_atlases(void);
 
@@ -52,7 +52,7 @@ static bool resize_bitmap_hq(ALLEGRO_BITMAP ** bp, int w, int h, int flags)
 	}
 	al_unlock_bitmap(rbp);
 	al_restore_state(&old_state);
-	t3f_destroy_resource(*bp);
+	t3f_destroy_resource_ptr((void **)bp);
 	*bp = rbp;
 	return true;
 }
@@ -74,7 +74,7 @@ static bool resize_bitmap_lq(ALLEGRO_BITMAP ** bp, int w, int h, int flags)
 		al_use_transform(&identity);
 		al_clear_to_color(al_map_rgba_f(0.0, 0.0, 0.0, 0.0));
 		al_draw_scaled_bitmap(*bp, 0, 0, al_get_bitmap_width(*bp), al_get_bitmap_height(*bp), 0, 0, w, h, 0);
-		t3f_destroy_resource(*bp);
+		t3f_destroy_resource_ptr((void **)bp);
 		*bp = rbp;
 	}
 	al_restore_state(&old_state);
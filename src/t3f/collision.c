@@ -215,24 +215,28 @@ T3F_COLLISION_TILEMAP * t3f_create_collision_tilemap(int w, int h, int tw, int t
 	{
 		return NULL;
 	}
-	tmp->data = malloc(h * sizeof(T3F_COLLISION_TILE *));
+	tmp->data = malloc((h > 0 ? h : 1) * sizeof(T3F_COLLISION_TILE *));
 	if(!tmp->data)
 	{
 		free(tmp);
 		return NULL;
 	}
+	tmp->data[0] = malloc((w * h > 0 ? w * h : 1) * sizeof(T3F_COLLISION_TILE));
+	if(!tmp->data[0])
+	{
+		free(tmp->data);
+		free(tmp);
+		return NULL;
+	}
+	tmp->slope_pool = NULL;
 	tmp->width = w;
 	tmp->height = h;
 	tmp->tile_width = tw;
 	tmp->tile_height = th;
 	tmp->flags = 0;
-	for(i = 0; i < h; i++)
+	for(i = 1; i < h; i++)
 	{
-		tmp->data[i] = malloc(w * sizeof(T3F_COLLISION_TILE));
-		if(!tmp->data[i])
-		{
-			return NULL;
-		}
+		tmp->data[i] = tmp->data[0] + i * w;
 	}
 	for(i = 0; i < h; i++)
 	{
@@ -254,7 +258,7 @@ void t3f_destroy_collision_tilemap(T3F_COLLISION_TILEMAP * tmp)
 	{
 		for(j = 0; j < tmp->width; j++)
 		{
-			if(tmp->data[i][j].slope)
+			if(tmp->data[i][j].slope && !t3f_pool_owns(tmp->slope_pool, tmp->data[i][j].slope))
 			{
 				free(tmp->data[i][j].slope);
 			}
@@ -264,10 +268,11 @@ void t3f_destroy_collision_tilemap(T3F_COLLISION_TILEMAP * tmp)
 			}
 		}
 	}
-	for(i = 0; i < tmp->height; i++)
+	if(tmp->slope_pool)
 	{
-		free(tmp->data[i]);
+		t3f_destroy_pool(tmp->slope_pool);
 	}
+	free(tmp->data[0]);
 	free(tmp->data);
 	free(tmp);
 }
@@ -297,7 +302,21 @@ T3F_COLLISION_TILEMAP * t3f_load_collision_tilemap_f(ALLEGRO_FILE * fp)
 			int th = al_fread16le(fp);
 			char c;
 			tmp = t3f_create_collision_tilemap(w, h, tw, th);
+			if(!tmp)
+			{
+				return NULL;
+			}
 			tmp->flags = al_fread32le(fp);
+			if(tmp->flags & T3F_COLLISION_TILEMAP_FLAG_SLOPES)
+			{
+				/* every slope is the same size so they can share one pool */
+				tmp->slope_pool = t3f_create_pool(tw > th ? tw : th, T3F_COLLISION_SLOPE_SLAB);
+				if(!tmp->slope_pool)
+				{
+					t3f_destroy_collision_tilemap(tmp);
+					return NULL;
+				}
+			}
 			for(j = 0; j < tmp->height; j++)
 			{
 				for(k = 0; k < tmp->width; k++)
@@ -320,7 +339,12 @@ T3F_COLLISION_TILEMAP * t3f_load_collision_tilemap_f(ALLEGRO_FILE * fp)
 						c = al_fgetc(fp);
 						if(c)
 						{
-							tmp->data[j][k].slope = malloc(tmp->tile_height > tmp->tile_width ? tmp->tile_height : tmp->tile_width);
+							tmp->data[j][k].slope = t3f_pool_alloc(tmp->slope_pool);
+							if(!tmp->data[j][k].slope)
+							{
+								t3f_destroy_collision_tilemap(tmp);
+								return NULL;
+							}
 							for(l = 0; l < (tmp->tile_height > tmp->tile_width ? tmp->tile_height : tmp->tile_width); l++)
 							{
 								tmp->data[j][k].slope[l] = al_fgetc(fp);
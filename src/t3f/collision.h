@@ -9,8 +9,11 @@
    extern "C" {
 #endif
 
+#include "pool.h"
+
 #define T3F_MAX_COLLISION_POINTS    32
 #define T3F_COLLISION_TILE_MAX_DATA 16
+#define T3F_COLLISION_SLOPE_SLAB    64
 
 #define T3F_COLLISION_TILEMAP_FLAG_USER_DATA 1
 #define T3F_COLLISION_TILEMAP_FLAG_SLOPES    2
@@ -81,7 +84,8 @@ typedef struct
 typedef struct
 {
 
-	T3F_COLLISION_TILE ** data;
+	T3F_COLLISION_TILE ** data;  // rows point into one block
+	T3F_POOL * slope_pool;
 	int width;
 	int height;
 	int tile_width;
@@ -130,7 +130,8 @@ void t3f_draw_text_lines(T3F_TEXT_LINE_DATA * lines, ALLEGRO_COLOR color, float
 
 void t3f_draw_multiline_text(T3F_FONT * fp, ALLEGRO_COLOR color, float x, float y, float z, float w, float tab, int flags, const char * text)
 {
-	T3F_TEXT_LINE_DATA line_data;
+	T3F_TEXT_LINE_DATA * line_data;
+	bool line_data_on_heap = false;
 	float pos = x;
 	bool held;
 
@@ -153,8 +154,28 @@ void t3f_draw_multiline_text(T3F_FONT * fp, ALLEGRO_COLOR color, float x, float
 	}
 	if(w > 0.0)
 	{
-		t3f_create_text_line_data(&line_data, fp, w, tab, text);
-		t3f_draw_text_lines(&line_data, color, x, y, z);
+		/* the line data is too big for the stack, threads without a frame
+		   arena use the heap */
+		line_data = t3f_frame_alloc(sizeof(T3F_TEXT_LINE_DATA));
+		if(!line_data)
+		{
+			line_data = malloc(sizeof(T3F_TEXT_LINE_DATA));
+			if(!line_data)
+			{
+				if(!held)
+				{
+					al_hold_bitmap_drawing(false);
+				}
+				return;
+			}
+			line_data_on_heap = true;
+		}
+		t3f_create_text_line_data(line_data, fp, w, tab, text);
+		t3f_draw_text_lines(line_data, color, x, y, z);
+		if(line_data_on_heap)
+		{
+			free(line_data);
+		}
 		if(!held)
 		{
 			al_hold_bitmap_drawing(false);
@@ -178,13 +199,21 @@ void t3f_draw_multiline_text(T3F_FONT * fp, ALLEGRO_COLOR color, float x, float
 void t3f_draw_multiline_textf(T3F_FONT * vf, ALLEGRO_COLOR color, float x, float y, float z, float w, float tab, int flags, const char * format, ...)
 {
 	char buf[1024] = {0};
+	char * text;
 	va_list vap;
 
 	va_start(vap, format);
-	vsnprintf(buf, 1024, format, vap);
+	text = t3f_frame_vsprintf(format, vap);
 	va_end(vap);
+	if(!text)
+	{
+		va_start(vap, format);
+		vsnprintf(buf, 1024, format, vap);
+		va_end(vap);
+		text = buf;
+	}
 
-	t3f_draw_multiline_text(vf, color, x, y, z, w, tab, flags, buf);
+	t3f_draw_multiline_text(vf, color, x, y, z, w, tab, flags, text);
 }
 
 void t3f_draw_text(T3F_FONT * vf, ALLEGRO_COLOR color, float x, float y, float z, int flags, const char * text)
@@ -195,13 +224,21 @@ void t3f_draw_text(T3F_FONT * vf, ALLEGRO_COLOR color, float x, float y, float z
 void t3f_draw_textf(T3F_FONT * vf, ALLEGRO_COLOR color, float x, float y, float z, int flags, const char * format, ...)
 {
 	char buf[1024] = {0};
+	char * text;
 	va_list vap;
 
 	va_start(vap, format);
-	vsnprintf(buf, 1024, format, vap);
+	text = t3f_frame_vsprintf(format, vap);
 	va_end(vap);
+	if(!text)
+	{
+		va_start(vap, format);
+		vsnprintf(buf, 1024, format, vap);
+		va_end(vap);
+		text = buf;
+	}
 
-	t3f_draw_text(vf, color, x, y, z, flags, buf);
+	t3f_draw_text(vf, color, x, y, z, flags, text);
 }
 
 void t3f_draw_glyph(T3F_FONT * vf, ALLEGRO_COLOR color, float x, float y, float z, int cp)
@@ -230,6 +267,7 @@ T3F_FONT * t3f_load_font_with_engine_f(T3F_FONT_ENGINE * engine, const char * fn
 {
 	T3F_FONT * font;
 
+	t3f_push_memory_tag(T3F_MEMORY_TAG_FONT);
 	font = malloc(sizeof(T3F_FONT));
 	if(!font)
 	{
@@ -244,11 +282,13 @@ T3F_FONT * t3f_load_font_with_engine_f(T3F_FONT_ENGINE * engine, const char * fn
 	{
 		goto fail;
 	}
+	t3f_pop_memory_tag();
 
 	return font;
 
 	fail:
 	{
+		t3f_pop_memory_tag();
 		t3f_destroy_font(font);
 	}
 	return NULL;
@@ -204,7 +204,8 @@ void t3f_destroy_gui(T3F_GUI * pp)
 				}
 				case T3F_GUI_ELEMENT_IMAGE:
 				{
-					t3f_destroy_resource(pp->element[i].resource);
+					t3f_destroy_resource_ptr(pp->element[i].resource);
+					al_free(pp->element[i].allocated_data);
 					break;
 				}
 			}
@@ -224,7 +225,19 @@ int t3f_add_gui_image_element(T3F_GUI * pp, int (*proc)(void *, int, void *), vo
 	pp->element[pp->elements].proc = proc;
 	if(flags & T3F_GUI_ELEMENT_COPY)
 	{
-		t3f_clone_resource(pp->element[pp->elements].resource, *bp);
+		/* the copy needs somewhere to keep its pointer */
+		pp->element[pp->elements].allocated_data = al_malloc(sizeof(void *));
+		if(!pp->element[pp->elements].allocated_data)
+		{
+			return 0;
+		}
+		pp->element[pp->elements].resource = pp->element[pp->elements].allocated_data;
+		*pp->element[pp->elements].resource = NULL;
+		if(!t3f_clone_resource(pp->element[pp->elements].resource, *bp))
+		{
+			al_free(pp->element[pp->elements].allocated_data);
+			return 0;
+		}
 	}
 	else
 	{
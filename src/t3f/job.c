@@ -0,0 +1,545 @@
+#include "t3f.h"
+#include "job.h"
+
+/* each worker has its own deque, the owner pushes and pops at the bottom so
+   it works on what it added most recently while idle workers steal the oldest
+   jobs from the top of the others' deques */
+
+#define _T3F_JOB_DEQUE_SIZE 256
+
+typedef struct T3F_JOB T3F_JOB;
+
+struct T3F_JOB
+{
+
+	void (*proc)(void * data);
+	void * data;
+	T3F_JOB_COUNTER * counter;
+	T3F_JOB * next; // next job waiting on the same counter
+
+};
+
+struct T3F_JOB_COUNTER
+{
+
+	int count;
+	T3F_JOB * waiting; // jobs held back until count reaches zero
+
+};
+
+typedef struct
+{
+
+	ALLEGRO_MUTEX * mutex;
+	T3F_JOB ** job;
+	int size; // always a power of two
+	int top, bottom;
+
+} T3F_JOB_DEQUE;
+
+typedef struct
+{
+
+	ALLEGRO_THREAD * thread;
+	T3F_JOB_DEQUE deque;
+	int index;
+
+} T3F_JOB_WORKER;
+
+typedef struct
+{
+
+	void (*proc)(int start, int end, void * data);
+	int start, end;
+	void * data;
+
+} T3F_JOB_RANGE;
+
+static T3F_JOB_WORKER * t3f_job_worker = NULL;
+static int t3f_job_workers = 0;
+static int t3f_job_next_worker = 0;
+static int t3f_job_queued = 0;
+static bool t3f_job_quit = false;
+static ALLEGRO_MUTEX * t3f_job_mutex = NULL; // protects everything above and the counters
+static ALLEGRO_COND * t3f_job_cond = NULL;
+static ALLEGRO_COND * t3f_job_counter_cond = NULL;
+static T3F_THREAD_LOCAL int t3f_job_current_worker = -1;
+
+static bool t3f_push_job(T3F_JOB_DEQUE * dp, T3F_JOB * jp)
+{
+	T3F_JOB ** new_job;
+	int i;
+
+	al_lock_mutex(dp->mutex);
+	if(dp->bottom - dp->top >= dp->size)
+	{
+		new_job = malloc(sizeof(T3F_JOB *) * dp->size * 2);
+		if(!new_job)
+		{
+			al_unlock_mutex(dp->mutex);
+			return false;
+		}
+		for(i = dp->top; i < dp->bottom; i++)
+		{
+			new_job[i & (dp->size * 2 - 1)] = dp->job[i & (dp->size - 1)];
+		}
+		free(dp->job);
+		dp->job = new_job;
+		dp->size *= 2;
+	}
+	dp->job[dp->bottom & (dp->size - 1)] = jp;
+	dp->bottom++;
+	al_unlock_mutex(dp->mutex);
+	return true;
+}
+
+static T3F_JOB * t3f_pop_job(T3F_JOB_DEQUE * dp)
+{
+	T3F_JOB * jp = NULL;
+
+	al_lock_mutex(dp->mutex);
+	if(dp->bottom > dp->top)
+	{
+		dp->bottom--;
+		jp = dp->job[dp->bottom & (dp->size - 1)];
+	}
+	al_unlock_mutex(dp->mutex);
+	return jp;
+}
+
+static T3F_JOB * t3f_steal_job(T3F_JOB_DEQUE * dp)
+{
+	T3F_JOB * jp = NULL;
+
+	al_lock_mutex(dp->mutex);
+	if(dp->bottom > dp->top)
+	{
+		jp = dp->job[dp->top & (dp->size - 1)];
+		dp->top++;
+	}
+	al_unlock_mutex(dp->mutex);
+	return jp;
+}
+
+/* threads outside the pool spread their jobs over the workers */
+static bool t3f_queue_job(T3F_JOB * jp)
+{
+	int i = t3f_job_current_worker;
+
+	if(i < 0)
+	{
+		al_lock_mutex(t3f_job_mutex);
+		i = t3f_job_next_worker;
+		t3f_job_next_worker = (t3f_job_next_worker + 1) % t3f_job_workers;
+		al_unlock_mutex(t3f_job_mutex);
+	}
+	if(!t3f_push_job(&t3f_job_worker[i].deque, jp))
+	{
+		return false;
+	}
+	al_lock_mutex(t3f_job_mutex);
+	t3f_job_queued++;
+	al_signal_cond(t3f_job_cond);
+	al_broadcast_cond(t3f_job_counter_cond);
+	al_unlock_mutex(t3f_job_mutex);
+	return true;
+}
+
+/* our own jobs first, then steal from the others */
+static T3F_JOB * t3f_take_job(int worker)
+{
+	T3F_JOB * jp = NULL;
+	int start = worker >= 0 ? worker : 0;
+	int i;
+
+	if(worker >= 0)
+	{
+		jp = t3f_pop_job(&t3f_job_worker[worker].deque);
+	}
+	for(i = 0; !jp && i < t3f_job_workers; i++)
+	{
+		if((start + i) % t3f_job_workers != worker)
+		{
+			jp = t3f_steal_job(&t3f_job_worker[(start + i) % t3f_job_workers].deque);
+		}
+	}
+	if(jp)
+	{
+		al_lock_mutex(t3f_job_mutex);
+		t3f_job_queued--;
+		al_unlock_mutex(t3f_job_mutex);
+	}
+	return jp;
+}
+
+static void t3f_run_job(T3F_JOB * jp)
+{
+	T3F_JOB * ready = NULL;
+	T3F_JOB * next;
+
+	jp->proc(jp->data);
+	if(jp->counter)
+	{
+		al_lock_mutex(t3f_job_mutex);
+		jp->counter->count--;
+		if(jp->counter->count <= 0)
+		{
+			ready = jp->counter->waiting;
+			jp->counter->waiting = NULL;
+			al_broadcast_cond(t3f_job_counter_cond);
+		}
+		al_unlock_mutex(t3f_job_mutex);
+	}
+	free(jp);
+
+	/* release jobs that were waiting for this counter */
+	while(ready)
+	{
+		next = ready->next;
+		if(!t3f_queue_job(ready))
+		{
+			t3f_run_job(ready);
+		}
+		ready = next;
+	}
+}
+
+static void * t3f_job_worker_thread(ALLEGRO_THREAD * thread, void * arg)
+{
+	T3F_JOB_WORKER * wp = (T3F_JOB_WORKER *)arg;
+	T3F_JOB * jp;
+	bool quit;
+
+	t3f_job_current_worker = wp->index;
+	while(1)
+	{
+		jp = t3f_take_job(wp->index);
+		if(jp)
+		{
+			t3f_run_job(jp);
+			continue;
+		}
+		al_lock_mutex(t3f_job_mutex);
+		while(!t3f_job_queued && !t3f_job_quit)
+		{
+			al_wait_cond(t3f_job_cond, t3f_job_mutex);
+		}
+		quit = t3f_job_quit && !t3f_job_queued;
+		al_unlock_mutex(t3f_job_mutex);
+		if(quit)
+		{
+			break;
+		}
+	}
+	return NULL;
+}
+
+/* pass 0 workers to use one less than the number of cores */
+bool t3f_init_job_system(int workers)
+{
+	int i;
+
+	if(t3f_job_workers)
+	{
+		return true;
+	}
+	if(workers <= 0)
+	{
+		workers = al_get_cpu_count() - 1;
+		if(workers < 1)
+		{
+			workers = 1;
+		}
+	}
+	if(workers > T3F_MAX_JOB_WORKERS)
+	{
+		workers = T3F_MAX_JOB_WORKERS;
+	}
+	t3f_job_mutex = al_create_mutex();
+	t3f_job_cond = al_create_cond();
+	t3f_job_counter_cond = al_create_cond();
+	if(!t3f_job_mutex || !t3f_job_cond || !t3f_job_counter_cond)
+	{
+		goto fail;
+	}
+	t3f_job_worker = malloc(sizeof(T3F_JOB_WORKER) * workers);
+	if(!t3f_job_worker)
+	{
+		goto fail;
+	}
+	memset(t3f_job_worker, 0, sizeof(T3F_JOB_WORKER) * workers);
+	t3f_job_workers = workers;
+	for(i = 0; i < workers; i++)
+	{
+		t3f_job_worker[i].index = i;
+		t3f_job_worker[i].deque.mutex = al_create_mutex();
+		t3f_job_worker[i].deque.job = malloc(sizeof(T3F_JOB *) * _T3F_JOB_DEQUE_SIZE);
+		t3f_job_worker[i].deque.size = _T3F_JOB_DEQUE_SIZE;
+		if(!t3f_job_worker[i].deque.mutex || !t3f_job_worker[i].deque.job)
+		{
+			goto fail;
+		}
+	}
+	t3f_job_quit = false;
+	t3f_job_queued = 0;
+	t3f_job_next_worker = 0;
+	for(i = 0; i < workers; i++)
+	{
+		t3f_job_worker[i].thread = al_create_thread(t3f_job_worker_thread, &t3f_job_worker[i]);
+		if(!t3f_job_worker[i].thread)
+		{
+			goto fail;
+		}
+		al_start_thread(t3f_job_worker[i].thread);
+	}
+	return true;
+
+	fail:
+	{
+		t3f_shutdown_job_system();
+		return false;
+	}
+}
+
+/* lets the workers finish the queued jobs before stopping them, jobs still
+   waiting on a counter are discarded */
+void t3f_shutdown_job_system(void)
+{
+	T3F_JOB * jp;
+	int i;
+
+	if(t3f_job_mutex)
+	{
+		al_lock_mutex(t3f_job_mutex);
+		t3f_job_quit = true;
+		if(t3f_job_cond)
+		{
+			al_broadcast_cond(t3f_job_cond);
+		}
+		al_unlock_mutex(t3f_job_mutex);
+	}
+	if(t3f_job_worker)
+	{
+		for(i = 0; i < t3f_job_workers; i++)
+		{
+			if(t3f_job_worker[i].thread)
+			{
+				al_destroy_thread(t3f_job_worker[i].thread);
+			}
+		}
+		for(i = 0; i < t3f_job_workers; i++)
+		{
+			if(t3f_job_worker[i].deque.job)
+			{
+				while(t3f_job_worker[i].deque.mutex && (jp = t3f_pop_job(&t3f_job_worker[i].deque)))
+				{
+					free(jp);
+				}
+				free(t3f_job_worker[i].deque.job);
+			}
+			if(t3f_job_worker[i].deque.mutex)
+			{
+				al_destroy_mutex(t3f_job_worker[i].deque.mutex);
+			}
+		}
+		free(t3f_job_worker);
+		t3f_job_worker = NULL;
+	}
+	t3f_job_workers = 0;
+	if(t3f_job_counter_cond)
+	{
+		al_destroy_cond(t3f_job_counter_cond);
+		t3f_job_counter_cond = NULL;
+	}
+	if(t3f_job_cond)
+	{
+		al_destroy_cond(t3f_job_cond);
+		t3f_job_cond = NULL;
+	}
+	if(t3f_job_mutex)
+	{
+		al_destroy_mutex(t3f_job_mutex);
+		t3f_job_mutex = NULL;
+	}
+}
+
+int t3f_get_job_workers(void)
+{
+	return t3f_job_workers;
+}
+
+T3F_JOB_COUNTER * t3f_create_job_counter(void)
+{
+	T3F_JOB_COUNTER * cp;
+
+	cp = malloc(sizeof(T3F_JOB_COUNTER));
+	if(cp)
+	{
+		memset(cp, 0, sizeof(T3F_JOB_COUNTER));
+	}
+	return cp;
+}
+
+void t3f_destroy_job_counter(T3F_JOB_COUNTER * cp)
+{
+	free(cp);
+}
+
+int t3f_get_job_counter(T3F_JOB_COUNTER * cp)
+{
+	int count;
+
+	if(!t3f_job_mutex)
+	{
+		return cp->count;
+	}
+	al_lock_mutex(t3f_job_mutex);
+	count = cp->count;
+	al_unlock_mutex(t3f_job_mutex);
+	return count;
+}
+
+/* without a job system the job runs right away on the calling thread */
+bool t3f_add_job(void (*proc)(void * data), void * data, T3F_JOB_COUNTER * counter)
+{
+	return t3f_add_job_after(proc, data, NULL, counter);
+}
+
+/* the job won't start until the wait counter reaches zero */
+bool t3f_add_job_after(void (*proc)(void * data), void * data, T3F_JOB_COUNTER * wait, T3F_JOB_COUNTER * counter)
+{
+	T3F_JOB * jp;
+	bool held = false;
+
+	if(!t3f_job_workers)
+	{
+		proc(data);
+		return true;
+	}
+	jp = malloc(sizeof(T3F_JOB));
+	if(!jp)
+	{
+		return false;
+	}
+	jp->proc = proc;
+	jp->data = data;
+	jp->counter = counter;
+	jp->next = NULL;
+	al_lock_mutex(t3f_job_mutex);
+	if(counter)
+	{
+		counter->count++;
+	}
+	if(wait && wait->count > 0)
+	{
+		jp->next = wait->waiting;
+		wait->waiting = jp;
+		held = true;
+	}
+	al_unlock_mutex(t3f_job_mutex);
+	if(!held && !t3f_queue_job(jp))
+	{
+		al_lock_mutex(t3f_job_mutex);
+		if(counter)
+		{
+			counter->count--;
+		}
+		al_unlock_mutex(t3f_job_mutex);
+		free(jp);
+		return false;
+	}
+	return true;
+}
+
+/* run queued jobs while we wait instead of sitting idle */
+void t3f_wait_job_counter(T3F_JOB_COUNTER * cp)
+{
+	T3F_JOB * jp;
+
+	if(!t3f_job_workers)
+	{
+		return;
+	}
+	while(1)
+	{
+		al_lock_mutex(t3f_job_mutex);
+		if(cp->count <= 0)
+		{
+			al_unlock_mutex(t3f_job_mutex);
+			return;
+		}
+		al_unlock_mutex(t3f_job_mutex);
+		jp = t3f_take_job(t3f_job_current_worker);
+		if(jp)
+		{
+			t3f_run_job(jp);
+			continue;
+		}
+		al_lock_mutex(t3f_job_mutex);
+		while(cp->count > 0 && !t3f_job_queued)
+		{
+			al_wait_cond(t3f_job_counter_cond, t3f_job_mutex);
+		}
+		al_unlock_mutex(t3f_job_mutex);
+	}
+}
+
+static void t3f_job_range_proc(void * data)
+{
+	T3F_JOB_RANGE * rp = (T3F_JOB_RANGE *)data;
+
+	rp->proc(rp->start, rp->end, rp->data);
+}
+
+/* split start - end into chunks of grain indices and run them in parallel,
+   returns once every chunk is done, pass 0 for grain to pick one based on
+   the number of workers */
+void t3f_parallel_for(int start, int end, int grain, void (*proc)(int start, int end, void * data), void * data)
+{
+	T3F_JOB_RANGE * range = NULL;
+	T3F_JOB_COUNTER * counter = NULL;
+	int chunks, i;
+
+	if(end <= start)
+	{
+		return;
+	}
+	if(grain <= 0)
+	{
+		grain = (end - start) / ((t3f_job_workers + 1) * 4);
+		if(grain < 1)
+		{
+			grain = 1;
+		}
+	}
+	chunks = (end - start + grain - 1) / grain;
+	if(t3f_job_workers && chunks > 1)
+	{
+		range = malloc(sizeof(T3F_JOB_RANGE) * chunks);
+		counter = t3f_create_job_counter();
+	}
+	if(!range || !counter)
+	{
+		free(range);
+		if(counter)
+		{
+			t3f_destroy_job_counter(counter);
+		}
+		proc(start, end, data);
+		return;
+	}
+	for(i = 0; i < chunks; i++)
+	{
+		range[i].proc = proc;
+		range[i].start = start + i * grain;
+		range[i].end = range[i].start + grain < end ? range[i].start + grain : end;
+		range[i].data = data;
+		if(!t3f_add_job(t3f_job_range_proc, &range[i], counter))
+		{
+			t3f_job_range_proc(&range[i]);
+		}
+	}
+	t3f_wait_job_counter(counter);
+	t3f_destroy_job_counter(counter);
+	free(range);
+}
@@ -0,0 +1,25 @@
+#ifndef T3F_JOB_H
+#define T3F_JOB_H
+
+#include <allegro5/allegro5.h>
+
+#define T3F_MAX_JOB_WORKERS 64
+
+/* counts outstanding jobs, reaches zero when all jobs added with it are done */
+typedef struct T3F_JOB_COUNTER T3F_JOB_COUNTER;
+
+bool t3f_init_job_system(int workers);
+void t3f_shutdown_job_system(void);
+int t3f_get_job_workers(void);
+
+T3F_JOB_COUNTER * t3f_create_job_counter(void);
+void t3f_destroy_job_counter(T3F_JOB_COUNTER * cp);
+int t3f_get_job_counter(T3F_JOB_COUNTER * cp);
+
+bool t3f_add_job(void (*proc)(void * data), void * data, T3F_JOB_COUNTER * counter);
+bool t3f_add_job_after(void (*proc)(void * data), void * data, T3F_JOB_COUNTER * wait, T3F_JOB_COUNTER * counter);
+void t3f_wait_job_counter(T3F_JOB_COUNTER * cp);
+
+void t3f_parallel_for(int start, int end, int grain, void (*proc)(int start, int end, void * data), void * data);
+
+#endif
@@ -0,0 +1,107 @@
+#include "t3f.h"
+#include "lighting.h"
+
+/* angle of the normal relative to the light, wrapped into 0 - ALLEGRO_PI */
+static float get_relative_angle(float light_angle, float normal_angle)
+{
+	float d_angle = fmod(normal_angle - light_angle, ALLEGRO_PI);
+
+	if(d_angle < 0)
+	{
+		d_angle += ALLEGRO_PI;
+	}
+	return d_angle;
+}
+
+/* spread the value linearly between val_min and val_max, surfaces facing the
+   light are brightest and surfaces side on to it are darkest */
+static float linear_spread(float d_angle, float val_min, float val_max)
+{
+	float d = fabs(val_max - val_min);
+
+	d_angle -= ALLEGRO_PI / 2.0; // subtract 90 degrees
+	if(d_angle < 0)
+	{
+		return val_min - d * (d_angle / (ALLEGRO_PI / 2.0));
+	}
+	return val_min + d * (d_angle / (ALLEGRO_PI / 2.0));
+}
+
+static ALLEGRO_COLOR get_lit_color(ALLEGRO_COLOR base_color, float d_angle, float ambient)
+{
+	float r, g, b;
+	float h, s, l;
+	float target_l;
+
+	al_unmap_rgb_f(base_color, &r, &g, &b);
+	al_color_rgb_to_hsl(r, g, b, &h, &s, &l);
+	target_l = linear_spread(d_angle, l * ambient, l);
+
+	return al_color_hsl(h, s, target_l);
+}
+
+/* ambient is the fraction of the base lightness left on the darkest side */
+ALLEGRO_COLOR t3f_get_lit_color(ALLEGRO_COLOR base_color, float light_angle, float normal_angle, float ambient)
+{
+	return get_lit_color(base_color, get_relative_angle(light_angle, normal_angle), ambient);
+}
+
+T3F_LIGHT_RAMP * t3f_create_light_ramp(ALLEGRO_COLOR base_color, float light_angle, float ambient, int steps)
+{
+	T3F_LIGHT_RAMP * rp;
+	int i;
+
+	if(steps < 1)
+	{
+		return NULL;
+	}
+	rp = al_malloc(sizeof(T3F_LIGHT_RAMP));
+	if(!rp)
+	{
+		return NULL;
+	}
+	rp->color = al_malloc(sizeof(ALLEGRO_COLOR) * steps);
+	if(!rp->color)
+	{
+		al_free(rp);
+		return NULL;
+	}
+	rp->steps = steps;
+	rp->light_angle = light_angle;
+
+	/* sample the middle of each step so quantizing doesn't bias the result */
+	for(i = 0; i < steps; i++)
+	{
+		rp->color[i] = get_lit_color(base_color, ((float)i + 0.5) * ALLEGRO_PI / (float)steps, ambient);
+	}
+	return rp;
+}
+
+void t3f_destroy_light_ramp(T3F_LIGHT_RAMP * rp)
+{
+	al_free(rp->color);
+	al_free(rp);
+}
+
+ALLEGRO_COLOR t3f_get_light_ramp_color(T3F_LIGHT_RAMP * rp, float normal_angle)
+{
+	int i = get_relative_angle(rp->light_angle, normal_angle) * (float)rp->steps / ALLEGRO_PI;
+
+	if(i >= rp->steps)
+	{
+		i = rp->steps - 1;
+	}
+	return rp->color[i];
+}
+
+/* give every vertex of a flat-shaded face the same lit color */
+void t3f_light_vertices(T3F_LIGHT_RAMP * rp, ALLEGRO_VERTEX * vp, int count, float normal_angle)
+{
+	ALLEGRO_COLOR color = t3f_get_light_ramp_color(rp, normal_angle);
+	int i;
+
+	for(i = 0; i < count; i++)
+	{
+		vp[i].color = color;
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef T3F_LIGHTING_H
+#define T3F_LIGHTING_H
+
+#include <allegro5/allegro5.h>
+#include <allegro5/allegro_color.h>
+
+#define T3F_LIGHT_RAMP_DEFAULT_STEPS 256
+
+/* lit colors for a flat-shaded surface, the shading repeats every
+   ALLEGRO_PI radians so the ramp only covers that range */
+typedef struct
+{
+
+	ALLEGRO_COLOR * color;
+	int steps;
+	float light_angle;
+
+} T3F_LIGHT_RAMP;
+
+ALLEGRO_COLOR t3f_get_lit_color(ALLEGRO_COLOR base_color, float light_angle, float normal_angle, float ambient);
+
+T3F_LIGHT_RAMP * t3f_create_light_ramp(ALLEGRO_COLOR base_color, float light_angle, float ambient, int steps);
+void t3f_destroy_light_ramp(T3F_LIGHT_RAMP * rp);
+ALLEGRO_COLOR t3f_get_light_ramp_color(T3F_LIGHT_RAMP * rp, float normal_angle);
+void t3f_light_vertices(T3F_LIGHT_RAMP * rp, ALLEGRO_VERTEX * vp, int count, float normal_angle);
+
+#endif
@@ -0,0 +1,367 @@
+#include "t3f.h"
+#include "loader.h"
+#include "resource.h"
+
+/* requests are decoded by the job system into memory bitmaps and samples,
+   decoded requests wait in a queue until the main thread picks them up in
+   t3f_finish_loads(), which uploads bitmaps to the display and registers
+   them as resources so they come back after the display is lost
+
+   finishing has to happen on the thread that owns the display, in threaded
+   run mode the framework takes the display back from the render thread when
+   t3f_loads_waiting() says there is something to finish and keeps it until
+   the queued loads are done
+
+   t3f_initialize() starts the job system when passed T3F_USE_JOBS, which
+   T3F_DEFAULT includes, without it requests are decoded when they are
+   queued */
+
+#define _T3F_LOAD_BITMAP 0
+#define _T3F_LOAD_SAMPLE 1
+#define _T3F_LOAD_CUSTOM 2
+
+typedef struct T3F_LOAD_REQUEST T3F_LOAD_REQUEST;
+
+struct T3F_LOAD_REQUEST
+{
+
+	int type;
+	void ** ptr;
+	char filename[T3F_RESOURCE_MAX_PATH];
+	const ALLEGRO_FILE_INTERFACE * fi;
+	void * result;
+
+	bool (*load_proc)(void * data);
+	void (*finish_proc)(void * data, bool loaded);
+	void * data;
+	bool loaded;
+
+	T3F_LOAD_REQUEST * next;
+
+};
+
+static ALLEGRO_MUTEX * t3f_load_mutex = NULL;
+static T3F_JOB_COUNTER * t3f_load_counter = NULL;
+static T3F_LOAD_REQUEST * t3f_load_done = NULL; // oldest first
+static T3F_LOAD_REQUEST * t3f_load_done_tail = NULL;
+static int t3f_loads_queued = 0;                // since the queue was last empty
+static int t3f_loads_finished = 0;
+static double t3f_load_time_slice = T3F_DEFAULT_LOAD_TIME_SLICE;
+
+static void load_job(void * data)
+{
+	T3F_LOAD_REQUEST * rp = data;
+	ALLEGRO_STATE old_state;
+
+	T3F_TRACE_BEGIN("load");
+	al_set_new_file_interface(rp->fi);
+	t3f_push_memory_tag(T3F_MEMORY_TAG_RESOURCE);
+	switch(rp->type)
+	{
+		case _T3F_LOAD_BITMAP:
+		{
+			/* video bitmaps can only be made on the display's thread */
+			al_store_state(&old_state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+			al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+			rp->loaded = t3f_bitmap_resource_handler_proc(&rp->result, NULL, rp->filename, 0, 0, 0, false);
+			al_restore_state(&old_state);
+			break;
+		}
+		case _T3F_LOAD_SAMPLE:
+		{
+			rp->result = al_load_sample(rp->filename);
+			rp->loaded = rp->result;
+			break;
+		}
+		case _T3F_LOAD_CUSTOM:
+		{
+			rp->loaded = rp->load_proc(rp->data);
+			break;
+		}
+	}
+	t3f_pop_memory_tag();
+	T3F_TRACE_END();
+
+	al_lock_mutex(t3f_load_mutex);
+	if(t3f_load_done_tail)
+	{
+		t3f_load_done_tail->next = rp;
+	}
+	else
+	{
+		t3f_load_done = rp;
+	}
+	t3f_load_done_tail = rp;
+	al_unlock_mutex(t3f_load_mutex);
+}
+
+static T3F_LOAD_REQUEST * create_request(int type, void ** ptr, const char * fn)
+{
+	T3F_LOAD_REQUEST * rp;
+
+	if(fn && strlen(fn) >= T3F_RESOURCE_MAX_PATH)
+	{
+		return NULL;
+	}
+	rp = al_malloc(sizeof(T3F_LOAD_REQUEST));
+	if(!rp)
+	{
+		return NULL;
+	}
+	memset(rp, 0, sizeof(T3F_LOAD_REQUEST));
+	rp->type = type;
+	rp->ptr = ptr;
+	if(fn)
+	{
+		strcpy(rp->filename, fn);
+	}
+	return rp;
+}
+
+static bool queue_request(T3F_LOAD_REQUEST * rp)
+{
+	if(!t3f_load_mutex)
+	{
+		t3f_load_mutex = al_create_mutex();
+		if(!t3f_load_mutex)
+		{
+			goto fail;
+		}
+	}
+	if(!t3f_load_counter)
+	{
+		t3f_load_counter = t3f_create_job_counter();
+		if(!t3f_load_counter)
+		{
+			goto fail;
+		}
+	}
+
+	/* workers load through the file interface that was in use when the
+	   request was made */
+	rp->fi = al_get_new_file_interface();
+	if(rp->ptr)
+	{
+		*rp->ptr = NULL;
+	}
+	t3f_loads_queued++;
+	if(!t3f_add_job(load_job, rp, t3f_load_counter))
+	{
+		t3f_loads_queued--;
+		goto fail;
+	}
+	return true;
+
+	fail:
+	{
+		al_free(rp);
+		return false;
+	}
+}
+
+/* *bp stays NULL until the bitmap has been finished */
+bool t3f_queue_bitmap_load(ALLEGRO_BITMAP ** bp, const char * fn)
+{
+	T3F_LOAD_REQUEST * rp;
+
+	rp = create_request(_T3F_LOAD_BITMAP, (void **)bp, fn);
+	if(!rp)
+	{
+		return false;
+	}
+	return queue_request(rp);
+}
+
+bool t3f_queue_sample_load(ALLEGRO_SAMPLE ** sp, const char * fn)
+{
+	T3F_LOAD_REQUEST * rp;
+
+	rp = create_request(_T3F_LOAD_SAMPLE, (void **)sp, fn);
+	if(!rp)
+	{
+		return false;
+	}
+	return queue_request(rp);
+}
+
+/* load_proc runs on a worker and must not touch the display, finish_proc runs
+   on the main thread while it owns the display once load_proc is done */
+bool t3f_queue_load(bool (*load_proc)(void * data), void (*finish_proc)(void * data, bool loaded), void * data)
+{
+	T3F_LOAD_REQUEST * rp;
+
+	if(!load_proc)
+	{
+		return false;
+	}
+	rp = create_request(_T3F_LOAD_CUSTOM, NULL, NULL);
+	if(!rp)
+	{
+		return false;
+	}
+	rp->load_proc = load_proc;
+	rp->finish_proc = finish_proc;
+	rp->data = data;
+	return queue_request(rp);
+}
+
+static void finish_request(T3F_LOAD_REQUEST * rp)
+{
+	ALLEGRO_STATE old_state;
+
+	switch(rp->type)
+	{
+		case _T3F_LOAD_BITMAP:
+		{
+			if(rp->result)
+			{
+				t3f_push_memory_tag(T3F_MEMORY_TAG_RESOURCE);
+				al_store_state(&old_state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+				al_set_new_bitmap_flags((al_get_new_bitmap_flags() & ~ALLEGRO_MEMORY_BITMAP) | ALLEGRO_NO_PRESERVE_TEXTURE);
+				al_convert_bitmap(rp->result);
+				al_restore_state(&old_state);
+				t3f_pop_memory_tag();
+				*rp->ptr = rp->result;
+				t3f_add_resource(t3f_bitmap_resource_handler_proc, rp->ptr, rp->filename, 0, 0, 0, rp->fi);
+			}
+			break;
+		}
+		case _T3F_LOAD_SAMPLE:
+		{
+			*rp->ptr = rp->result;
+			break;
+		}
+		case _T3F_LOAD_CUSTOM:
+		{
+			if(rp->finish_proc)
+			{
+				rp->finish_proc(rp->data, rp->loaded);
+			}
+			break;
+		}
+	}
+	al_free(rp);
+}
+
+/* finish decoded requests until max_time seconds have passed, at least one
+   request is finished per call if any are waiting, pass a negative max_time
+   to finish everything that is ready */
+int t3f_finish_loads(double max_time)
+{
+	T3F_LOAD_REQUEST * rp;
+	double start_time;
+	int count = 0;
+
+	if(!t3f_loads_queued)
+	{
+		return 0;
+	}
+	T3F_TRACE_BEGIN("finish_loads");
+	start_time = al_get_time();
+	while(1)
+	{
+		al_lock_mutex(t3f_load_mutex);
+		rp = t3f_load_done;
+		if(rp)
+		{
+			t3f_load_done = rp->next;
+			if(!t3f_load_done)
+			{
+				t3f_load_done_tail = NULL;
+			}
+		}
+		al_unlock_mutex(t3f_load_mutex);
+		if(!rp)
+		{
+			break;
+		}
+		finish_request(rp);
+		t3f_loads_finished++;
+		count++;
+		if(max_time >= 0.0 && al_get_time() - start_time >= max_time)
+		{
+			break;
+		}
+	}
+	if(t3f_loads_finished >= t3f_loads_queued)
+	{
+		t3f_loads_queued = 0;
+		t3f_loads_finished = 0;
+	}
+	T3F_TRACE_END();
+	return count;
+}
+
+/* called once per logic tick by the framework from the thread that owns the
+   display, resources left over from display loss recovery share the time
+   slice */
+void t3f_update_loads(void)
+{
+	double start_time = al_get_time();
+	double time_left;
+
+	t3f_finish_loads(t3f_load_time_slice);
+	time_left = t3f_load_time_slice - (al_get_time() - start_time);
+	t3f_update_resource_recovery(time_left > 0.0 ? time_left : 0.0);
+}
+
+void t3f_wait_for_loads(void)
+{
+	if(t3f_load_counter)
+	{
+		t3f_wait_job_counter(t3f_load_counter);
+	}
+	t3f_finish_loads(-1.0);
+}
+
+void t3f_shutdown_loader(void)
+{
+	t3f_wait_for_loads();
+	t3f_update_resource_recovery(-1.0);
+	if(t3f_load_counter)
+	{
+		t3f_destroy_job_counter(t3f_load_counter);
+		t3f_load_counter = NULL;
+	}
+	if(t3f_load_mutex)
+	{
+		al_destroy_mutex(t3f_load_mutex);
+		t3f_load_mutex = NULL;
+	}
+}
+
+void t3f_set_load_time_slice(double seconds)
+{
+	t3f_load_time_slice = seconds;
+}
+
+int t3f_get_pending_loads(void)
+{
+	return t3f_loads_queued - t3f_loads_finished;
+}
+
+/* true if decoded requests are waiting for t3f_finish_loads() */
+bool t3f_loads_waiting(void)
+{
+	bool ret;
+
+	if(!t3f_loads_queued)
+	{
+		return false;
+	}
+	al_lock_mutex(t3f_load_mutex);
+	ret = t3f_load_done != NULL;
+	al_unlock_mutex(t3f_load_mutex);
+	return ret;
+}
+
+/* fraction of the loads queued since the queue was last empty that have been
+   finished, 1.0 when nothing is loading */
+float t3f_get_load_progress(void)
+{
+	if(!t3f_loads_queued)
+	{
+		return 1.0;
+	}
+	return (float)t3f_loads_finished / (float)t3f_loads_queued;
+}
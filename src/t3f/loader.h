@@ -0,0 +1,23 @@
+#ifndef T3F_LOADER_H
+#define T3F_LOADER_H
+
+#include <allegro5/allegro5.h>
+#include <allegro5/allegro_audio.h>
+
+#define T3F_DEFAULT_LOAD_TIME_SLICE 0.002
+
+bool t3f_queue_bitmap_load(ALLEGRO_BITMAP ** bp, const char * fn);
+bool t3f_queue_sample_load(ALLEGRO_SAMPLE ** sp, const char * fn);
+bool t3f_queue_load(bool (*load_proc)(void * data), void (*finish_proc)(void * data, bool loaded), void * data);
+
+int t3f_finish_loads(double max_time);
+void t3f_update_loads(void);
+void t3f_wait_for_loads(void);
+void t3f_shutdown_loader(void);
+
+void t3f_set_load_time_slice(double seconds);
+int t3f_get_pending_loads(void);
+bool t3f_loads_waiting(void);
+float t3f_get_load_progress(void);
+
+#endif
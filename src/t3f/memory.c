@@ -1,30 +1,86 @@
 #include "t3f.h"
+#include <stdint.h>
 
-#define T3F_MAX_MEMORY_INFO 1000000
+/* live blocks are kept in an open addressing hash table keyed by pointer,
+   every block points at the call site that allocated it and the tag it was
+   charged to so we can report who is using the memory, nothing in here
+   prints while tracking */
+
+#define _T3F_MEMORY_MIN_TABLE 4096
+
+typedef struct
+{
+
+	void * p;
+	size_t size;
+	int site;
+	int tag;
+
+} T3F_MEMORY_BLOCK;
+
+/* a budget we need to report once the lock is released */
+typedef struct
+{
+
+	int tag;
+	unsigned long live_bytes;
+	unsigned long budget;
+
+} T3F_MEMORY_BUDGET_NOTICE;
 
 static ALLEGRO_MEMORY_INTERFACE t3f_memory_interface;
+static ALLEGRO_MUTEX * t3f_memory_mutex = NULL;
 int t3f_alloc_count = 0;
 unsigned long t3f_current_memory_usage = 0;
 unsigned long t3f_max_memory_usage = 0;
+static T3F_MEMORY_STATS t3f_memory_stats;
 
-typedef struct
+static T3F_MEMORY_BLOCK * t3f_memory_block = NULL;
+static unsigned long t3f_memory_block_size = 0; // always a power of two
+static unsigned long t3f_memory_blocks = 0;
+
+/* sites are stored in order of appearance, the hash table holds index + 1 */
+static T3F_MEMORY_SITE * t3f_memory_site = NULL;
+static int t3f_memory_sites = 0;
+static int t3f_memory_site_space = 0;
+static int * t3f_memory_site_table = NULL;
+static unsigned long t3f_memory_site_table_size = 0;
+
+/* the extra entry at the end holds the totals for T3F_MEMORY_TAG_TOTAL */
+static T3F_MEMORY_TAG_STATS t3f_memory_tag[T3F_MAX_MEMORY_TAGS + 1];
+static const char * t3f_memory_tag_name[T3F_MAX_MEMORY_TAGS] = {"general", "atlas", "font", "audio", "tilemap", "resource"};
+static void (*t3f_memory_budget_proc)(int tag, unsigned long live_bytes, unsigned long budget, void * data) = NULL;
+static void * t3f_memory_budget_data = NULL;
+static T3F_THREAD_LOCAL int t3f_memory_tag_stack[T3F_MEMORY_TAG_STACK];
+static T3F_THREAD_LOCAL int t3f_memory_tag_depth = 0;
+
+static unsigned long hash_pointer(const void * p)
 {
-	
-	void * p;
-	unsigned long size;
+	uintptr_t v = (uintptr_t)p;
 
-} MEM_BLOCK;
+	v ^= v >> 16;
+	v *= 0x45d9f3b;
+	v ^= v >> 16;
+	return v;
+}
 
-MEM_BLOCK mem_block[10000];
-int mem_blocks = 0;
+static unsigned long hash_site(const char * file, int line, const char * func)
+{
+	return hash_pointer(file) ^ (hash_pointer(func) * 31) ^ ((unsigned long)line * 2654435761u);
+}
 
-static int find_mem_block(void * p)
+static long find_block(void * p)
 {
-	int i;
-	
-	for(i = 0; i < mem_blocks; i++)
+	unsigned long mask = t3f_memory_block_size - 1;
+	unsigned long i;
+
+	if(!t3f_memory_block)
 	{
-		if(p == mem_block[i].p)
+		return -1;
+	}
+	for(i = hash_pointer(p) & mask; t3f_memory_block[i].p; i = (i + 1) & mask)
+	{
+		if(t3f_memory_block[i].p == p)
 		{
 			return i;
 		}
@@ -32,122 +88,601 @@ static int find_mem_block(void * p)
 	return -1;
 }
 
-static int remove_mem_block(void * p)
+static void insert_block(T3F_MEMORY_BLOCK * table, unsigned long size, T3F_MEMORY_BLOCK * bp)
 {
-	int i, j;
-	
-	i = find_mem_block(p);
-	if(i < 0)
+	unsigned long i;
+
+	for(i = hash_pointer(bp->p) & (size - 1); table[i].p; i = (i + 1) & (size - 1));
+	table[i] = *bp;
+}
+
+/* keep the table at most half full */
+static bool grow_blocks(void)
+{
+	T3F_MEMORY_BLOCK * new_block;
+	unsigned long new_size;
+	unsigned long i;
+
+	if(t3f_memory_block && (t3f_memory_blocks + 1) * 2 <= t3f_memory_block_size)
 	{
-		return 0;
+		return true;
+	}
+	new_size = t3f_memory_block_size ? t3f_memory_block_size * 2 : _T3F_MEMORY_MIN_TABLE;
+	new_block = calloc(new_size, sizeof(T3F_MEMORY_BLOCK));
+	if(!new_block)
+	{
+		return false;
+	}
+	for(i = 0; i < t3f_memory_block_size; i++)
+	{
+		if(t3f_memory_block[i].p)
+		{
+			insert_block(new_block, new_size, &t3f_memory_block[i]);
+		}
 	}
-	for(j = i; j < mem_blocks - 1; j++)
+	free(t3f_memory_block);
+	t3f_memory_block = new_block;
+	t3f_memory_block_size = new_size;
+	return true;
+}
+
+/* shift following entries back so lookups never need tombstones */
+static void remove_block(unsigned long i)
+{
+	unsigned long mask = t3f_memory_block_size - 1;
+	unsigned long j = i;
+	unsigned long k;
+
+	while(1)
 	{
-		memcpy(&mem_block[j], &mem_block[j + 1], sizeof(MEM_BLOCK));
+		j = (j + 1) & mask;
+		if(!t3f_memory_block[j].p)
+		{
+			break;
+		}
+		k = hash_pointer(t3f_memory_block[j].p) & mask;
+		if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+		{
+			continue;
+		}
+		t3f_memory_block[i] = t3f_memory_block[j];
+		i = j;
 	}
-	mem_blocks--;
-	return 1;
+	t3f_memory_block[i].p = NULL;
+	t3f_memory_blocks--;
 }
 
-static int add_mem_block(void * p, unsigned long size)
+static bool grow_sites(void)
 {
-	if(mem_blocks < 10000)
+	T3F_MEMORY_SITE * new_site;
+	int * new_table;
+	unsigned long new_size;
+	unsigned long i, j;
+	int space;
+
+	if(t3f_memory_sites >= t3f_memory_site_space)
 	{
-		mem_block[mem_blocks].p = p;
-		mem_block[mem_blocks].size = size;
-		mem_blocks++;
-		return 1;
+		space = t3f_memory_site_space ? t3f_memory_site_space * 2 : 256;
+		new_site = realloc(t3f_memory_site, sizeof(T3F_MEMORY_SITE) * space);
+		if(!new_site)
+		{
+			return false;
+		}
+		t3f_memory_site = new_site;
+		t3f_memory_site_space = space;
 	}
-	else
+	if((unsigned long)(t3f_memory_sites + 1) * 2 > t3f_memory_site_table_size)
 	{
-		printf("max memory tracking reached\n");
+		new_size = t3f_memory_site_table_size ? t3f_memory_site_table_size * 2 : 512;
+		new_table = calloc(new_size, sizeof(int));
+		if(!new_table)
+		{
+			return false;
+		}
+		for(i = 0; i < t3f_memory_sites; i++)
+		{
+			for(j = hash_site(t3f_memory_site[i].file, t3f_memory_site[i].line, t3f_memory_site[i].func) & (new_size - 1); new_table[j]; j = (j + 1) & (new_size - 1));
+			new_table[j] = i + 1;
+		}
+		free(t3f_memory_site_table);
+		t3f_memory_site_table = new_table;
+		t3f_memory_site_table_size = new_size;
 	}
-	return 0;
+	return true;
 }
 
-static void update_max(void)
+/* returns -1 if we couldn't make room for a new site */
+static int get_site(const char * file, int line, const char * func)
 {
-	printf("%05d: max memory usage: %lu\n", t3f_alloc_count, t3f_max_memory_usage);
-	if(t3f_current_memory_usage > t3f_max_memory_usage)
+	T3F_MEMORY_SITE * sp;
+	unsigned long mask;
+	unsigned long i;
+
+	if(t3f_memory_site_table)
 	{
-		t3f_max_memory_usage = t3f_current_memory_usage;
+		mask = t3f_memory_site_table_size - 1;
+		for(i = hash_site(file, line, func) & mask; t3f_memory_site_table[i]; i = (i + 1) & mask)
+		{
+			sp = &t3f_memory_site[t3f_memory_site_table[i] - 1];
+			if(sp->line == line && sp->file == file && sp->func == func)
+			{
+				return t3f_memory_site_table[i] - 1;
+			}
+		}
 	}
+	if(!grow_sites())
+	{
+		return -1;
+	}
+	sp = &t3f_memory_site[t3f_memory_sites];
+	memset(sp, 0, sizeof(T3F_MEMORY_SITE));
+	sp->file = file;
+	sp->line = line;
+	sp->func = func;
+	mask = t3f_memory_site_table_size - 1;
+	for(i = hash_site(file, line, func) & mask; t3f_memory_site_table[i]; i = (i + 1) & mask);
+	t3f_memory_site_table[i] = t3f_memory_sites + 1;
+	t3f_memory_sites++;
+	t3f_memory_stats.call_sites = t3f_memory_sites;
+	return t3f_memory_sites - 1;
 }
 
-void * t3f_malloc(size_t n, int line, const char * file, const char * func)
+static void update_totals(void)
 {
-	void * p;
-	
-	p = malloc(n);
-	if(p)
+	if(t3f_memory_stats.live_bytes > t3f_memory_stats.peak_bytes)
 	{
-		t3f_alloc_count++;
-		add_mem_block(p, n);
-		t3f_current_memory_usage += n;
-		update_max();
+		t3f_memory_stats.peak_bytes = t3f_memory_stats.live_bytes;
 	}
-	return p;
+	t3f_alloc_count = t3f_memory_stats.live_blocks;
+	t3f_current_memory_usage = t3f_memory_stats.live_bytes;
+	t3f_max_memory_usage = t3f_memory_stats.peak_bytes;
 }
 
-void * t3f_realloc(void * ptr, size_t n, int line, const char * file, const char * func)
+static int get_tag_index(int tag)
 {
-	void * p;
+	if(tag == T3F_MEMORY_TAG_TOTAL)
+	{
+		return T3F_MAX_MEMORY_TAGS;
+	}
+	if(tag < 0 || tag >= T3F_MAX_MEMORY_TAGS)
+	{
+		return T3F_MEMORY_TAG_GENERAL;
+	}
+	return tag;
+}
+
+static void tag_add(int tag, long n, bool new_block)
+{
+	int t[2] = {tag, T3F_MAX_MEMORY_TAGS};
+	T3F_MEMORY_TAG_STATS * tp;
 	int i;
 
-	i = find_mem_block(ptr);
-	p = realloc(ptr, n);
-	if(p)
+	for(i = 0; i < 2; i++)
 	{
-		t3f_current_memory_usage += n - mem_block[i].size;
-		if(i >= 0)
+		tp = &t3f_memory_tag[t[i]];
+		tp->live_bytes += n;
+		if(new_block)
 		{
-			mem_block[i].size = n;
-			mem_block[i].p = p;
+			tp->allocations++;
+		}
+		if(tp->live_bytes > tp->peak_bytes)
+		{
+			tp->peak_bytes = tp->live_bytes;
 		}
-		update_max();
 	}
-	return p;
 }
 
-void * t3f_calloc(size_t count, size_t n, int line, const char * file, const char * func)
+/* see if n more bytes fit in the tag's budget and the total budget, returns
+   false if the allocation has to be refused, caller holds the mutex */
+static bool check_budget(int tag, long n, T3F_MEMORY_BUDGET_NOTICE * np)
 {
-	void * p;
-	
-	p = calloc(count, n);
-	if(p)
+	int t[2] = {tag, T3F_MAX_MEMORY_TAGS};
+	T3F_MEMORY_TAG_STATS * tp;
+	int i;
+
+	if(n <= 0)
+	{
+		return true;
+	}
+	for(i = 0; i < 2; i++)
+	{
+		tp = &t3f_memory_tag[t[i]];
+		if(tp->budget && tp->live_bytes + n > tp->budget)
+		{
+			if(tp->budget_flags & T3F_MEMORY_BUDGET_FAIL)
+			{
+				tp->failures++;
+				np->tag = i ? T3F_MEMORY_TAG_TOTAL : tag;
+				np->live_bytes = tp->live_bytes;
+				np->budget = tp->budget;
+				return false;
+			}
+			if(tp->live_bytes <= tp->budget)
+			{
+				tp->over_budget++;
+				if(tp->budget_flags & T3F_MEMORY_BUDGET_WARN)
+				{
+					np->tag = i ? T3F_MEMORY_TAG_TOTAL : tag;
+					np->live_bytes = tp->live_bytes + n;
+					np->budget = tp->budget;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+static void send_budget_notice(T3F_MEMORY_BUDGET_NOTICE * np)
+{
+	if(np->budget && t3f_memory_budget_proc)
+	{
+		t3f_memory_budget_proc(np->tag, np->live_bytes, np->budget, t3f_memory_budget_data);
+	}
+}
+
+static void site_add(int site, size_t n)
+{
+	T3F_MEMORY_SITE * sp;
+
+	if(site < 0)
+	{
+		return;
+	}
+	sp = &t3f_memory_site[site];
+	sp->live_blocks++;
+	sp->live_bytes += n;
+	sp->allocations++;
+	sp->allocated_bytes += n;
+	if(sp->live_bytes > sp->peak_bytes)
+	{
+		sp->peak_bytes = sp->live_bytes;
+	}
+}
+
+static void site_remove(int site, size_t n)
+{
+	if(site >= 0)
+	{
+		t3f_memory_site[site].live_blocks--;
+		t3f_memory_site[site].live_bytes -= n;
+	}
+}
+
+/* caller holds the mutex */
+static void track_block(void * p, size_t n, int site, int tag)
+{
+	T3F_MEMORY_BLOCK block;
+
+	if(!grow_blocks())
+	{
+		return;
+	}
+	block.p = p;
+	block.size = n;
+	block.site = site;
+	block.tag = tag;
+	insert_block(t3f_memory_block, t3f_memory_block_size, &block);
+	t3f_memory_blocks++;
+	site_add(site, n);
+	tag_add(tag, n, true);
+	t3f_memory_stats.live_blocks++;
+	t3f_memory_stats.live_bytes += n;
+	t3f_memory_stats.allocations++;
+	t3f_memory_stats.allocated_bytes += n;
+	update_totals();
+}
+
+/* caller holds the mutex */
+static void untrack_block(void * p)
+{
+	long i = find_block(p);
+
+	if(i < 0)
+	{
+		t3f_memory_stats.unknown_frees++;
+		return;
+	}
+	site_remove(t3f_memory_block[i].site, t3f_memory_block[i].size);
+	tag_add(t3f_memory_block[i].tag, -(long)t3f_memory_block[i].size, false);
+	t3f_memory_stats.live_blocks--;
+	t3f_memory_stats.live_bytes -= t3f_memory_block[i].size;
+	t3f_memory_stats.frees++;
+	t3f_memory_stats.freed_bytes += t3f_memory_block[i].size;
+	remove_block(i);
+	update_totals();
+}
+
+static void * t3f_malloc(size_t n, int line, const char * file, const char * func)
+{
+	T3F_MEMORY_BUDGET_NOTICE notice = {0};
+	int tag = get_tag_index(t3f_get_memory_tag());
+	void * p = NULL;
+
+	al_lock_mutex(t3f_memory_mutex);
+	if(check_budget(tag, n, &notice))
 	{
-		t3f_alloc_count++;
-		add_mem_block(p, n);
-		t3f_current_memory_usage += n;
-		update_max();
+		p = malloc(n);
+		if(p)
+		{
+			track_block(p, n, get_site(file, line, func), tag);
+		}
 	}
+	al_unlock_mutex(t3f_memory_mutex);
+	send_budget_notice(&notice);
 	return p;
 }
 
-void t3f_free(void * ptr, int line, const char * file, const char * func)
+/* the realloc happens under the lock so another thread can't be handed the
+   old address before we stop tracking it, growth is charged to the tag the
+   block was first allocated under */
+static void * t3f_realloc(void * ptr, size_t n, int line, const char * file, const char * func)
 {
-	int i;
-	
-	i = find_mem_block(ptr);
+	T3F_MEMORY_BUDGET_NOTICE notice = {0};
+	void * p = NULL;
+	int site = -1;
+	int tag = get_tag_index(t3f_get_memory_tag());
+	size_t old_size = 0;
+	long i;
+
+	if(!ptr)
+	{
+		return t3f_malloc(n, line, file, func);
+	}
+	al_lock_mutex(t3f_memory_mutex);
+	i = find_block(ptr);
 	if(i >= 0)
 	{
-		t3f_current_memory_usage -= mem_block[i].size;
-		printf("freed: %lu\n", mem_block[i].size);
+		site = t3f_memory_block[i].site;
+		tag = t3f_memory_block[i].tag;
+		old_size = t3f_memory_block[i].size;
 	}
-	else
+	if(check_budget(tag, (long)n - (long)old_size, &notice))
 	{
-		printf("no memory freed: %lu\n", ptr);
+		p = realloc(ptr, n);
+		if(p || !n)
+		{
+			untrack_block(ptr);
+			if(p)
+			{
+				if(site < 0)
+				{
+					site = get_site(file, line, func);
+				}
+				track_block(p, n, site, tag);
+			}
+		}
 	}
-	remove_mem_block(ptr);
+	al_unlock_mutex(t3f_memory_mutex);
+	send_budget_notice(&notice);
+	return p;
+}
+
+static void * t3f_calloc(size_t count, size_t n, int line, const char * file, const char * func)
+{
+	T3F_MEMORY_BUDGET_NOTICE notice = {0};
+	int tag = get_tag_index(t3f_get_memory_tag());
+	void * p = NULL;
+
+	al_lock_mutex(t3f_memory_mutex);
+	if(check_budget(tag, count * n, &notice))
+	{
+		p = calloc(count, n);
+		if(p)
+		{
+			track_block(p, count * n, get_site(file, line, func), tag);
+		}
+	}
+	al_unlock_mutex(t3f_memory_mutex);
+	send_budget_notice(&notice);
+	return p;
+}
+
+static void t3f_free(void * ptr, int line, const char * file, const char * func)
+{
+	if(!ptr)
+	{
+		return;
+	}
+	al_lock_mutex(t3f_memory_mutex);
+	untrack_block(ptr);
+	al_unlock_mutex(t3f_memory_mutex);
 	free(ptr);
-	t3f_alloc_count--;
 }
 
-void t3f_setup_memory_interface(void)
+/* route Allegro's allocations through the tracker, the mutex has to exist
+   before the interface is installed since creating it allocates */
+bool t3f_setup_memory_interface(void)
 {
+	if(!t3f_memory_mutex)
+	{
+		t3f_memory_mutex = al_create_mutex();
+		if(!t3f_memory_mutex)
+		{
+			return false;
+		}
+	}
 	t3f_memory_interface.mi_malloc = t3f_malloc;
 	t3f_memory_interface.mi_free = t3f_free;
 	t3f_memory_interface.mi_realloc = t3f_realloc;
 	t3f_memory_interface.mi_calloc = t3f_calloc;
 	al_set_memory_interface(&t3f_memory_interface);
+	return true;
+}
+
+void t3f_get_memory_stats(T3F_MEMORY_STATS * sp)
+{
+	if(!t3f_memory_mutex)
+	{
+		memset(sp, 0, sizeof(T3F_MEMORY_STATS));
+		return;
+	}
+	al_lock_mutex(t3f_memory_mutex);
+	memcpy(sp, &t3f_memory_stats, sizeof(T3F_MEMORY_STATS));
+	al_unlock_mutex(t3f_memory_mutex);
+}
+
+static int site_sorter(const void * e1, const void * e2)
+{
+	const T3F_MEMORY_SITE * s1 = (const T3F_MEMORY_SITE *)e1;
+	const T3F_MEMORY_SITE * s2 = (const T3F_MEMORY_SITE *)e2;
+
+	if(s1->live_bytes != s2->live_bytes)
+	{
+		return s1->live_bytes < s2->live_bytes ? 1 : -1;
+	}
+	if(s1->allocated_bytes != s2->allocated_bytes)
+	{
+		return s1->allocated_bytes < s2->allocated_bytes ? 1 : -1;
+	}
+	return 0;
+}
+
+/* fill sp with up to max sites, biggest live users first, returns how many
+   were filled in */
+int t3f_get_memory_sites(T3F_MEMORY_SITE * sp, int max)
+{
+	T3F_MEMORY_SITE * copy;
+	int count;
+
+	if(!t3f_memory_mutex || max <= 0)
+	{
+		return 0;
+	}
+	al_lock_mutex(t3f_memory_mutex);
+	count = t3f_memory_sites;
+	copy = malloc(sizeof(T3F_MEMORY_SITE) * (count ? count : 1));
+	if(copy)
+	{
+		memcpy(copy, t3f_memory_site, sizeof(T3F_MEMORY_SITE) * count);
+	}
+	al_unlock_mutex(t3f_memory_mutex);
+	if(!copy)
+	{
+		return 0;
+	}
+	qsort(copy, count, sizeof(T3F_MEMORY_SITE), site_sorter);
+	if(count > max)
+	{
+		count = max;
+	}
+	memcpy(sp, copy, sizeof(T3F_MEMORY_SITE) * count);
+	free(copy);
+	return count;
+}
+
+void t3f_print_memory_report(FILE * fp, int max_sites)
+{
+	T3F_MEMORY_STATS stats;
+	T3F_MEMORY_TAG_STATS tag;
+	T3F_MEMORY_SITE * site = NULL;
+	int sites = 0;
+	int i;
+
+	t3f_get_memory_stats(&stats);
+	fprintf(fp, "live: %lu bytes in %lu blocks, peak: %lu bytes\n", stats.live_bytes, stats.live_blocks, stats.peak_bytes);
+	fprintf(fp, "churn: %lu allocations (%lu bytes), %lu frees (%lu bytes), %lu unknown frees\n", stats.allocations, stats.allocated_bytes, stats.frees, stats.freed_bytes, stats.unknown_frees);
+	if(max_sites > 0)
+	{
+		site = malloc(sizeof(T3F_MEMORY_SITE) * max_sites);
+		if(site)
+		{
+			sites = t3f_get_memory_sites(site, max_sites);
+		}
+		fprintf(fp, "%12s %8s %12s %10s %12s  %s\n", "live bytes", "blocks", "peak bytes", "allocs", "churn bytes", "site");
+		for(i = 0; i < sites; i++)
+		{
+			fprintf(fp, "%12lu %8lu %12lu %10lu %12lu  %s:%d (%s)\n", site[i].live_bytes, site[i].live_blocks, site[i].peak_bytes, site[i].allocations, site[i].allocated_bytes, site[i].file ? site[i].file : "?", site[i].line, site[i].func ? site[i].func : "?");
+		}
+		free(site);
+	}
+	fprintf(fp, "%-12s %12s %12s %12s %8s %8s\n", "tag", "live bytes", "peak bytes", "budget", "over", "refused");
+	for(i = 0; i <= T3F_MAX_MEMORY_TAGS; i++)
+	{
+		t3f_get_memory_tag_stats(i < T3F_MAX_MEMORY_TAGS ? i : T3F_MEMORY_TAG_TOTAL, &tag);
+		if(tag.allocations || tag.budget)
+		{
+			fprintf(fp, "%-12s %12lu %12lu %12lu %8lu %8lu\n", tag.name ? tag.name : "?", tag.live_bytes, tag.peak_bytes, tag.budget, tag.over_budget, tag.failures);
+		}
+	}
+}
+
+/* tags nest, pop once for every push on the same thread */
+void t3f_push_memory_tag(int tag)
+{
+	if(t3f_memory_tag_depth < T3F_MEMORY_TAG_STACK)
+	{
+		t3f_memory_tag_stack[t3f_memory_tag_depth] = tag;
+	}
+	t3f_memory_tag_depth++;
+}
+
+void t3f_pop_memory_tag(void)
+{
+	if(t3f_memory_tag_depth > 0)
+	{
+		t3f_memory_tag_depth--;
+	}
+}
+
+int t3f_get_memory_tag(void)
+{
+	if(t3f_memory_tag_depth <= 0)
+	{
+		return T3F_MEMORY_TAG_GENERAL;
+	}
+	if(t3f_memory_tag_depth > T3F_MEMORY_TAG_STACK)
+	{
+		return t3f_memory_tag_stack[T3F_MEMORY_TAG_STACK - 1];
+	}
+	return t3f_memory_tag_stack[t3f_memory_tag_depth - 1];
+}
+
+/* name has to stay valid for as long as reports may be made */
+void t3f_set_memory_tag_name(int tag, const char * name)
+{
+	if(tag >= 0 && tag < T3F_MAX_MEMORY_TAGS)
+	{
+		t3f_memory_tag_name[tag] = name;
+	}
+}
+
+/* pass 0 bytes to remove the budget, the budget can be set before or after
+   the memory interface is set up */
+void t3f_set_memory_budget(int tag, unsigned long bytes, int flags)
+{
+	int i = get_tag_index(tag);
+
+	if(t3f_memory_mutex)
+	{
+		al_lock_mutex(t3f_memory_mutex);
+	}
+	t3f_memory_tag[i].budget = bytes;
+	t3f_memory_tag[i].budget_flags = flags;
+	if(t3f_memory_mutex)
+	{
+		al_unlock_mutex(t3f_memory_mutex);
+	}
+}
+
+/* called without the lock held so it may allocate */
+void t3f_set_memory_budget_callback(void (*proc)(int tag, unsigned long live_bytes, unsigned long budget, void * data), void * data)
+{
+	t3f_memory_budget_proc = proc;
+	t3f_memory_budget_data = data;
+}
+
+void t3f_get_memory_tag_stats(int tag, T3F_MEMORY_TAG_STATS * sp)
+{
+	int i = get_tag_index(tag);
+
+	if(t3f_memory_mutex)
+	{
+		al_lock_mutex(t3f_memory_mutex);
+	}
+	memcpy(sp, &t3f_memory_tag[i], sizeof(T3F_MEMORY_TAG_STATS));
+	if(t3f_memory_mutex)
+	{
+		al_unlock_mutex(t3f_memory_mutex);
+	}
+	sp->name = i < T3F_MAX_MEMORY_TAGS ? t3f_memory_tag_name[i] : "total";
 }
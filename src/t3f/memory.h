@@ -1,10 +1,85 @@
 #ifndef T3F_MEMORY_H
 #define T3F_MEMORY_H
 
+#include <stdio.h>
+
+/* tags let subsystems report their memory separately, allocations are
+   charged to the innermost tag pushed on the allocating thread */
+#define T3F_MEMORY_TAG_GENERAL   0
+#define T3F_MEMORY_TAG_ATLAS     1
+#define T3F_MEMORY_TAG_FONT      2
+#define T3F_MEMORY_TAG_AUDIO     3
+#define T3F_MEMORY_TAG_TILEMAP   4
+#define T3F_MEMORY_TAG_RESOURCE  5
+#define T3F_MEMORY_TAG_USER      8 // first tag apps can use for themselves
+#define T3F_MAX_MEMORY_TAGS     32
+#define T3F_MEMORY_TAG_TOTAL    -1 // budget covering every tag
+#define T3F_MEMORY_TAG_STACK    16
+
+/* what to do when an allocation takes a tag over its budget */
+#define T3F_MEMORY_BUDGET_WARN   1 // call the budget callback once when we cross the budget
+#define T3F_MEMORY_BUDGET_FAIL   2 // refuse the allocation
+
+typedef struct
+{
+
+	const char * name;
+	unsigned long live_bytes;
+	unsigned long peak_bytes;
+	unsigned long allocations;
+	unsigned long budget; // 0 for no budget
+	int budget_flags;
+	unsigned long over_budget; // times an allocation took us over the budget
+	unsigned long failures;    // allocations refused because of the budget
+
+} T3F_MEMORY_TAG_STATS;
+
+/* totals for everything allocated through the memory interface */
+typedef struct
+{
+
+	unsigned long live_blocks;
+	unsigned long live_bytes;
+	unsigned long peak_bytes;
+	unsigned long allocations;     // blocks allocated since setup
+	unsigned long frees;           // blocks freed since setup
+	unsigned long allocated_bytes; // churn, bytes handed out since setup
+	unsigned long freed_bytes;
+	unsigned long unknown_frees;   // frees of blocks we weren't tracking
+	int call_sites;
+
+} T3F_MEMORY_STATS;
+
+/* allocations grouped by where they were made */
+typedef struct
+{
+
+	const char * file;
+	const char * func;
+	int line;
+	unsigned long live_blocks;
+	unsigned long live_bytes;
+	unsigned long peak_bytes;
+	unsigned long allocations;
+	unsigned long allocated_bytes;
+
+} T3F_MEMORY_SITE;
+
 extern int t3f_alloc_count;
 extern unsigned long t3f_current_memory_usage;
 extern unsigned long t3f_max_memory_usage;
 
-void t3f_setup_memory_interface(void);
+bool t3f_setup_memory_interface(void);
+void t3f_get_memory_stats(T3F_MEMORY_STATS * sp);
+int t3f_get_memory_sites(T3F_MEMORY_SITE * sp, int max);
+void t3f_print_memory_report(FILE * fp, int max_sites);
+
+void t3f_push_memory_tag(int tag);
+void t3f_pop_memory_tag(void);
+int t3f_get_memory_tag(void);
+void t3f_set_memory_tag_name(int tag, const char * name);
+void t3f_set_memory_budget(int tag, unsigned long bytes, int flags);
+void t3f_set_memory_budget_callback(void (*proc)(int tag, unsigned long live_bytes, unsigned long budget, void * data), void * data);
+void t3f_get_memory_tag_stats(int tag, T3F_MEMORY_TAG_STATS * sp);
 
 #endif
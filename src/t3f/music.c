@@ -71,7 +71,11 @@ static void * t3f_play_music_thread(ALLEGRO_THREAD * thread, void * arg)
 	}
 	ALLEGRO_DEBUG("setting file interface\n");
 	al_set_new_file_interface(t3f_music_thread_file_interface);
+	T3F_TRACE_BEGIN("load_music");
+	t3f_push_memory_tag(T3F_MEMORY_TAG_AUDIO);
 	t3f_stream = al_load_audio_stream(t3f_music_thread_fn, 4, 4096);
+	t3f_pop_memory_tag();
+	T3F_TRACE_END();
 	if(!t3f_stream)
 	{
 		al_unlock_mutex(t3f_music_mutex);
@@ -246,6 +250,18 @@ void t3f_stop_music(void)
 	}
 }
 
+/* wait for a track that is still loading before stopping so nothing is
+   left running on the music thread */
+void t3f_shutdown_music(void)
+{
+	if(t3f_music_thread)
+	{
+		al_destroy_thread(t3f_music_thread);
+		t3f_music_thread = NULL;
+	}
+	t3f_stop_music();
+}
+
 void t3f_pause_music(void)
 {
 	if(t3f_stream && t3f_music_mutex)
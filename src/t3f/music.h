@@ -20,6 +20,7 @@ extern int t3f_music_state;
 
 bool t3f_play_music(const char * fn);
 void t3f_stop_music(void);
+void t3f_shutdown_music(void);
 void t3f_pause_music(void);
 void t3f_resume_music(void);
 void t3f_set_music_volume(float volume);
@@ -0,0 +1,773 @@
+#include "t3f.h"
+#include "file.h"
+#include "pack.h"
+
+#ifdef ALLEGRO_WINDOWS
+	#include <windows.h>
+#elif defined(ALLEGRO_UNIX)
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+/* compressed entries need zlib, build with -DT3F_PACK_ZLIB and link -lz */
+#ifdef T3F_PACK_ZLIB
+	#include <zlib.h>
+#endif
+
+#define _T3F_PACK_MAX_NAME 1024
+
+struct T3F_PACK
+{
+
+	const unsigned char * data;
+	uint64_t size;
+	time_t mtime; // of the pack file, set when it is mounted
+
+	const unsigned char * bucket;
+	const unsigned char * entry;
+	uint32_t buckets;
+	int entries;
+
+	/* how the data got into memory, so it can be let go of again */
+	void * buffer;
+	#ifdef ALLEGRO_WINDOWS
+		HANDLE file;
+		HANDLE mapping;
+	#endif
+
+};
+
+/* open file, either an entry in a pack or a file opened through the fallback
+   interface */
+typedef struct
+{
+
+	const unsigned char * data;
+	int64_t size;
+	int64_t pos;
+	void * buffer; // inflated entry data
+	bool eof;
+
+	ALLEGRO_FILE * file;
+
+} T3F_PACK_FILE;
+
+static T3F_PACK * t3f_pack[T3F_MAX_PACKS];
+static int t3f_packs = 0;
+static const ALLEGRO_FILE_INTERFACE * t3f_pack_fallback_interface = NULL;
+static const ALLEGRO_FILE_INTERFACE t3f_pack_file_interface;
+
+static uint32_t read_u32(const unsigned char * p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read_u64(const unsigned char * p)
+{
+	return (uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32);
+}
+
+/* FNV-1a, the builder uses the same function so it must never change */
+uint32_t t3f_pack_hash(const char * name)
+{
+	uint32_t h = 2166136261u;
+
+	while(*name)
+	{
+		h ^= (unsigned char)*name;
+		h *= 16777619u;
+		name++;
+	}
+	return h;
+}
+
+static bool map_pack(T3F_PACK * pp, const char * fn)
+{
+	#ifdef ALLEGRO_WINDOWS
+
+		wchar_t wfn[MAX_PATH];
+		LARGE_INTEGER size;
+
+		if(!MultiByteToWideChar(CP_UTF8, 0, fn, -1, wfn, MAX_PATH))
+		{
+			return false;
+		}
+		pp->file = CreateFileW(wfn, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+		if(pp->file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		if(!GetFileSizeEx(pp->file, &size) || size.QuadPart == 0)
+		{
+			goto fail;
+		}
+		pp->mapping = CreateFileMappingW(pp->file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(!pp->mapping)
+		{
+			goto fail;
+		}
+		pp->data = MapViewOfFile(pp->mapping, FILE_MAP_READ, 0, 0, 0);
+		if(!pp->data)
+		{
+			goto fail;
+		}
+		pp->size = size.QuadPart;
+		return true;
+
+		fail:
+		{
+			if(pp->mapping)
+			{
+				CloseHandle(pp->mapping);
+				pp->mapping = NULL;
+			}
+			CloseHandle(pp->file);
+			pp->file = INVALID_HANDLE_VALUE;
+			return false;
+		}
+
+	#elif defined(ALLEGRO_UNIX)
+
+		struct stat st;
+		void * data;
+		int fd;
+
+		/* on Android the data usually lives in the APK where this fails and
+		   we read the pack in through the file interface instead */
+		fd = open(fn, O_RDONLY);
+		if(fd < 0)
+		{
+			return false;
+		}
+		if(fstat(fd, &st) || st.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if(data == MAP_FAILED)
+		{
+			return false;
+		}
+		pp->data = data;
+		pp->size = st.st_size;
+		return true;
+
+	#else
+
+		return false;
+
+	#endif
+}
+
+static void unmap_pack(T3F_PACK * pp)
+{
+	#ifdef ALLEGRO_WINDOWS
+
+		UnmapViewOfFile(pp->data);
+		CloseHandle(pp->mapping);
+		CloseHandle(pp->file);
+
+	#elif defined(ALLEGRO_UNIX)
+
+		munmap((void *)pp->data, pp->size);
+
+	#endif
+}
+
+static bool read_pack(T3F_PACK * pp, const char * fn)
+{
+	ALLEGRO_FILE * fp;
+	int64_t size;
+
+	fp = al_fopen(fn, "rb");
+	if(!fp)
+	{
+		return false;
+	}
+	size = al_fsize(fp);
+	if(size <= 0)
+	{
+		goto fail;
+	}
+	pp->buffer = al_malloc(size);
+	if(!pp->buffer)
+	{
+		goto fail;
+	}
+	if(al_fread(fp, pp->buffer, size) != size)
+	{
+		goto fail;
+	}
+	al_fclose(fp);
+	pp->data = pp->buffer;
+	pp->size = size;
+	return true;
+
+	fail:
+	{
+		if(pp->buffer)
+		{
+			al_free(pp->buffer);
+			pp->buffer = NULL;
+		}
+		al_fclose(fp);
+		return false;
+	}
+}
+
+/* make sure the table of contents can't send us outside the pack */
+static bool check_pack(T3F_PACK * pp)
+{
+	uint64_t toc_size;
+	uint64_t name_start;
+	uint64_t offset, stored_size;
+	const unsigned char * ep;
+	int i;
+
+	if(pp->size < T3F_PACK_HEADER_SIZE || memcmp(pp->data, T3F_PACK_MAGIC, 4) || read_u32(pp->data + T3F_PACK_HEADER_VERSION) != T3F_PACK_VERSION)
+	{
+		return false;
+	}
+	pp->entries = read_u32(pp->data + T3F_PACK_HEADER_ENTRIES);
+	pp->buckets = read_u32(pp->data + T3F_PACK_HEADER_BUCKETS);
+	toc_size = read_u32(pp->data + T3F_PACK_HEADER_TOC_SIZE);
+	if(pp->entries < 0 || pp->buckets == 0 || (pp->buckets & (pp->buckets - 1)) || pp->buckets <= (uint32_t)pp->entries)
+	{
+		return false;
+	}
+	name_start = T3F_PACK_HEADER_SIZE + (uint64_t)pp->buckets * 4 + (uint64_t)pp->entries * T3F_PACK_ENTRY_SIZE;
+	if(toc_size < name_start || toc_size > pp->size)
+	{
+		return false;
+	}
+	pp->bucket = pp->data + T3F_PACK_HEADER_SIZE;
+	pp->entry = pp->bucket + pp->buckets * 4;
+	for(i = 0; i < pp->entries; i++)
+	{
+		ep = pp->entry + i * T3F_PACK_ENTRY_SIZE;
+		offset = read_u32(ep + T3F_PACK_ENTRY_NAME);
+		if(offset < name_start || offset + read_u32(ep + T3F_PACK_ENTRY_NAME_LENGTH) >= toc_size || pp->data[offset + read_u32(ep + T3F_PACK_ENTRY_NAME_LENGTH)] != 0)
+		{
+			return false;
+		}
+		offset = read_u64(ep + T3F_PACK_ENTRY_OFFSET);
+		stored_size = read_u64(ep + T3F_PACK_ENTRY_STORED_SIZE);
+		if(offset < toc_size || offset > pp->size || stored_size > pp->size - offset)
+		{
+			return false;
+		}
+		if(!(read_u32(ep + T3F_PACK_ENTRY_FLAGS) & T3F_PACK_ENTRY_DEFLATE) && stored_size != read_u64(ep + T3F_PACK_ENTRY_DATA_SIZE))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+T3F_PACK * t3f_open_pack(const char * fn)
+{
+	T3F_PACK * pp;
+
+	pp = al_calloc(1, sizeof(T3F_PACK));
+	if(!pp)
+	{
+		return NULL;
+	}
+	#ifdef ALLEGRO_WINDOWS
+		pp->file = INVALID_HANDLE_VALUE;
+	#endif
+	if(!map_pack(pp, fn) && !read_pack(pp, fn))
+	{
+		al_free(pp);
+		return NULL;
+	}
+	if(!check_pack(pp))
+	{
+		t3f_close_pack(pp);
+		return NULL;
+	}
+	return pp;
+}
+
+void t3f_close_pack(T3F_PACK * pp)
+{
+	if(pp->buffer)
+	{
+		al_free(pp->buffer);
+	}
+	else
+	{
+		unmap_pack(pp);
+	}
+	al_free(pp);
+}
+
+int t3f_get_pack_entries(T3F_PACK * pp)
+{
+	return pp->entries;
+}
+
+/* file names are stored with forward slashes and without a leading "./" */
+static const char * normalize_name(const char * name, char * buf)
+{
+	int i;
+
+	while(name[0] == '.' && (name[1] == '/' || name[1] == '\\'))
+	{
+		name += 2;
+	}
+	if(!strchr(name, '\\'))
+	{
+		return name;
+	}
+	for(i = 0; name[i]; i++)
+	{
+		if(i >= _T3F_PACK_MAX_NAME - 1)
+		{
+			return NULL;
+		}
+		buf[i] = name[i] == '\\' ? '/' : name[i];
+	}
+	buf[i] = 0;
+	return buf;
+}
+
+int t3f_find_pack_entry(T3F_PACK * pp, const char * name)
+{
+	char buf[_T3F_PACK_MAX_NAME];
+	const unsigned char * ep;
+	uint32_t h, i, e, probes;
+
+	name = normalize_name(name, buf);
+	if(!name)
+	{
+		return -1;
+	}
+	h = t3f_pack_hash(name);
+
+	/* a damaged table may have no empty bucket to stop at */
+	for(i = h & (pp->buckets - 1), probes = 0; probes < pp->buckets; i = (i + 1) & (pp->buckets - 1), probes++)
+	{
+		e = read_u32(pp->bucket + i * 4);
+		if(e == 0 || e > (uint32_t)pp->entries)
+		{
+			return -1;
+		}
+		ep = pp->entry + (e - 1) * T3F_PACK_ENTRY_SIZE;
+		if(read_u32(ep + T3F_PACK_ENTRY_HASH) == h && !strcmp((const char *)pp->data + read_u32(ep + T3F_PACK_ENTRY_NAME), name))
+		{
+			return e - 1;
+		}
+	}
+	return -1;
+}
+
+const char * t3f_get_pack_entry_name(T3F_PACK * pp, int entry)
+{
+	return (const char *)pp->data + read_u32(pp->entry + entry * T3F_PACK_ENTRY_SIZE + T3F_PACK_ENTRY_NAME);
+}
+
+uint64_t t3f_get_pack_entry_size(T3F_PACK * pp, int entry)
+{
+	return read_u64(pp->entry + entry * T3F_PACK_ENTRY_SIZE + T3F_PACK_ENTRY_DATA_SIZE);
+}
+
+/* returns the entry's bytes in place, compressed entries have to be read
+   through t3f_open_pack_entry() */
+const void * t3f_get_pack_entry_data(T3F_PACK * pp, int entry)
+{
+	const unsigned char * ep = pp->entry + entry * T3F_PACK_ENTRY_SIZE;
+
+	if(read_u32(ep + T3F_PACK_ENTRY_FLAGS) & T3F_PACK_ENTRY_DEFLATE)
+	{
+		return NULL;
+	}
+	return pp->data + read_u64(ep + T3F_PACK_ENTRY_OFFSET);
+}
+
+static T3F_PACK_FILE * open_entry(T3F_PACK * pp, int entry)
+{
+	const unsigned char * ep = pp->entry + entry * T3F_PACK_ENTRY_SIZE;
+	T3F_PACK_FILE * fp;
+
+	fp = al_calloc(1, sizeof(T3F_PACK_FILE));
+	if(!fp)
+	{
+		return NULL;
+	}
+	fp->data = pp->data + read_u64(ep + T3F_PACK_ENTRY_OFFSET);
+	fp->size = read_u64(ep + T3F_PACK_ENTRY_DATA_SIZE);
+	if(read_u32(ep + T3F_PACK_ENTRY_FLAGS) & T3F_PACK_ENTRY_DEFLATE)
+	{
+		#ifdef T3F_PACK_ZLIB
+
+			uLongf size = fp->size;
+
+			/* one call to malloc for an empty entry is still fine */
+			fp->buffer = al_malloc(fp->size ? fp->size : 1);
+			if(!fp->buffer)
+			{
+				goto fail;
+			}
+			if(uncompress(fp->buffer, &size, fp->data, read_u64(ep + T3F_PACK_ENTRY_STORED_SIZE)) != Z_OK || size != fp->size)
+			{
+				goto fail;
+			}
+			fp->data = fp->buffer;
+
+		#else
+
+			goto fail;
+
+		#endif
+	}
+	return fp;
+
+	fail:
+	{
+		if(fp->buffer)
+		{
+			al_free(fp->buffer);
+		}
+		al_free(fp);
+		return NULL;
+	}
+}
+
+ALLEGRO_FILE * t3f_open_pack_entry(T3F_PACK * pp, int entry)
+{
+	T3F_PACK_FILE * fp;
+	ALLEGRO_FILE * rp;
+
+	if(entry < 0 || entry >= pp->entries)
+	{
+		return NULL;
+	}
+	fp = open_entry(pp, entry);
+	if(!fp)
+	{
+		return NULL;
+	}
+	rp = al_create_file_handle(&t3f_pack_file_interface, fp);
+	if(!rp)
+	{
+		al_free(fp->buffer);
+		al_free(fp);
+	}
+	return rp;
+}
+
+bool t3f_mount_pack(const char * fn)
+{
+	const ALLEGRO_FILE_INTERFACE * old_fi;
+	T3F_PACK * pp;
+
+	if(t3f_packs >= T3F_MAX_PACKS)
+	{
+		return false;
+	}
+
+	/* the pack itself has to be read through the fallback interface */
+	old_fi = al_get_new_file_interface();
+	if(t3f_packs)
+	{
+		al_set_new_file_interface(t3f_pack_fallback_interface);
+	}
+	pp = t3f_open_pack(fn);
+	al_set_new_file_interface(old_fi);
+	if(!pp)
+	{
+		return false;
+	}
+	pp->mtime = t3f_get_file_mtime(fn);
+	if(!t3f_packs)
+	{
+		t3f_pack_fallback_interface = old_fi;
+	}
+	t3f_pack[t3f_packs] = pp;
+	t3f_packs++;
+	al_set_new_file_interface(&t3f_pack_file_interface);
+	return true;
+}
+
+/* files still open from a pack must be closed before this */
+void t3f_unmount_packs(void)
+{
+	int i;
+
+	if(!t3f_packs)
+	{
+		return;
+	}
+	for(i = 0; i < t3f_packs; i++)
+	{
+		t3f_close_pack(t3f_pack[i]);
+	}
+	t3f_packs = 0;
+	if(al_get_new_file_interface() == &t3f_pack_file_interface)
+	{
+		al_set_new_file_interface(t3f_pack_fallback_interface);
+	}
+}
+
+const ALLEGRO_FILE_INTERFACE * t3f_get_pack_file_interface(void)
+{
+	return &t3f_pack_file_interface;
+}
+
+/* the filesystem can't see into packs, so entries report their own size and
+   the time of the pack they are in, false if no mounted pack has fn */
+bool t3f_get_packed_file_info(const char * fn, uint64_t * size, time_t * mtime)
+{
+	int i, entry;
+
+	for(i = t3f_packs - 1; i >= 0; i--)
+	{
+		entry = t3f_find_pack_entry(t3f_pack[i], fn);
+		if(entry >= 0)
+		{
+			*size = t3f_get_pack_entry_size(t3f_pack[i], entry);
+			*mtime = t3f_pack[i]->mtime;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void * pack_fopen(const char * path, const char * mode)
+{
+	T3F_PACK_FILE * fp;
+	int i, entry;
+
+	/* packs are read only, writes always go to the real file */
+	if(!strpbrk(mode, "wa+"))
+	{
+		for(i = t3f_packs - 1; i >= 0; i--)
+		{
+			entry = t3f_find_pack_entry(t3f_pack[i], path);
+			if(entry >= 0)
+			{
+				return open_entry(t3f_pack[i], entry);
+			}
+		}
+	}
+	if(!t3f_pack_fallback_interface)
+	{
+		return NULL;
+	}
+	fp = al_calloc(1, sizeof(T3F_PACK_FILE));
+	if(!fp)
+	{
+		return NULL;
+	}
+	fp->file = al_fopen_interface(t3f_pack_fallback_interface, path, mode);
+	if(!fp->file)
+	{
+		al_free(fp);
+		return NULL;
+	}
+	return fp;
+}
+
+static bool pack_fclose(ALLEGRO_FILE * f)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+	bool ret = true;
+
+	if(fp->file)
+	{
+		ret = al_fclose(fp->file);
+	}
+	if(fp->buffer)
+	{
+		al_free(fp->buffer);
+	}
+	al_free(fp);
+	return ret;
+}
+
+static size_t pack_fread(ALLEGRO_FILE * f, void * ptr, size_t size)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+	int64_t left;
+
+	if(fp->file)
+	{
+		return al_fread(fp->file, ptr, size);
+	}
+	left = fp->size - fp->pos;
+	if((int64_t)size > left)
+	{
+		size = left > 0 ? left : 0;
+		fp->eof = true;
+	}
+	memcpy(ptr, fp->data + fp->pos, size);
+	fp->pos += size;
+	return size;
+}
+
+static size_t pack_fwrite(ALLEGRO_FILE * f, const void * ptr, size_t size)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+
+	if(fp->file)
+	{
+		return al_fwrite(fp->file, ptr, size);
+	}
+	return 0;
+}
+
+static bool pack_fflush(ALLEGRO_FILE * f)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+
+	if(fp->file)
+	{
+		return al_fflush(fp->file);
+	}
+	return true;
+}
+
+static int64_t pack_ftell(ALLEGRO_FILE * f)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+
+	if(fp->file)
+	{
+		return al_ftell(fp->file);
+	}
+	return fp->pos;
+}
+
+static bool pack_fseek(ALLEGRO_FILE * f, int64_t offset, int whence)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+	int64_t pos;
+
+	if(fp->file)
+	{
+		return al_fseek(fp->file, offset, whence);
+	}
+	switch(whence)
+	{
+		case ALLEGRO_SEEK_SET:
+		{
+			pos = offset;
+			break;
+		}
+		case ALLEGRO_SEEK_CUR:
+		{
+			pos = fp->pos + offset;
+			break;
+		}
+		case ALLEGRO_SEEK_END:
+		{
+			pos = fp->size + offset;
+			break;
+		}
+		default:
+		{
+			return false;
+		}
+	}
+	if(pos < 0 || pos > fp->size)
+	{
+		return false;
+	}
+	fp->pos = pos;
+	fp->eof = false;
+	return true;
+}
+
+static bool pack_feof(ALLEGRO_FILE * f)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+
+	if(fp->file)
+	{
+		return al_feof(fp->file);
+	}
+	return fp->eof;
+}
+
+static int pack_ferror(ALLEGRO_FILE * f)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+
+	if(fp->file)
+	{
+		return al_ferror(fp->file);
+	}
+	return 0;
+}
+
+static const char * pack_ferrmsg(ALLEGRO_FILE * f)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+
+	if(fp->file)
+	{
+		return al_ferrmsg(fp->file);
+	}
+	return "";
+}
+
+static void pack_fclearerr(ALLEGRO_FILE * f)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+
+	if(fp->file)
+	{
+		al_fclearerr(fp->file);
+	}
+	fp->eof = false;
+}
+
+static int pack_fungetc(ALLEGRO_FILE * f, int c)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+
+	if(fp->file)
+	{
+		return al_fungetc(fp->file, c);
+	}
+	if(fp->pos <= 0)
+	{
+		return EOF;
+	}
+	fp->pos--;
+	fp->eof = false;
+	return (unsigned char)c;
+}
+
+static off_t pack_fsize(ALLEGRO_FILE * f)
+{
+	T3F_PACK_FILE * fp = al_get_file_userdata(f);
+
+	if(fp->file)
+	{
+		return al_fsize(fp->file);
+	}
+	return fp->size;
+}
+
+static const ALLEGRO_FILE_INTERFACE t3f_pack_file_interface =
+{
+	pack_fopen,
+	pack_fclose,
+	pack_fread,
+	pack_fwrite,
+	pack_fflush,
+	pack_ftell,
+	pack_fseek,
+	pack_feof,
+	pack_ferror,
+	pack_ferrmsg,
+	pack_fclearerr,
+	pack_fungetc,
+	pack_fsize
+};
@@ -0,0 +1,62 @@
+#ifndef T3F_PACK_H
+#define T3F_PACK_H
+
+#include <allegro5/allegro5.h>
+
+/* pack file layout, all values little endian
+
+   header   T3F_PACK_HEADER_SIZE bytes
+   buckets  bucket_count 32-bit entry numbers (index + 1, 0 is empty)
+   entries  entry_count records of T3F_PACK_ENTRY_SIZE bytes
+   names    NUL terminated entry names
+   data     entry data, each entry starts on an alignment boundary
+
+   buckets are found with t3f_pack_hash() and linear probing, bucket_count is
+   always a power of two */
+#define T3F_PACK_MAGIC             "T3FP"
+#define T3F_PACK_VERSION                1
+#define T3F_PACK_HEADER_SIZE           32
+#define T3F_PACK_ENTRY_SIZE            40
+#define T3F_PACK_DEFAULT_ALIGNMENT     16
+
+#define T3F_PACK_ENTRY_DEFLATE          1
+
+#define T3F_MAX_PACKS                   8
+
+/* header field offsets */
+#define T3F_PACK_HEADER_VERSION         4
+#define T3F_PACK_HEADER_ENTRIES         8
+#define T3F_PACK_HEADER_BUCKETS        12
+#define T3F_PACK_HEADER_ALIGNMENT      16
+#define T3F_PACK_HEADER_TOC_SIZE       20
+
+/* entry field offsets */
+#define T3F_PACK_ENTRY_HASH             0
+#define T3F_PACK_ENTRY_NAME             4
+#define T3F_PACK_ENTRY_NAME_LENGTH      8
+#define T3F_PACK_ENTRY_FLAGS           12
+#define T3F_PACK_ENTRY_OFFSET          16
+#define T3F_PACK_ENTRY_STORED_SIZE     24
+#define T3F_PACK_ENTRY_DATA_SIZE       32
+
+typedef struct T3F_PACK T3F_PACK;
+
+uint32_t t3f_pack_hash(const char * name);
+
+T3F_PACK * t3f_open_pack(const char * fn);
+void t3f_close_pack(T3F_PACK * pp);
+int t3f_get_pack_entries(T3F_PACK * pp);
+int t3f_find_pack_entry(T3F_PACK * pp, const char * name);
+const char * t3f_get_pack_entry_name(T3F_PACK * pp, int entry);
+uint64_t t3f_get_pack_entry_size(T3F_PACK * pp, int entry);
+const void * t3f_get_pack_entry_data(T3F_PACK * pp, int entry);
+ALLEGRO_FILE * t3f_open_pack_entry(T3F_PACK * pp, int entry);
+
+/* mounted packs are searched newest first by the pack file interface, which
+   falls back to the interface that was in use before the first mount */
+bool t3f_mount_pack(const char * fn);
+void t3f_unmount_packs(void);
+const ALLEGRO_FILE_INTERFACE * t3f_get_pack_file_interface(void);
+bool t3f_get_packed_file_info(const char * fn, uint64_t * size, time_t * mtime);
+
+#endif
@@ -0,0 +1,160 @@
+#include "t3f.h"
+#include "pool.h"
+
+/* pools are not thread safe, each one belongs to the asset that created it */
+
+typedef struct T3F_POOL_SLAB T3F_POOL_SLAB;
+
+struct T3F_POOL_SLAB
+{
+
+	T3F_POOL_SLAB * next;
+	char * data;
+	int objects;
+	int used;      // objects handed out so far, the rest have never been touched
+
+};
+
+typedef struct T3F_POOL_FREE T3F_POOL_FREE;
+
+struct T3F_POOL_FREE
+{
+
+	T3F_POOL_FREE * next;
+
+};
+
+struct T3F_POOL
+{
+
+	size_t object_size;
+	int slab_objects;
+	T3F_POOL_SLAB * slab;       // newest first, only the newest has unused space
+	T3F_POOL_FREE * free_list;  // objects given back with t3f_pool_free()
+	int count;
+
+};
+
+/* the slab header is padded so the first object is aligned */
+static size_t slab_header_size(void)
+{
+	return (sizeof(T3F_POOL_SLAB) + T3F_POOL_ALIGN - 1) & ~((size_t)T3F_POOL_ALIGN - 1);
+}
+
+T3F_POOL * t3f_create_pool(size_t object_size, int slab_objects)
+{
+	T3F_POOL * pp;
+
+	if(slab_objects < 1)
+	{
+		return NULL;
+	}
+	pp = al_malloc(sizeof(T3F_POOL));
+	if(!pp)
+	{
+		return NULL;
+	}
+	if(object_size < sizeof(T3F_POOL_FREE))
+	{
+		object_size = sizeof(T3F_POOL_FREE);
+	}
+	pp->object_size = (object_size + T3F_POOL_ALIGN - 1) & ~((size_t)T3F_POOL_ALIGN - 1);
+	pp->slab_objects = slab_objects;
+	pp->slab = NULL;
+	pp->free_list = NULL;
+	pp->count = 0;
+	return pp;
+}
+
+void t3f_destroy_pool(T3F_POOL * pp)
+{
+	T3F_POOL_SLAB * sp;
+
+	while(pp->slab)
+	{
+		sp = pp->slab;
+		pp->slab = sp->next;
+		al_free(sp);
+	}
+	al_free(pp);
+}
+
+static T3F_POOL_SLAB * add_slab(T3F_POOL * pp)
+{
+	T3F_POOL_SLAB * sp;
+
+	sp = al_malloc(slab_header_size() + pp->object_size * pp->slab_objects);
+	if(!sp)
+	{
+		return NULL;
+	}
+	sp->data = (char *)sp + slab_header_size();
+	sp->objects = pp->slab_objects;
+	sp->used = 0;
+	sp->next = pp->slab;
+	pp->slab = sp;
+	return sp;
+}
+
+/* objects are not cleared, callers initialize every field themselves */
+void * t3f_pool_alloc(T3F_POOL * pp)
+{
+	T3F_POOL_SLAB * sp = pp->slab;
+	T3F_POOL_FREE * fp;
+
+	if(pp->free_list)
+	{
+		fp = pp->free_list;
+		pp->free_list = fp->next;
+		pp->count++;
+		return fp;
+	}
+	if(!sp || sp->used >= sp->objects)
+	{
+		sp = add_slab(pp);
+		if(!sp)
+		{
+			return NULL;
+		}
+	}
+	sp->used++;
+	pp->count++;
+	return sp->data + pp->object_size * (sp->used - 1);
+}
+
+void t3f_pool_free(T3F_POOL * pp, void * p)
+{
+	T3F_POOL_FREE * fp = p;
+
+	if(!p)
+	{
+		return;
+	}
+	fp->next = pp->free_list;
+	pp->free_list = fp;
+	pp->count--;
+}
+
+/* lets owners tell pooled objects apart from ones the user put in by hand */
+bool t3f_pool_owns(T3F_POOL * pp, void * p)
+{
+	T3F_POOL_SLAB * sp;
+
+	if(!pp)
+	{
+		return false;
+	}
+	for(sp = pp->slab; sp; sp = sp->next)
+	{
+		if((char *)p >= sp->data && (char *)p < sp->data + pp->object_size * sp->objects)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int t3f_get_pool_count(T3F_POOL * pp)
+{
+	return pp->count;
+}
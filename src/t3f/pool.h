@@ -0,0 +1,21 @@
+#ifndef T3F_POOL_H
+#define T3F_POOL_H
+
+#include <allegro5/allegro5.h>
+
+#define T3F_POOL_ALIGN 16
+
+/* fixed size object pool, objects are carved out of large slabs so objects
+   of one kind sit next to each other and allocating or freeing one is O(1),
+   destroying the pool releases every object allocated from it at once */
+typedef struct T3F_POOL T3F_POOL;
+
+T3F_POOL * t3f_create_pool(size_t object_size, int slab_objects);
+void t3f_destroy_pool(T3F_POOL * pp);
+
+void * t3f_pool_alloc(T3F_POOL * pp);
+void t3f_pool_free(T3F_POOL * pp, void * p);
+bool t3f_pool_owns(T3F_POOL * pp, void * p);
+int t3f_get_pool_count(T3F_POOL * pp);
+
+#endif
@@ -0,0 +1,277 @@
+#include "t3f.h"
+#include "profile.h"
+
+#define _T3F_PROFILE_MAX_DEPTH 8
+
+typedef struct
+{
+
+	int phase;
+	double start;
+	double child; // time spent in nested phases
+
+} T3F_PROFILE_ENTRY;
+
+bool t3f_profiler_enabled = false;
+bool t3f_profiler_overlay = false;
+static T3F_PROFILE_PHASE t3f_profile_phase[T3F_PROFILE_PHASES];
+static char t3f_profile_dump_fn[1024] = {0};
+static ALLEGRO_FONT * t3f_profile_font = NULL;
+static const char * t3f_profile_phase_name[T3F_PROFILE_PHASES] = {"events", "logic", "render", "flip"};
+
+/* phases can nest (logic runs inside event handling) so each thread keeps a
+   stack and a phase is only charged for its own time */
+static T3F_THREAD_LOCAL T3F_PROFILE_ENTRY t3f_profile_stack[_T3F_PROFILE_MAX_DEPTH];
+static T3F_THREAD_LOCAL int t3f_profile_depth = 0;
+
+static int get_bucket(double t)
+{
+	double us = t * 1000000.0;
+	int b;
+
+	if(us <= 1.0)
+	{
+		return 0;
+	}
+	b = log2(us) * 4.0;
+	if(b >= T3F_PROFILE_BUCKETS)
+	{
+		b = T3F_PROFILE_BUCKETS - 1;
+	}
+	return b;
+}
+
+/* lower edge of a bucket in seconds */
+static double get_bucket_start(int b)
+{
+	if(b <= 0)
+	{
+		return 0.0;
+	}
+	return pow(2.0, (double)b / 4.0) / 1000000.0;
+}
+
+static void record_sample(T3F_PROFILE_PHASE * pp, double t)
+{
+	int i = pp->samples % T3F_PROFILE_HISTORY;
+
+	if(pp->samples >= T3F_PROFILE_HISTORY)
+	{
+		pp->bucket_count[get_bucket(pp->sample[i])]--;
+		pp->sum -= pp->sample[i];
+	}
+	pp->sample[i] = t;
+	pp->bucket_count[get_bucket(t)]++;
+	pp->sum += t;
+	pp->samples++;
+}
+
+void t3f_enable_profiler(bool enable, bool overlay)
+{
+	t3f_profiler_enabled = enable;
+	t3f_profiler_overlay = enable && overlay;
+}
+
+/* write the profile out when T3F shuts down, .json files get JSON and
+   anything else gets CSV */
+bool t3f_set_profile_dump(const char * fn)
+{
+	if(!fn)
+	{
+		t3f_profile_dump_fn[0] = 0;
+		return true;
+	}
+	if(strlen(fn) >= sizeof(t3f_profile_dump_fn))
+	{
+		return false;
+	}
+	strcpy(t3f_profile_dump_fn, fn);
+	return true;
+}
+
+void t3f_reset_profiler(void)
+{
+	memset(t3f_profile_phase, 0, sizeof(t3f_profile_phase));
+}
+
+void t3f_shutdown_profiler(void)
+{
+	if(t3f_profile_dump_fn[0])
+	{
+		t3f_dump_profile(t3f_profile_dump_fn);
+	}
+	if(t3f_profile_font)
+	{
+		al_destroy_font(t3f_profile_font);
+		t3f_profile_font = NULL;
+	}
+	t3f_profiler_enabled = false;
+	t3f_profiler_overlay = false;
+}
+
+void t3f_profile_begin(int phase)
+{
+	if(t3f_profile_depth < _T3F_PROFILE_MAX_DEPTH)
+	{
+		t3f_profile_stack[t3f_profile_depth].phase = phase;
+		t3f_profile_stack[t3f_profile_depth].start = al_get_time();
+		t3f_profile_stack[t3f_profile_depth].child = 0.0;
+	}
+	t3f_profile_depth++;
+}
+
+void t3f_profile_end(int phase)
+{
+	T3F_PROFILE_ENTRY * ep;
+	double elapsed;
+
+	if(t3f_profile_depth <= 0)
+	{
+		return;
+	}
+	t3f_profile_depth--;
+	if(t3f_profile_depth >= _T3F_PROFILE_MAX_DEPTH)
+	{
+		return;
+	}
+	ep = &t3f_profile_stack[t3f_profile_depth];
+	if(ep->phase != phase)
+	{
+		return;
+	}
+	elapsed = al_get_time() - ep->start;
+	record_sample(&t3f_profile_phase[phase], elapsed - ep->child);
+	if(t3f_profile_depth > 0 && t3f_profile_depth <= _T3F_PROFILE_MAX_DEPTH)
+	{
+		t3f_profile_stack[t3f_profile_depth - 1].child += elapsed;
+	}
+}
+
+const char * t3f_get_profile_phase_name(int phase)
+{
+	return t3f_profile_phase_name[phase];
+}
+
+int t3f_get_profile_samples(int phase)
+{
+	unsigned long samples = t3f_profile_phase[phase].samples;
+
+	return samples < T3F_PROFILE_HISTORY ? samples : T3F_PROFILE_HISTORY;
+}
+
+/* times are in seconds */
+double t3f_get_profile_mean(int phase)
+{
+	int samples = t3f_get_profile_samples(phase);
+
+	if(samples <= 0)
+	{
+		return 0.0;
+	}
+	return t3f_profile_phase[phase].sum / (double)samples;
+}
+
+/* read from the histogram, interpolating within the bucket */
+double t3f_get_profile_percentile(int phase, double percentile)
+{
+	T3F_PROFILE_PHASE * pp = &t3f_profile_phase[phase];
+	int samples = t3f_get_profile_samples(phase);
+	double target, start, end;
+	int count = 0;
+	int i;
+
+	if(samples <= 0)
+	{
+		return 0.0;
+	}
+	target = percentile / 100.0 * (double)samples;
+	for(i = 0; i < T3F_PROFILE_BUCKETS; i++)
+	{
+		if(pp->bucket_count[i] > 0 && count + pp->bucket_count[i] >= target)
+		{
+			start = get_bucket_start(i);
+			end = get_bucket_start(i + 1);
+			return start + (end - start) * (target - count) / (double)pp->bucket_count[i];
+		}
+		count += pp->bucket_count[i];
+	}
+	return get_bucket_start(T3F_PROFILE_BUCKETS);
+}
+
+/* drawn in display pixels over whatever the render proc drew */
+void t3f_draw_profiler_overlay(void)
+{
+	ALLEGRO_TRANSFORM identity;
+	ALLEGRO_TRANSFORM old_transform;
+	ALLEGRO_COLOR color = al_map_rgba_f(1.0, 1.0, 1.0, 1.0);
+	int cx, cy, cw, ch;
+	int h, i;
+
+	if(!t3f_profile_font)
+	{
+		t3f_profile_font = al_create_builtin_font();
+		if(!t3f_profile_font)
+		{
+			return;
+		}
+	}
+	h = al_get_font_line_height(t3f_profile_font);
+	al_copy_transform(&old_transform, al_get_current_transform());
+	al_get_clipping_rectangle(&cx, &cy, &cw, &ch);
+	al_identity_transform(&identity);
+	al_use_transform(&identity);
+	al_set_clipping_rectangle(0, 0, al_get_bitmap_width(al_get_target_bitmap()), al_get_bitmap_height(al_get_target_bitmap()));
+	al_draw_filled_rectangle(0, 0, 40 * 8 + 4, h * (T3F_PROFILE_PHASES + 1) + 4, al_map_rgba_f(0.0, 0.0, 0.0, 0.75));
+	al_draw_textf(t3f_profile_font, color, 2, 2, 0, "%-8s %9s %9s %9s", "ms", "p50", "p95", "p99");
+	for(i = 0; i < T3F_PROFILE_PHASES; i++)
+	{
+		al_draw_textf(t3f_profile_font, color, 2, 2 + h * (i + 1), 0, "%-8s %9.3f %9.3f %9.3f", t3f_profile_phase_name[i], t3f_get_profile_percentile(i, 50.0) * 1000.0, t3f_get_profile_percentile(i, 95.0) * 1000.0, t3f_get_profile_percentile(i, 99.0) * 1000.0);
+	}
+	al_set_clipping_rectangle(cx, cy, cw, ch);
+	al_use_transform(&old_transform);
+}
+
+static bool is_json_filename(const char * fn)
+{
+	const char * ext = strrchr(fn, '.');
+
+	return ext && !strcasecmp(ext, ".json");
+}
+
+bool t3f_dump_profile(const char * fn)
+{
+	FILE * fp;
+	bool json = is_json_filename(fn);
+	int i;
+
+	fp = fopen(fn, "w");
+	if(!fp)
+	{
+		return false;
+	}
+	if(json)
+	{
+		fprintf(fp, "[\n");
+	}
+	else
+	{
+		fprintf(fp, "phase,samples,mean_ms,p50_ms,p95_ms,p99_ms\n");
+	}
+	for(i = 0; i < T3F_PROFILE_PHASES; i++)
+	{
+		if(json)
+		{
+			fprintf(fp, "\t{\"phase\": \"%s\", \"samples\": %d, \"mean_ms\": %f, \"p50_ms\": %f, \"p95_ms\": %f, \"p99_ms\": %f}%s\n", t3f_profile_phase_name[i], t3f_get_profile_samples(i), t3f_get_profile_mean(i) * 1000.0, t3f_get_profile_percentile(i, 50.0) * 1000.0, t3f_get_profile_percentile(i, 95.0) * 1000.0, t3f_get_profile_percentile(i, 99.0) * 1000.0, i < T3F_PROFILE_PHASES - 1 ? "," : "");
+		}
+		else
+		{
+			fprintf(fp, "%s,%d,%f,%f,%f,%f\n", t3f_profile_phase_name[i], t3f_get_profile_samples(i), t3f_get_profile_mean(i) * 1000.0, t3f_get_profile_percentile(i, 50.0) * 1000.0, t3f_get_profile_percentile(i, 95.0) * 1000.0, t3f_get_profile_percentile(i, 99.0) * 1000.0);
+		}
+	}
+	if(json)
+	{
+		fprintf(fp, "]\n");
+	}
+	fclose(fp);
+	return true;
+}
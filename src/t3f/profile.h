@@ -0,0 +1,51 @@
+#ifndef T3F_PROFILE_H
+#define T3F_PROFILE_H
+
+#include <allegro5/allegro5.h>
+
+/* phases of a frame timed by t3f_run() */
+#define T3F_PROFILE_EVENTS   0 // event handling, not including logic
+#define T3F_PROFILE_LOGIC    1
+#define T3F_PROFILE_RENDER   2
+#define T3F_PROFILE_FLIP     3
+#define T3F_PROFILE_PHASES   4
+
+#define T3F_PROFILE_HISTORY  1024 // samples kept per phase
+#define T3F_PROFILE_BUCKETS    96 // histogram buckets, four per doubling from 1us
+
+/* each phase is only recorded from one thread, readers on other threads may
+   see a sample or two out of date */
+typedef struct
+{
+
+	double sample[T3F_PROFILE_HISTORY];
+	int bucket_count[T3F_PROFILE_BUCKETS];
+	volatile unsigned long samples; // total recorded, the ring holds the last T3F_PROFILE_HISTORY
+	double sum;
+
+} T3F_PROFILE_PHASE;
+
+extern bool t3f_profiler_enabled;
+extern bool t3f_profiler_overlay;
+
+/* cost is a single test of a global when the profiler is off */
+#define T3F_PROFILE_BEGIN(phase) do { if(t3f_profiler_enabled) { t3f_profile_begin(phase); } } while(0)
+#define T3F_PROFILE_END(phase) do { if(t3f_profiler_enabled) { t3f_profile_end(phase); } } while(0)
+
+void t3f_enable_profiler(bool enable, bool overlay);
+bool t3f_set_profile_dump(const char * fn);
+void t3f_reset_profiler(void);
+void t3f_shutdown_profiler(void);
+
+void t3f_profile_begin(int phase);
+void t3f_profile_end(int phase);
+
+const char * t3f_get_profile_phase_name(int phase);
+int t3f_get_profile_samples(int phase);
+double t3f_get_profile_mean(int phase);
+double t3f_get_profile_percentile(int phase, double percentile);
+
+void t3f_draw_profiler_overlay(void);
+bool t3f_dump_profile(const char * fn);
+
+#endif
@@ -1,9 +1,95 @@
 #include "t3f.h"
 #include "resource.h"
 
-static T3F_RESOURCE * t3f_resource[T3F_MAX_RESOURCES] = {NULL};
+/* resources live in slots that are reused through a free list, a hash table
+   keyed by the resource pointer finds the slot for the pointer based API
+
+   callers are allowed to swap *ptr behind our back (atlases replace bitmaps
+   with sub-bitmaps), so the table is only a hint: every hit is checked
+   against *ptr and a miss resyncs the stale keys before giving up
+
+   t3f_load_shared_resource() shares an object that was already loaded the
+   same way (same handler, file, offset, option and flags) instead of decoding
+   it again, resources sharing an object are linked in a ring and the object
+   is only destroyed when the last of them goes, a second hash table keyed by
+   the load parameters finds the ring to join, plain loads always get their
+   own object and are never shared
+
+   after the display is lost bitmaps are decoded again into memory bitmaps by
+   the job system, highest priority first, and uploaded on the main thread,
+   resources with a negative priority are left to finish over the next logic
+   ticks so the game can carry on before everything is back */
+
+#define _T3F_RESOURCE_MIN_SLOTS 64
+#define _T3F_RESOURCE_MIN_TABLE 128
+#define _T3F_RESOURCE_MAX_GENERATION ((1 << (32 - T3F_RESOURCE_HANDLE_INDEX_BITS)) - 1)
+
+typedef struct
+{
+
+	T3F_RESOURCE * resource;
+	unsigned int generation;
+	int next_free;
+
+} T3F_RESOURCE_SLOT;
+
+typedef struct
+{
+
+	void * key;
+	int slot;
+
+} T3F_RESOURCE_KEY;
+
+static T3F_RESOURCE_SLOT * t3f_resource_slot = NULL;
+static int t3f_resource_slots = 0;      // slots ever used, iteration stops here
+static int t3f_resource_slot_space = 0;
+static int t3f_resource_free_slot = -1;
 static int t3f_resources = 0;
 
+static T3F_RESOURCE_KEY * t3f_resource_table = NULL;
+static unsigned long t3f_resource_table_size = 0; // always a power of two
+static unsigned long t3f_resource_keys = 0;
+
+/* detached slots whose owner is about to change *ptr, reindexed on the next
+   lookup that misses */
+static int * t3f_resource_stale = NULL;
+static int t3f_resource_stales = 0;
+static int t3f_resource_stale_space = 0;
+static bool t3f_resource_resync = false; // couldn't track one, check them all
+
+/* holds slot + 1 of one resource from each ring */
+static int * t3f_resource_cache = NULL;
+static unsigned long t3f_resource_cache_size = 0; // always a power of two
+static unsigned long t3f_resource_cached = 0;
+
+#define _T3F_RECOVERY_WAITING  0
+#define _T3F_RECOVERY_CLAIMED  1
+#define _T3F_RECOVERY_DECODED  2
+#define _T3F_RECOVERY_FINISHED 3
+
+typedef struct
+{
+
+	T3F_RESOURCE * resource; // first resource of the ring
+	int priority;
+	bool main_thread;        // the handler needs the display
+	void * result;
+	int state;
+
+} T3F_RESOURCE_RECOVERY;
+
+static T3F_RESOURCE_RECOVERY * t3f_recovery = NULL;
+static int t3f_recoveries = 0;
+static int t3f_recovery_next = 0;     // where workers look for work
+static int t3f_recovery_finished = 0; // everything before this is finished
+static ALLEGRO_MUTEX * t3f_recovery_mutex = NULL;
+static ALLEGRO_COND * t3f_recovery_cond = NULL;
+static T3F_JOB_COUNTER * t3f_recovery_counter = NULL;
+static bool t3f_keep_packed = false;
+
+static void finish_recovery(double max_time, bool deferred);
+
 bool t3f_bitmap_resource_handler_proc(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy)
 {
 	ALLEGRO_BITMAP * bitmap = (ALLEGRO_BITMAP *)*ptr;
@@ -100,164 +186,1242 @@ bool t3f_font_resource_handler_proc(void ** ptr, ALLEGRO_FILE * fp, const char *
 	return *ptr;
 }
 
-static bool t3f_add_resource(bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), void ** ptr, const char * filename, int option, int flags, unsigned long offset, const ALLEGRO_FILE_INTERFACE * fi)
+static unsigned long hash_pointer(const void * p)
+{
+	uintptr_t v = (uintptr_t)p;
+
+	v ^= v >> 16;
+	v *= 0x45d9f3b;
+	v ^= v >> 16;
+	return v;
+}
+
+static void insert_key(T3F_RESOURCE_KEY * table, unsigned long size, void * key, int slot)
+{
+	unsigned long i;
+
+	for(i = hash_pointer(key) & (size - 1); table[i].key; i = (i + 1) & (size - 1));
+	table[i].key = key;
+	table[i].slot = slot;
+}
+
+/* keep the table at most half full */
+static bool grow_table(void)
 {
-	if(t3f_resources < T3F_MAX_RESOURCES)
+	T3F_RESOURCE_KEY * new_table;
+	unsigned long new_size;
+	unsigned long i;
+
+	if(t3f_resource_table && (t3f_resource_keys + 1) * 2 <= t3f_resource_table_size)
 	{
-		t3f_resource[t3f_resources] = al_malloc(sizeof(T3F_RESOURCE));
-		if(t3f_resource[t3f_resources])
+		return true;
+	}
+	new_size = t3f_resource_table_size ? t3f_resource_table_size * 2 : _T3F_RESOURCE_MIN_TABLE;
+	new_table = al_calloc(new_size, sizeof(T3F_RESOURCE_KEY));
+	if(!new_table)
+	{
+		return false;
+	}
+	for(i = 0; i < t3f_resource_table_size; i++)
+	{
+		if(t3f_resource_table[i].key)
 		{
-			t3f_resource[t3f_resources]->proc = proc;
-			t3f_resource[t3f_resources]->ptr = ptr;
-			strcpy(t3f_resource[t3f_resources]->filename, filename);
-			t3f_resource[t3f_resources]->offset = offset;
-			t3f_resource[t3f_resources]->option = option;
-			t3f_resource[t3f_resources]->flags = flags;
-			t3f_resource[t3f_resources]->fi = fi;
-			t3f_resources++;
-			return true;
+			insert_key(new_table, new_size, t3f_resource_table[i].key, t3f_resource_table[i].slot);
 		}
 	}
-	return false;
+	al_free(t3f_resource_table);
+	t3f_resource_table = new_table;
+	t3f_resource_table_size = new_size;
+	return true;
 }
 
-void t3f_remove_resource(int i)
+/* shift following entries back so lookups never need tombstones */
+static void remove_key(unsigned long i)
 {
-	int j;
+	unsigned long mask = t3f_resource_table_size - 1;
+	unsigned long j = i;
+	unsigned long k;
 
-	al_free(t3f_resource[i]);
-	for(j = i; j < t3f_resources - 1; j++)
+	while(1)
 	{
-		t3f_resource[j] = t3f_resource[j + 1];
+		j = (j + 1) & mask;
+		if(!t3f_resource_table[j].key)
+		{
+			break;
+		}
+		k = hash_pointer(t3f_resource_table[j].key) & mask;
+		if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+		{
+			continue;
+		}
+		t3f_resource_table[i] = t3f_resource_table[j];
+		i = j;
 	}
-	t3f_resources--;
+	t3f_resource_table[i].key = NULL;
+	t3f_resource_keys--;
 }
 
-void * t3f_load_resource(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), const char * filename, int option, int flags, unsigned long offset)
+static void unindex_resource(int slot)
 {
-	if(proc)
+	T3F_RESOURCE * rp = t3f_resource_slot[slot].resource;
+	unsigned long mask = t3f_resource_table_size - 1;
+	unsigned long i;
+
+	if(!rp->key)
 	{
-		proc(ptr, NULL, filename, option, flags, offset, false);
-		if(*ptr)
+		return;
+	}
+	for(i = hash_pointer(rp->key) & mask; t3f_resource_table[i].key; i = (i + 1) & mask)
+	{
+		if(t3f_resource_table[i].key == rp->key && t3f_resource_table[i].slot == slot)
 		{
-			t3f_add_resource(proc, ptr, filename, option, flags, offset, al_get_new_file_interface());
+			remove_key(i);
+			break;
 		}
 	}
-	return *ptr;
+	rp->key = NULL;
 }
 
-void * t3f_load_resource_f(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), ALLEGRO_FILE * fp, const char * filename, int option, int flags)
+/* unloaded resources have a NULL *ptr and stay out of the table */
+static void index_resource(int slot)
 {
-	unsigned long offset;
-	if(proc)
+	T3F_RESOURCE * rp = t3f_resource_slot[slot].resource;
+
+	unindex_resource(slot);
+	if(*rp->ptr && grow_table())
+	{
+		insert_key(t3f_resource_table, t3f_resource_table_size, *rp->ptr, slot);
+		t3f_resource_keys++;
+		rp->key = *rp->ptr;
+	}
+}
+
+/* pass ptr to find that particular resource, NULL for any holding value */
+static int lookup_resource(void * value, void ** ptr)
+{
+	unsigned long mask = t3f_resource_table_size - 1;
+	unsigned long i;
+	T3F_RESOURCE * rp;
+
+	if(!t3f_resource_table)
+	{
+		return -1;
+	}
+	for(i = hash_pointer(value) & mask; t3f_resource_table[i].key; i = (i + 1) & mask)
 	{
-		offset = al_ftell(fp);
-		proc(ptr, fp, filename, option, flags, offset, false);
-		if(*ptr)
+		rp = t3f_resource_slot[t3f_resource_table[i].slot].resource;
+		if(t3f_resource_table[i].key == value && *rp->ptr == value && (!ptr || rp->ptr == ptr))
 		{
-			t3f_add_resource(proc, ptr, filename, option, flags, offset, al_get_new_file_interface());
+			return t3f_resource_table[i].slot;
 		}
 	}
-	return *ptr;
+	return -1;
 }
 
-static void t3f_actually_unload_resource(int i)
+static void mark_resource_stale(int slot)
 {
-	if(t3f_resource[i]->proc)
+	int * new_stale;
+	int new_space;
+
+	if(t3f_resource_stales >= t3f_resource_stale_space)
 	{
-		t3f_resource[i]->proc(t3f_resource[i]->ptr, NULL, NULL, 0, 0, 0, true);
-		*t3f_resource[i]->ptr = NULL;
+		new_space = t3f_resource_stale_space ? t3f_resource_stale_space * 2 : 16;
+		new_stale = al_realloc(t3f_resource_stale, new_space * sizeof(int));
+		if(!new_stale)
+		{
+			t3f_resource_resync = true;
+			return;
+		}
+		t3f_resource_stale = new_stale;
+		t3f_resource_stale_space = new_space;
 	}
+	t3f_resource_stale[t3f_resource_stales] = slot;
+	t3f_resource_stales++;
 }
 
-int t3f_unload_resource(void * ptr)
+static int find_resource(void * value, void ** ptr)
 {
-	int i;
+	int i, slot;
 
-	for(i = 0; i < t3f_resources; i++)
+	/* unloaded resources aren't indexed */
+	if(!value)
 	{
-		if(*t3f_resource[i]->ptr == ptr)
+		for(i = 0; ptr && i < t3f_resource_slots; i++)
 		{
-			t3f_actually_unload_resource(i);
-			return i;
+			if(t3f_resource_slot[i].resource && t3f_resource_slot[i].resource->ptr == ptr)
+			{
+				return i;
+			}
 		}
+		return -1;
 	}
-	return -1;
+	slot = lookup_resource(value, ptr);
+	if(slot >= 0)
+	{
+		return slot;
+	}
+
+	/* everything else keeps the table up to date itself, only detached
+	   pointers may have changed since they were indexed */
+	if(!t3f_resource_stales && !t3f_resource_resync)
+	{
+		return -1;
+	}
+	if(t3f_resource_resync)
+	{
+		for(i = 0; i < t3f_resource_slots; i++)
+		{
+			if(t3f_resource_slot[i].resource && t3f_resource_slot[i].resource->key != *t3f_resource_slot[i].resource->ptr)
+			{
+				index_resource(i);
+			}
+		}
+		t3f_resource_resync = false;
+	}
+	for(i = 0; i < t3f_resource_stales; i++)
+	{
+		slot = t3f_resource_stale[i];
+		if(t3f_resource_slot[slot].resource)
+		{
+			index_resource(slot);
+		}
+	}
+	t3f_resource_stales = 0;
+	return lookup_resource(value, ptr);
 }
 
-bool t3f_destroy_resource(void * ptr)
+static unsigned long hash_load(bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), const char * filename, int option, int flags, unsigned long offset, const ALLEGRO_FILE_INTERFACE * fi)
 {
+	unsigned long h = 5381;
 	int i;
 
-	i = t3f_unload_resource(ptr);
-	if(i >= 0)
+	for(i = 0; filename[i]; i++)
+	{
+		h = h * 33 + (unsigned char)filename[i];
+	}
+	h ^= hash_pointer((void *)proc) ^ (hash_pointer(fi) * 31);
+	h ^= (offset + option * 2654435761u + flags * 40503u) * 2654435761u;
+	return h;
+}
+
+static void insert_cache(int * table, unsigned long size, int slot)
+{
+	unsigned long i;
+
+	for(i = t3f_resource_slot[slot].resource->cache_hash & (size - 1); table[i]; i = (i + 1) & (size - 1));
+	table[i] = slot + 1;
+}
+
+static bool grow_cache(void)
+{
+	int * new_cache;
+	unsigned long new_size;
+	unsigned long i;
+
+	if(t3f_resource_cache && (t3f_resource_cached + 1) * 2 <= t3f_resource_cache_size)
 	{
-		t3f_remove_resource(i);
 		return true;
 	}
-	return false;
+	new_size = t3f_resource_cache_size ? t3f_resource_cache_size * 2 : _T3F_RESOURCE_MIN_TABLE;
+	new_cache = al_calloc(new_size, sizeof(int));
+	if(!new_cache)
+	{
+		return false;
+	}
+	for(i = 0; i < t3f_resource_cache_size; i++)
+	{
+		if(t3f_resource_cache[i])
+		{
+			insert_cache(new_cache, new_size, t3f_resource_cache[i] - 1);
+		}
+	}
+	al_free(t3f_resource_cache);
+	t3f_resource_cache = new_cache;
+	t3f_resource_cache_size = new_size;
+	return true;
 }
 
-void t3f_unload_resources(void)
+static void cache_resource(int slot)
 {
-	int i;
+	if(!t3f_resource_slot[slot].resource->cached && grow_cache())
+	{
+		insert_cache(t3f_resource_cache, t3f_resource_cache_size, slot);
+		t3f_resource_slot[slot].resource->cached = true;
+		t3f_resource_cached++;
+	}
+}
+
+static void uncache_resource(int slot)
+{
+	unsigned long mask = t3f_resource_cache_size - 1;
+	unsigned long i, j, k;
 
-	for(i = 0; i < t3f_resources; i++)
+	if(!t3f_resource_slot[slot].resource->cached)
 	{
-		if(*t3f_resource[i]->ptr)
+		return;
+	}
+	for(i = t3f_resource_slot[slot].resource->cache_hash & mask; t3f_resource_cache[i] != slot + 1; i = (i + 1) & mask);
+
+	/* shift following entries back, same as the pointer table */
+	j = i;
+	while(1)
+	{
+		j = (j + 1) & mask;
+		if(!t3f_resource_cache[j])
 		{
-			t3f_actually_unload_resource(i);
+			break;
+		}
+		k = t3f_resource_slot[t3f_resource_cache[j] - 1].resource->cache_hash & mask;
+		if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+		{
+			continue;
 		}
+		t3f_resource_cache[i] = t3f_resource_cache[j];
+		i = j;
 	}
+	t3f_resource_cache[i] = 0;
+	t3f_resource_slot[slot].resource->cached = false;
+	t3f_resource_cached--;
 }
 
-void t3f_reload_resources(void)
+/* find a loaded resource with the same load parameters */
+static int find_cached_resource(unsigned long hash, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), const char * filename, int option, int flags, unsigned long offset, const ALLEGRO_FILE_INTERFACE * fi)
 {
-	int i;
-	const ALLEGRO_FS_INTERFACE * old_fs;
+	unsigned long mask = t3f_resource_cache_size - 1;
+	unsigned long i;
+	T3F_RESOURCE * rp;
 
-	old_fs = al_get_fs_interface();
-	for(i = 0; i < t3f_resources; i++)
+	if(!t3f_resource_cache)
+	{
+		return -1;
+	}
+	for(i = hash & mask; t3f_resource_cache[i]; i = (i + 1) & mask)
 	{
-		if(t3f_resource[i]->proc)
+		rp = t3f_resource_slot[t3f_resource_cache[i] - 1].resource;
+		if(rp->cache_hash == hash && rp->proc == proc && rp->offset == offset && rp->option == option && rp->flags == flags && rp->fi == fi && !strcmp(rp->filename, filename))
 		{
-			al_set_new_file_interface(t3f_resource[i]->fi);
-			t3f_resource[i]->proc(t3f_resource[i]->ptr, NULL, t3f_resource[i]->filename, t3f_resource[i]->option, t3f_resource[i]->flags, t3f_resource[i]->offset, false);
+			/* don't hand out objects that were unloaded or swapped */
+			if(*rp->ptr && *rp->ptr == rp->key)
+			{
+				return t3f_resource_cache[i] - 1;
+			}
 		}
 	}
-	al_set_fs_interface(old_fs);
+	return -1;
 }
 
-void * t3f_clone_resource(void ** dest, void * ptr)
+static bool resource_shared(T3F_RESOURCE * rp)
 {
-	int i;
-	const ALLEGRO_FILE_INTERFACE * old_fi;
+	return rp->share_next != rp;
+}
+
+static void share_resource(int slot, int with)
+{
+	T3F_RESOURCE * rp = t3f_resource_slot[slot].resource;
+	T3F_RESOURCE * wp = t3f_resource_slot[with].resource;
+
+	rp->share_next = wp->share_next;
+	wp->share_next = rp;
+}
+
+/* take the resource out of its ring, the cache entry moves to the rest of
+   the ring if this resource held it */
+static void unshare_resource(int slot)
+{
+	T3F_RESOURCE * rp = t3f_resource_slot[slot].resource;
+	T3F_RESOURCE * prev;
+
+	if(!resource_shared(rp))
+	{
+		return;
+	}
+	for(prev = rp; prev->share_next != rp; prev = prev->share_next);
+	prev->share_next = rp->share_next;
+	rp->share_next = rp;
+	if(rp->cached)
+	{
+		uncache_resource(slot);
+		cache_resource(prev->slot);
+	}
+}
+
+static bool grow_slots(void)
+{
+	T3F_RESOURCE_SLOT * new_slot;
+	int new_space;
+
+	if(t3f_resource_slots < t3f_resource_slot_space)
+	{
+		return true;
+	}
+	new_space = t3f_resource_slot_space ? t3f_resource_slot_space * 2 : _T3F_RESOURCE_MIN_SLOTS;
+	if(new_space > (1 << T3F_RESOURCE_HANDLE_INDEX_BITS))
+	{
+		return false;
+	}
+	new_slot = al_realloc(t3f_resource_slot, new_space * sizeof(T3F_RESOURCE_SLOT));
+	if(!new_slot)
+	{
+		return false;
+	}
+	t3f_resource_slot = new_slot;
+	t3f_resource_slot_space = new_space;
+	return true;
+}
+
+/* track a resource that was loaded some other way, returns the slot it was
+   put in or -1 on failure */
+int t3f_add_resource(bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), void ** ptr, const char * filename, int option, int flags, unsigned long offset, const ALLEGRO_FILE_INTERFACE * fi)
+{
+	T3F_RESOURCE * rp;
+	int slot;
+
+	if(t3f_resource_free_slot < 0 && !grow_slots())
+	{
+		return -1;
+	}
+	rp = al_malloc(sizeof(T3F_RESOURCE));
+	if(!rp)
+	{
+		return -1;
+	}
+	rp->proc = proc;
+	rp->data = NULL;
+	rp->ptr = ptr ? ptr : &rp->data;
+	strcpy(rp->filename, filename);
+	rp->offset = offset;
+	rp->option = option;
+	rp->flags = flags;
+	rp->fi = fi;
+	rp->key = NULL;
+	rp->share_next = rp;
+	rp->size = 0;
+	rp->cache_hash = hash_load(proc, filename, option, flags, offset, fi);
+	rp->cached = false;
+	rp->priority = T3F_RESOURCE_PRIORITY_NORMAL;
+	rp->packed = NULL;
+	rp->packed_size = 0;
+
+	if(t3f_resource_free_slot >= 0)
+	{
+		slot = t3f_resource_free_slot;
+		t3f_resource_free_slot = t3f_resource_slot[slot].next_free;
+	}
+	else
+	{
+		slot = t3f_resource_slots;
+		t3f_resource_slot[slot].generation = 1;
+		t3f_resource_slots++;
+	}
+	rp->slot = slot;
+	t3f_resource_slot[slot].resource = rp;
+	t3f_resource_slot[slot].next_free = -1;
+	t3f_resources++;
+	index_resource(slot);
+	return slot;
+}
+
+void t3f_remove_resource(int i)
+{
+	/* workers may be reading it */
+	if(t3f_recovery)
+	{
+		finish_recovery(-1.0, true);
+	}
+	unindex_resource(i);
+	unshare_resource(i);
+	uncache_resource(i);
+	if(t3f_resource_slot[i].resource->packed)
+	{
+		al_free(t3f_resource_slot[i].resource->packed);
+	}
+	al_free(t3f_resource_slot[i].resource);
+	t3f_resource_slot[i].resource = NULL;
+	t3f_resource_slot[i].generation++;
+	if(t3f_resource_slot[i].generation > _T3F_RESOURCE_MAX_GENERATION)
+	{
+		t3f_resource_slot[i].generation = 1;
+	}
+	t3f_resource_slot[i].next_free = t3f_resource_free_slot;
+	t3f_resource_free_slot = i;
+	t3f_resources--;
+}
+
+/* keep the file data of a bitmap resource so it can be decoded again without
+   touching the disk */
+static void pack_resource(T3F_RESOURCE * rp, ALLEGRO_FILE * fp)
+{
+	ALLEGRO_FILE * rfp = fp;
+	int64_t pos = 0;
+	int64_t size;
 
-	for(i = 0; i < t3f_resources; i++)
+	if(fp)
+	{
+		pos = al_ftell(fp);
+		size = rp->size;
+		al_fseek(fp, rp->offset, ALLEGRO_SEEK_SET);
+	}
+	else if(rp->offset == 0)
+	{
+		rfp = al_fopen(rp->filename, "rb");
+		if(!rfp)
+		{
+			return;
+		}
+		size = al_fsize(rfp);
+	}
+	else
 	{
-		if(*t3f_resource[i]->ptr == ptr)
+		return;
+	}
+	if(size > 0)
+	{
+		rp->packed = al_malloc(size);
+		if(rp->packed)
 		{
-			old_fi = al_get_new_file_interface();
-			al_set_new_file_interface(t3f_resource[i]->fi);
-			t3f_resource[i]->proc(dest, NULL, t3f_resource[i]->filename, t3f_resource[i]->option, t3f_resource[i]->flags, t3f_resource[i]->offset, false);
-			if(*dest)
+			if(al_fread(rfp, rp->packed, size) == (size_t)size)
 			{
-				t3f_add_resource(t3f_resource[i]->proc, dest, t3f_resource[i]->filename, t3f_resource[i]->option, t3f_resource[i]->flags, t3f_resource[i]->offset, al_get_new_file_interface());
+				rp->packed_size = size;
+			}
+			else
+			{
+				al_free(rp->packed);
+				rp->packed = NULL;
 			}
-			al_set_new_file_interface(old_fi);
-			break;
 		}
 	}
-	return *dest;
+	if(fp)
+	{
+		al_fseek(fp, pos, ALLEGRO_SEEK_SET);
+	}
+	else
+	{
+		al_fclose(rfp);
+	}
 }
 
-void t3f_show_resources(void)
+/* decode the resource or share an already loaded copy, ptr is NULL for
+   resources loaded by handle, returns the slot or -1 on failure */
+static int load_resource(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool share)
 {
-	int i;
+	const ALLEGRO_FILE_INTERFACE * fi = al_get_new_file_interface();
+	T3F_RESOURCE * rp;
+	void * data = NULL;
+	unsigned long size = 0;
+	int cached, slot;
 
-	t3f_debug_message("Total resources: %d\n", t3f_resources);
-	for(i = 0; i < t3f_resources; i++)
+	if(!share || strlen(filename) >= T3F_RESOURCE_MAX_PATH)
+	{
+		cached = -1;
+	}
+	else
+	{
+		cached = find_cached_resource(hash_load(proc, filename, option, flags, offset, fi), proc, filename, option, flags, offset, fi);
+	}
+	if(cached >= 0)
+	{
+		rp = t3f_resource_slot[cached].resource;
+		data = *rp->ptr;
+		size = rp->size;
+
+		/* leave the file where decoding would have */
+		if(fp)
+		{
+			al_fseek(fp, size, ALLEGRO_SEEK_CUR);
+		}
+	}
+	else
+	{
+		t3f_push_memory_tag(T3F_MEMORY_TAG_RESOURCE);
+		proc(&data, fp, filename, option, flags, offset, false);
+		t3f_pop_memory_tag();
+		if(fp)
+		{
+			size = al_ftell(fp) - offset;
+		}
+	}
+	if(ptr)
+	{
+		*ptr = data;
+	}
+	if(!data)
+	{
+		return -1;
+	}
+	slot = strlen(filename) < T3F_RESOURCE_MAX_PATH ? t3f_add_resource(proc, ptr, filename, option, flags, offset, fi) : -1;
+	if(slot < 0)
+	{
+		/* nothing would keep a shared object alive or free a handle's */
+		if(cached >= 0 && ptr)
+		{
+			*ptr = NULL;
+		}
+		else if(cached < 0 && !ptr)
+		{
+			proc(&data, NULL, NULL, 0, 0, 0, true);
+		}
+		return -1;
+	}
+	rp = t3f_resource_slot[slot].resource;
+	*rp->ptr = data;
+	rp->size = size;
+	if(cached >= 0)
+	{
+		share_resource(slot, cached);
+	}
+	else
+	{
+		/* only shared loads can be found by later ones */
+		if(share)
+		{
+			cache_resource(slot);
+		}
+		if(t3f_keep_packed && proc == t3f_bitmap_resource_handler_proc)
+		{
+			t3f_push_memory_tag(T3F_MEMORY_TAG_RESOURCE);
+			pack_resource(rp, fp);
+			t3f_pop_memory_tag();
+		}
+	}
+	index_resource(slot);
+	return slot;
+}
+
+void * t3f_load_resource(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), const char * filename, int option, int flags, unsigned long offset)
+{
+	if(proc)
+	{
+		load_resource(ptr, proc, NULL, filename, option, flags, offset, false);
+	}
+	return *ptr;
+}
+
+void * t3f_load_resource_f(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), ALLEGRO_FILE * fp, const char * filename, int option, int flags)
+{
+	if(proc)
+	{
+		load_resource(ptr, proc, fp, filename, option, flags, al_ftell(fp), false);
+	}
+	return *ptr;
+}
+
+/* like t3f_load_resource() but shares the object with other shared loads of
+   the same thing, a shared object must not be changed or destroyed directly,
+   use t3f_make_resource_unique() before changing it and release it with
+   t3f_destroy_resource_ptr() */
+void * t3f_load_shared_resource(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), const char * filename, int option, int flags, unsigned long offset)
+{
+	if(proc)
+	{
+		load_resource(ptr, proc, NULL, filename, option, flags, offset, true);
+	}
+	return *ptr;
+}
+
+void * t3f_load_shared_resource_f(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), ALLEGRO_FILE * fp, const char * filename, int option, int flags)
+{
+	if(proc)
+	{
+		load_resource(ptr, proc, fp, filename, option, flags, al_ftell(fp), true);
+	}
+	return *ptr;
+}
+
+/* destroys the object, every resource sharing it is unloaded with it */
+static void t3f_actually_unload_resource(int i)
+{
+	T3F_RESOURCE * rp = t3f_resource_slot[i].resource;
+	T3F_RESOURCE * sp = rp;
+
+	if(rp->proc)
+	{
+		rp->proc(rp->ptr, NULL, NULL, 0, 0, 0, true);
+		do
+		{
+			unindex_resource(sp->slot);
+			*sp->ptr = NULL;
+			sp = sp->share_next;
+		} while(sp != rp);
+	}
+}
+
+/* drop one reference, the object goes with the last one */
+static void release_resource(int i)
+{
+	T3F_RESOURCE * rp;
+
+	if(t3f_recovery)
+	{
+		finish_recovery(-1.0, true);
+	}
+	rp = t3f_resource_slot[i].resource;
+
+	if(resource_shared(rp))
+	{
+		unindex_resource(i);
+		unshare_resource(i);
+		*rp->ptr = NULL;
+	}
+	else if(*rp->ptr)
+	{
+		t3f_actually_unload_resource(i);
+	}
+	t3f_remove_resource(i);
+}
+
+int t3f_unload_resource(void * ptr)
+{
+	int i;
+
+	i = find_resource(ptr, NULL);
+	if(i >= 0)
+	{
+		t3f_actually_unload_resource(i);
+	}
+	return i;
+}
+
+/* when several resources share the object there is no telling which of them
+   ptr came from, use t3f_destroy_resource_ptr() with shared resources */
+bool t3f_destroy_resource(void * ptr)
+{
+	int i;
+
+	i = find_resource(ptr, NULL);
+	if(i >= 0)
+	{
+		release_resource(i);
+		return true;
+	}
+	return false;
+}
+
+bool t3f_destroy_resource_ptr(void ** ptr)
+{
+	int i;
+
+	i = find_resource(*ptr, ptr);
+	if(i >= 0)
+	{
+		release_resource(i);
+		return true;
+	}
+	return false;
+}
+
+void t3f_unload_resources(void)
+{
+	int i;
+
+	if(t3f_recovery)
+	{
+		finish_recovery(-1.0, true);
+	}
+	for(i = 0; i < t3f_resource_slots; i++)
+	{
+		if(t3f_resource_slot[i].resource && *t3f_resource_slot[i].resource->ptr)
+		{
+			t3f_actually_unload_resource(i);
+		}
+	}
+}
+
+/* decode a bitmap resource into a memory bitmap, called from workers so it
+   only reads the resource */
+static void * decode_bitmap_resource(T3F_RESOURCE * rp)
+{
+	T3F_RESOURCE * sp = rp;
+	ALLEGRO_STATE old_state;
+	ALLEGRO_FILE * fp;
+	const ALLEGRO_FILE_INTERFACE * old_fi;
+	const char * ext;
+	void * result = NULL;
+
+	al_store_state(&old_state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+	/* only the resource that decoded the object has the packed copy */
+	while(!sp->packed && sp->share_next != rp)
+	{
+		sp = sp->share_next;
+	}
+	if(sp->packed)
+	{
+		fp = al_open_memfile(sp->packed, sp->packed_size, "rb");
+		if(fp)
+		{
+			if(sp->size)
+			{
+				sp->proc(&result, fp, sp->filename, sp->option, sp->flags, 0, false);
+			}
+			else
+			{
+				ext = strrchr(sp->filename, '.');
+				result = ext ? al_load_bitmap_f(fp, ext) : NULL;
+			}
+			al_fclose(fp);
+		}
+	}
+	if(!result)
+	{
+		old_fi = al_get_new_file_interface();
+		al_set_new_file_interface(rp->fi);
+		rp->proc(&result, NULL, rp->filename, rp->option, rp->flags, rp->offset, false);
+		al_set_new_file_interface(old_fi);
+	}
+	al_restore_state(&old_state);
+	return result;
+}
+
+static void recovery_job(void * data)
+{
+	int i;
+
+	t3f_push_memory_tag(T3F_MEMORY_TAG_RESOURCE);
+	while(1)
+	{
+		al_lock_mutex(t3f_recovery_mutex);
+		for(i = t3f_recovery_next; i < t3f_recoveries && (t3f_recovery[i].main_thread || t3f_recovery[i].state != _T3F_RECOVERY_WAITING); i++);
+		t3f_recovery_next = i;
+		if(i >= t3f_recoveries)
+		{
+			al_unlock_mutex(t3f_recovery_mutex);
+			break;
+		}
+		t3f_recovery[i].state = _T3F_RECOVERY_CLAIMED;
+		al_unlock_mutex(t3f_recovery_mutex);
+
+		T3F_TRACE_BEGIN("recover_resource");
+		t3f_recovery[i].result = decode_bitmap_resource(t3f_recovery[i].resource);
+		T3F_TRACE_END();
+
+		al_lock_mutex(t3f_recovery_mutex);
+		t3f_recovery[i].state = _T3F_RECOVERY_DECODED;
+		al_broadcast_cond(t3f_recovery_cond);
+		al_unlock_mutex(t3f_recovery_mutex);
+	}
+	t3f_pop_memory_tag();
+}
+
+/* returns false without doing anything if wait is false and a worker still
+   has the resource */
+static bool recover_resource(T3F_RESOURCE_RECOVERY * rp, bool wait)
+{
+	T3F_RESOURCE * sp = rp->resource;
+	ALLEGRO_STATE old_state;
+
+	if(rp->main_thread)
+	{
+		al_set_new_file_interface(rp->resource->fi);
+		rp->resource->proc(rp->resource->ptr, NULL, rp->resource->filename, rp->resource->option, rp->resource->flags, rp->resource->offset, false);
+	}
+	else
+	{
+		al_lock_mutex(t3f_recovery_mutex);
+		if(rp->state == _T3F_RECOVERY_WAITING)
+		{
+			/* nobody has started on it, do it here */
+			rp->state = _T3F_RECOVERY_CLAIMED;
+			al_unlock_mutex(t3f_recovery_mutex);
+			rp->result = decode_bitmap_resource(rp->resource);
+			al_lock_mutex(t3f_recovery_mutex);
+			rp->state = _T3F_RECOVERY_DECODED;
+		}
+		else if(!wait && rp->state != _T3F_RECOVERY_DECODED)
+		{
+			al_unlock_mutex(t3f_recovery_mutex);
+			return false;
+		}
+		while(rp->state != _T3F_RECOVERY_DECODED)
+		{
+			al_wait_cond(t3f_recovery_cond, t3f_recovery_mutex);
+		}
+		al_unlock_mutex(t3f_recovery_mutex);
+
+		/* upload with the flags the handler would have used */
+		if(rp->result)
+		{
+			al_store_state(&old_state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+			al_set_new_bitmap_flags((al_get_new_bitmap_flags() & ~ALLEGRO_MEMORY_BITMAP) | ALLEGRO_NO_PRESERVE_TEXTURE);
+			al_convert_bitmap(rp->result);
+			al_restore_state(&old_state);
+		}
+		*rp->resource->ptr = rp->result;
+	}
+	do
+	{
+		*sp->ptr = *rp->resource->ptr;
+		index_resource(sp->slot);
+		sp = sp->share_next;
+	} while(sp != rp->resource);
+	rp->state = _T3F_RECOVERY_FINISHED;
+	return true;
+}
+
+/* finish recoveries in priority order, deferred ones only if asked to, a
+   negative max_time means no limit */
+static void finish_recovery(double max_time, bool deferred)
+{
+	const ALLEGRO_FILE_INTERFACE * old_fi;
+	double start_time = al_get_time();
+
+	old_fi = al_get_new_file_interface();
+	t3f_push_memory_tag(T3F_MEMORY_TAG_RESOURCE);
+	while(t3f_recovery_finished < t3f_recoveries)
+	{
+		if(!deferred && t3f_recovery[t3f_recovery_finished].priority < 0)
+		{
+			break;
+		}
+		if(!recover_resource(&t3f_recovery[t3f_recovery_finished], max_time < 0.0))
+		{
+			break;
+		}
+		t3f_recovery_finished++;
+		if(max_time >= 0.0 && al_get_time() - start_time >= max_time)
+		{
+			break;
+		}
+	}
+	t3f_pop_memory_tag();
+	al_set_new_file_interface(old_fi);
+
+	if(t3f_recovery_finished >= t3f_recoveries)
+	{
+		if(t3f_recovery_counter)
+		{
+			t3f_wait_job_counter(t3f_recovery_counter);
+		}
+		al_free(t3f_recovery);
+		t3f_recovery = NULL;
+		t3f_recoveries = 0;
+	}
+}
+
+static int recovery_sorter(const void * e1, const void * e2)
+{
+	const T3F_RESOURCE_RECOVERY * r1 = e1;
+	const T3F_RESOURCE_RECOVERY * r2 = e2;
+
+	if(r1->priority != r2->priority)
+	{
+		return r2->priority - r1->priority;
+	}
+	return r1->resource->slot - r2->resource->slot;
+}
+
+/* only the lowest slot of each ring is recovered, the rest share it */
+static bool first_in_ring(T3F_RESOURCE * rp, int * priority)
+{
+	T3F_RESOURCE * sp;
+
+	*priority = rp->priority;
+	for(sp = rp->share_next; sp != rp; sp = sp->share_next)
+	{
+		if(sp->slot < rp->slot)
+		{
+			return false;
+		}
+		if(sp->priority > *priority)
+		{
+			*priority = sp->priority;
+		}
+	}
+	return true;
+}
+
+/* brings back unloaded resources, objects are decoded once per ring */
+void t3f_reload_resources(void)
+{
+	T3F_RESOURCE * rp;
+	int i, priority, workers;
+
+	if(t3f_recovery)
+	{
+		finish_recovery(-1.0, true);
+	}
+	T3F_TRACE_BEGIN("reload_resources");
+	t3f_recovery = al_malloc(sizeof(T3F_RESOURCE_RECOVERY) * (t3f_resource_slots ? t3f_resource_slots : 1));
+	if(!t3f_recovery)
+	{
+		T3F_TRACE_END();
+		return;
+	}
+	t3f_recoveries = 0;
+	workers = 0;
+	for(i = 0; i < t3f_resource_slots; i++)
+	{
+		rp = t3f_resource_slot[i].resource;
+		if(rp && rp->proc && !*rp->ptr && first_in_ring(rp, &priority))
+		{
+			t3f_recovery[t3f_recoveries].resource = rp;
+			t3f_recovery[t3f_recoveries].priority = priority;
+			t3f_recovery[t3f_recoveries].main_thread = rp->proc != t3f_bitmap_resource_handler_proc;
+			t3f_recovery[t3f_recoveries].result = NULL;
+			t3f_recovery[t3f_recoveries].state = _T3F_RECOVERY_WAITING;
+			if(!t3f_recovery[t3f_recoveries].main_thread)
+			{
+				workers++;
+			}
+			t3f_recoveries++;
+		}
+	}
+	qsort(t3f_recovery, t3f_recoveries, sizeof(T3F_RESOURCE_RECOVERY), recovery_sorter);
+	t3f_recovery_next = 0;
+	t3f_recovery_finished = 0;
+
+	/* without a worker pool, t3f_initialize() only starts one when passed
+	   T3F_USE_JOBS, everything is decoded here as it is needed */
+	if(workers > t3f_get_job_workers())
+	{
+		workers = t3f_get_job_workers();
+	}
+	if(workers > 0)
+	{
+		if(!t3f_recovery_mutex)
+		{
+			t3f_recovery_mutex = al_create_mutex();
+			t3f_recovery_cond = al_create_cond();
+			t3f_recovery_counter = t3f_create_job_counter();
+		}
+		if(t3f_recovery_mutex && t3f_recovery_cond && t3f_recovery_counter)
+		{
+			for(i = 0; i < workers; i++)
+			{
+				t3f_add_job(recovery_job, NULL, t3f_recovery_counter);
+			}
+		}
+	}
+	finish_recovery(-1.0, false);
+	T3F_TRACE_END();
+}
+
+/* finish deferred recoveries, the framework calls this every logic tick */
+void t3f_update_resource_recovery(double max_time)
+{
+	if(t3f_recovery)
+	{
+		finish_recovery(max_time, true);
+	}
+}
+
+int t3f_get_pending_recoveries(void)
+{
+	return t3f_recovery ? t3f_recoveries - t3f_recovery_finished : 0;
+}
+
+/* higher priorities are recovered first, resources below zero are recovered
+   in the background after t3f_reload_resources() returns, so don't defer
+   anything that has to be on an atlas */
+bool t3f_set_resource_priority(void ** ptr, int priority)
+{
+	int i;
+
+	i = find_resource(*ptr, ptr);
+	if(i < 0)
+	{
+		return false;
+	}
+	t3f_resource_slot[i].resource->priority = priority;
+	return true;
+}
+
+/* keep the file data of bitmap resources loaded from now on so they can be
+   recovered without reading the disk */
+void t3f_keep_packed_resources(bool keep)
+{
+	t3f_keep_packed = keep;
+}
+
+/* dest shares the object, use t3f_make_resource_unique() before changing it */
+void * t3f_clone_resource(void ** dest, void * ptr)
+{
+	T3F_RESOURCE * rp;
+	int i, slot;
+
+	i = find_resource(ptr, NULL);
+	if(i >= 0)
+	{
+		rp = t3f_resource_slot[i].resource;
+		slot = t3f_add_resource(rp->proc, dest, rp->filename, rp->option, rp->flags, rp->offset, rp->fi);
+		if(slot >= 0)
+		{
+			*dest = ptr;
+			t3f_resource_slot[slot].resource->size = rp->size;
+			share_resource(slot, i);
+			index_resource(slot);
+		}
+	}
+	return *dest;
+}
+
+/* stop managing ptr without destroying the object, for objects something
+   else takes care of from now on */
+bool t3f_forget_resource(void ** ptr)
+{
+	int i;
+
+	i = find_resource(*ptr, ptr);
+	if(i < 0)
+	{
+		return false;
+	}
+	t3f_remove_resource(i);
+	return true;
+}
+
+/* what ptr was loaded from, NULL if it isn't a resource */
+const T3F_RESOURCE * t3f_get_resource_info(void ** ptr)
+{
+	int i;
+
+	i = find_resource(*ptr, ptr);
+	if(i < 0)
+	{
+		return NULL;
+	}
+	return t3f_resource_slot[i].resource;
+}
+
+/* call before replacing *ptr with something else, returns true if other
+   resources still use the old object so the caller must not destroy it */
+bool t3f_detach_resource(void ** ptr)
+{
+	T3F_RESOURCE * rp;
+	int i;
+
+	i = find_resource(*ptr, ptr);
+	if(i < 0)
+	{
+		return false;
+	}
+
+	/* the caller changes *ptr behind our back */
+	mark_resource_stale(i);
+	rp = t3f_resource_slot[i].resource;
+	if(resource_shared(rp))
+	{
+		unshare_resource(i);
+		return true;
+	}
+
+	/* the object is about to go, stop handing it out */
+	uncache_resource(i);
+	return false;
+}
+
+/* copy on write, gives ptr a private copy of a shared object */
+void * t3f_make_resource_unique(void ** ptr)
+{
+	T3F_RESOURCE * rp;
+	const ALLEGRO_FILE_INTERFACE * old_fi;
+	int i;
+
+	i = find_resource(*ptr, ptr);
+	if(i < 0 || !resource_shared(t3f_resource_slot[i].resource))
+	{
+		return *ptr;
+	}
+	rp = t3f_resource_slot[i].resource;
+	unindex_resource(i);
+	unshare_resource(i);
+	old_fi = al_get_new_file_interface();
+	al_set_new_file_interface(rp->fi);
+	t3f_push_memory_tag(T3F_MEMORY_TAG_RESOURCE);
+	*rp->ptr = NULL;
+	rp->proc(rp->ptr, NULL, rp->filename, rp->option, rp->flags, rp->offset, false);
+	t3f_pop_memory_tag();
+	al_set_new_file_interface(old_fi);
+	index_resource(i);
+	return *ptr;
+}
+
+void t3f_show_resources(void)
+{
+	int i;
+
+	t3f_debug_message("Total resources: %d\n", t3f_resources);
+	for(i = 0; i < t3f_resource_slots; i++)
+	{
+		if(t3f_resource_slot[i].resource)
+		{
+			t3f_debug_message("Resource %d: %s%s\n", i, t3f_resource_slot[i].resource->filename, resource_shared(t3f_resource_slot[i].resource) ? " (shared)" : "");
+		}
+	}
+}
+
+static T3F_RESOURCE_HANDLE make_handle(int slot)
+{
+	return ((T3F_RESOURCE_HANDLE)t3f_resource_slot[slot].generation << T3F_RESOURCE_HANDLE_INDEX_BITS) | slot;
+}
+
+static int get_handle_slot(T3F_RESOURCE_HANDLE handle)
+{
+	int slot = handle & ((1 << T3F_RESOURCE_HANDLE_INDEX_BITS) - 1);
+
+	if(handle == T3F_RESOURCE_HANDLE_NONE || slot >= t3f_resource_slots)
+	{
+		return -1;
+	}
+	if(!t3f_resource_slot[slot].resource || t3f_resource_slot[slot].generation != handle >> T3F_RESOURCE_HANDLE_INDEX_BITS)
+	{
+		return -1;
+	}
+	return slot;
+}
+
+/* the registry owns the pointer, look it up with t3f_get_resource() each time
+   it is used since reloading may change it */
+T3F_RESOURCE_HANDLE t3f_load_resource_handle(bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), const char * filename, int option, int flags, unsigned long offset)
+{
+	int slot;
+
+	if(!proc)
+	{
+		return T3F_RESOURCE_HANDLE_NONE;
+	}
+	slot = load_resource(NULL, proc, NULL, filename, option, flags, offset, false);
+	if(slot < 0)
+	{
+		return T3F_RESOURCE_HANDLE_NONE;
+	}
+	return make_handle(slot);
+}
+
+T3F_RESOURCE_HANDLE t3f_get_resource_handle(void * ptr)
+{
+	int slot;
+
+	slot = find_resource(ptr, NULL);
+	if(slot < 0)
+	{
+		return T3F_RESOURCE_HANDLE_NONE;
+	}
+	return make_handle(slot);
+}
+
+/* NULL for released handles and while the resource is unloaded */
+void * t3f_get_resource(T3F_RESOURCE_HANDLE handle)
+{
+	int slot;
+
+	slot = get_handle_slot(handle);
+	if(slot < 0)
+	{
+		return NULL;
+	}
+	return *t3f_resource_slot[slot].resource->ptr;
+}
+
+bool t3f_release_resource(T3F_RESOURCE_HANDLE handle)
+{
+	int slot;
+
+	slot = get_handle_slot(handle);
+	if(slot < 0)
 	{
-		t3f_debug_message("Resource %d: %s\n", i, t3f_resource[i]->filename);
+		return false;
 	}
+	release_resource(slot);
+	return true;
 }
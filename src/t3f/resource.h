@@ -3,11 +3,22 @@
 
 #include <allegro5/allegro.h>
 
-#define T3F_MAX_RESOURCES        1024
-
 #define T3F_RESOURCE_MAX_PATH     256
 
-typedef struct
+/* handles pack a slot index with the slot's generation so a handle to a
+   resource that has been released never finds whatever reuses the slot */
+#define T3F_RESOURCE_HANDLE_INDEX_BITS 20
+#define T3F_RESOURCE_HANDLE_NONE        0
+
+typedef uint32_t T3F_RESOURCE_HANDLE;
+
+#define T3F_RESOURCE_PRIORITY_HIGH      100
+#define T3F_RESOURCE_PRIORITY_NORMAL      0
+#define T3F_RESOURCE_PRIORITY_DEFERRED -100
+
+typedef struct T3F_RESOURCE T3F_RESOURCE;
+
+struct T3F_RESOURCE
 {
 
 	bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy);
@@ -17,7 +28,22 @@ typedef struct
 	const ALLEGRO_FILE_INTERFACE * fi;
 	void ** ptr;
 
-} T3F_RESOURCE;
+	void * data; // ptr points here for resources loaded by handle
+	void * key;  // value of *ptr when it was last indexed
+	int slot;
+
+	/* resources sharing one object form a ring */
+	T3F_RESOURCE * share_next;
+	unsigned long size; // bytes the object takes up in its file
+	unsigned long cache_hash;
+	bool cached;
+
+	/* display loss recovery */
+	int priority;
+	void * packed; // copy of the file data if packed resources are kept
+	size_t packed_size;
+
+};
 
 /* resource handlers */
 bool t3f_bitmap_resource_handler_proc(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy);
@@ -28,11 +54,28 @@ bool t3f_t3f_font_load_resource_handler_proc(void ** ptr, ALLEGRO_FILE * fp, con
 
 void * t3f_load_resource(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), const char * filename, int option, int flags, unsigned long offset);
 void * t3f_load_resource_f(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), ALLEGRO_FILE * fp, const char * filename, int option, int flags);
+void * t3f_load_shared_resource(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), const char * filename, int option, int flags, unsigned long offset);
+void * t3f_load_shared_resource_f(void ** ptr, bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), ALLEGRO_FILE * fp, const char * filename, int option, int flags);
+int t3f_add_resource(bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), void ** ptr, const char * filename, int option, int flags, unsigned long offset, const ALLEGRO_FILE_INTERFACE * fi);
 int t3f_unload_resource(void * ptr);
 bool t3f_destroy_resource(void * ptr);
+bool t3f_destroy_resource_ptr(void ** ptr);
 void t3f_unload_resources(void);
 void t3f_reload_resources(void);
+void t3f_update_resource_recovery(double max_time);
+int t3f_get_pending_recoveries(void);
+bool t3f_set_resource_priority(void ** ptr, int priority);
+void t3f_keep_packed_resources(bool keep);
 void * t3f_clone_resource(void ** dest, void * ptr);
+const T3F_RESOURCE * t3f_get_resource_info(void ** ptr);
+bool t3f_forget_resource(void ** ptr);
+bool t3f_detach_resource(void ** ptr);
+void * t3f_make_resource_unique(void ** ptr);
 void t3f_show_resources(void);
 
+T3F_RESOURCE_HANDLE t3f_load_resource_handle(bool (*proc)(void ** ptr, ALLEGRO_FILE * fp, const char * filename, int option, int flags, unsigned long offset, bool destroy), const char * filename, int option, int flags, unsigned long offset);
+T3F_RESOURCE_HANDLE t3f_get_resource_handle(void * ptr);
+void * t3f_get_resource(T3F_RESOURCE_HANDLE handle);
+bool t3f_release_resource(T3F_RESOURCE_HANDLE handle);
+
 #endif
@@ -78,6 +78,7 @@ int t3f_option[T3F_MAX_OPTIONS] = {0};
 
 void (*t3f_logic_proc)(void * data) = NULL;
 void (*t3f_render_proc)(void * data) = NULL;
+static void (*t3f_interpolated_render_proc)(void * data, float alpha) = NULL;
 static void * t3f_user_data = NULL;
 
 ALLEGRO_DISPLAY * t3f_display = NULL;
@@ -97,6 +98,31 @@ ALLEGRO_COLOR t3f_color_black;
 
 /* internal variables */
 static bool t3f_need_redraw = false;
+static bool t3f_frame_unchanged = false;
+static float t3f_interpolation_alpha = 0.0;
+static unsigned long t3f_dropped_ticks = 0;
+
+/* threaded rendering, logic fills in one snapshot while the render thread
+   draws another and the third holds the newest complete one */
+static void (*t3f_snapshot_proc)(void * snapshot, void * data) = NULL;
+static void (*t3f_snapshot_render_proc)(void * snapshot, void * data) = NULL;
+static void * t3f_snapshot[3] = {NULL};
+static int t3f_snapshot_write = 0;
+static int t3f_snapshot_ready = 1;
+static int t3f_snapshot_read = 2;
+static bool t3f_snapshot_fresh = false;
+static bool t3f_snapshot_published = false;
+static ALLEGRO_MUTEX * t3f_snapshot_mutex = NULL;
+static ALLEGRO_COND * t3f_snapshot_cond = NULL;
+
+/* the view and transform each snapshot was taken with, the render thread
+   draws with these since logic keeps changing the current ones */
+static T3F_VIEW t3f_snapshot_view[3];
+static ALLEGRO_TRANSFORM t3f_snapshot_transform[3];
+static ALLEGRO_THREAD * t3f_render_thread = NULL;
+static bool t3f_frame_cache_enabled = false;
+static ALLEGRO_BITMAP * t3f_frame_cache = NULL;
+static bool t3f_frame_cache_valid = false;
 static int t3f_halted = 0;
 static void (*t3f_event_handler_proc)(ALLEGRO_EVENT * event, void * data) = NULL;
 static void (*t3f_queued_call_proc)(void * data) = NULL;
@@ -510,6 +536,8 @@ int t3f_initialize(const char * name, int w, int h, double fps, void (*logic_pro
 	else
 	{
 		t3f_flags |= T3F_NO_DISPLAY;
+		t3f_virtual_display_width = w;
+		t3f_virtual_display_height = h;
 	}
 
 	if(t3f_flags & T3F_USE_KEYBOARD)
@@ -545,6 +573,18 @@ int t3f_initialize(const char * name, int w, int h, double fps, void (*logic_pro
 		}
 		t3f_select_view(t3f_default_view);
 	}
+	else
+	{
+		/* headless apps still need a view to project coordinates when
+		   drawing to memory bitmaps */
+		t3f_default_view = t3f_create_view(0, 0, w, h, w / 2, h / 2, t3f_flags);
+		if(!t3f_default_view)
+		{
+			printf("Failed to create default view!\n");
+			return 0;
+		}
+		t3f_current_view = t3f_default_view;
+	}
 
 	t3f_color_white = al_map_rgba_f(1.0, 1.0, 1.0, 1.0);
 	t3f_color_black = al_map_rgba_f(0.0, 0.0, 0.0, 1.0);
@@ -557,6 +597,26 @@ int t3f_initialize(const char * name, int w, int h, double fps, void (*logic_pro
 	t3f_render_proc = render_proc;
 	t3f_user_data = data;
 
+	/* scratch memory for the main thread, reset every logic tick */
+	if(!t3f_create_frame_arena(0))
+	{
+		printf("Failed to create frame arena!\n");
+		return 0;
+	}
+
+	/* loads and resource recovery fall back to the main thread without it */
+	if(flags & T3F_USE_JOBS)
+	{
+		if(t3f_init_job_system(0))
+		{
+			t3f_flags |= T3F_USE_JOBS;
+		}
+		else
+		{
+			printf("Failed to start job system!\n");
+		}
+	}
+
 	/* locate user resources */
 	t3f_locate_resource("data/t3f.dat");
 
@@ -574,8 +634,19 @@ void t3f_set_option(int option, int value)
 	al_set_config_value(t3f_config, "Options", buf, vbuf);
 }
 
+static void t3f_destroy_frame_cache(void)
+{
+	if(t3f_frame_cache)
+	{
+		al_destroy_bitmap(t3f_frame_cache);
+		t3f_frame_cache = NULL;
+	}
+	t3f_frame_cache_valid = false;
+}
+
 static void handle_view_resize(void)
 {
+	t3f_destroy_frame_cache();
 	t3f_adjust_view(t3f_default_view, 0, 0, al_get_display_width(t3f_display), al_get_display_height(t3f_display), t3f_virtual_display_width / 2, t3f_virtual_display_height / 2, t3f_flags);
 	t3f_default_view->need_update = true;
 	t3f_select_view(t3f_default_view);
@@ -1161,6 +1232,44 @@ bool t3f_copy_file(const char * src, const char * dest)
 	return true;
 }
 
+/* run one tick of logic */
+static void t3f_logic_tick(void)
+{
+	if(!(t3f_flags & T3F_NO_DISPLAY))
+	{
+		t3f_select_input_view(t3f_default_view);
+	}
+	t3f_frame_unchanged = false;
+	t3f_reset_frame_arena();
+
+	/* finishing loads needs the display, while the render thread has it the
+	   threaded run loop takes it back to do this */
+	if(!t3f_render_thread)
+	{
+		t3f_update_loads();
+	}
+	T3F_PROFILE_BEGIN(T3F_PROFILE_LOGIC);
+	T3F_TRACE_BEGIN("logic");
+	t3f_logic_proc(t3f_user_data);
+	T3F_TRACE_END();
+	T3F_PROFILE_END(T3F_PROFILE_LOGIC);
+	if(!t3f_frame_unchanged)
+	{
+		t3f_frame_cache_valid = false;
+		t3f_need_redraw = true;
+	}
+}
+
+/* everything that runs once per timer tick, whichever run mode drives it */
+static void t3f_timer_tick(void)
+{
+	t3f_android_support_helper();
+	#ifndef ALLEGRO_ANDROID
+		t3f_update_menus(t3f_user_data);
+	#endif
+	t3f_logic_tick();
+}
+
 void t3f_event_handler(ALLEGRO_EVENT * event)
 {
 	switch(event->type)
@@ -1187,15 +1296,28 @@ void t3f_event_handler(ALLEGRO_EVENT * event)
 			al_set_config_value(t3f_config, "T3F", "display_width", val);
 			sprintf(val, "%d", al_get_display_height(t3f_display));
 			al_set_config_value(t3f_config, "T3F", "display_height", val);
+			t3f_need_redraw = true;
+			break;
+		}
+
+		/* part of the window needs to be redrawn, present what we have */
+		case ALLEGRO_EVENT_DISPLAY_EXPOSE:
+		case ALLEGRO_EVENT_DISPLAY_SWITCH_IN:
+		{
+			t3f_need_redraw = true;
 			break;
 		}
 
 		case ALLEGRO_EVENT_DISPLAY_FOUND:
 		{
+			T3F_TRACE_BEGIN("display_found");
+			t3f_destroy_frame_cache();
 			t3f_unload_atlases();
 			t3f_unload_resources();
 			t3f_reload_resources();
 			t3f_rebuild_atlases();
+			T3F_TRACE_END();
+			t3f_need_redraw = true;
 			break;
 		}
 
@@ -1344,6 +1466,7 @@ void t3f_event_handler(ALLEGRO_EVENT * event)
 		case ALLEGRO_EVENT_DISPLAY_HALT_DRAWING:
 		{
 			al_stop_timer(t3f_timer);
+			t3f_destroy_frame_cache();
 			t3f_unload_atlases();
 			t3f_unload_resources();
 			t3f_halted = 1;
@@ -1358,13 +1481,16 @@ void t3f_event_handler(ALLEGRO_EVENT * event)
 		{
 			al_acknowledge_drawing_resume(t3f_display);
 			t3f_halted = 0;
+			T3F_TRACE_BEGIN("resume_drawing");
 			t3f_reload_resources();
 			t3f_rebuild_atlases();
+			T3F_TRACE_END();
 			if(t3f_stream)
 			{
 				t3f_resume_music();
 			}
 			t3f_set_clipping_rectangle(0, 0, 0, 0);
+			t3f_need_redraw = true;
 			al_start_timer(t3f_timer);
 			break;
 		}
@@ -1379,40 +1505,212 @@ void t3f_event_handler(ALLEGRO_EVENT * event)
 		/* this keeps your program running */
 		case ALLEGRO_EVENT_TIMER:
 		{
-			t3f_android_support_helper();
-			#ifndef ALLEGRO_ANDROID
-				t3f_update_menus(t3f_user_data);
-			#endif
-			if(!(t3f_flags & T3F_NO_DISPLAY))
-			{
-				t3f_select_input_view(t3f_default_view);
-			}
-			t3f_logic_proc(t3f_user_data);
-			t3f_need_redraw = true;
+			t3f_timer_tick();
 			break;
 		}
 	}
 }
 
-/* called when it's time to render */
-void t3f_render(bool flip)
+/* the render callback gets passed how far we are between the last logic tick
+   and the next one so it can interpolate, only used with
+   T3F_RUN_MODE_FIXED_STEP, frames are rendered up to the display refresh
+   rate while the logic keeps changing the frame */
+void t3f_set_interpolated_render_proc(void (*proc)(void * data, float alpha))
 {
-	if(t3f_display && t3f_render_proc && !t3f_halted)
- 	{
-		/* some video drivers and compositors may leave junk in the buffers,
-		   this config file setting will work around the issue by clearing the
-		   entire buffer before drawing anything */
-		if(t3f_option[T3F_OPTION_RENDER_MODE] == T3F_RENDER_MODE_ALWAYS_CLEAR)
+	t3f_interpolated_render_proc = proc;
+}
+
+float t3f_get_interpolation_alpha(void)
+{
+	return t3f_interpolation_alpha;
+}
+
+/* logic ticks thrown away because we fell too far behind */
+unsigned long t3f_get_dropped_ticks(void)
+{
+	return t3f_dropped_ticks;
+}
+
+static void t3f_flip(void)
+{
+	T3F_PROFILE_BEGIN(T3F_PROFILE_FLIP);
+	T3F_TRACE_BEGIN("flip");
+	al_flip_display();
+	T3F_TRACE_END();
+	T3F_PROFILE_END(T3F_PROFILE_FLIP);
+}
+
+static void t3f_call_render_proc(void * snapshot)
+{
+	T3F_PROFILE_BEGIN(T3F_PROFILE_RENDER);
+	T3F_TRACE_BEGIN("render");
+	if(snapshot)
+	{
+		t3f_snapshot_render_proc(snapshot, t3f_user_data);
+	}
+	else if(t3f_interpolated_render_proc)
+	{
+		t3f_interpolated_render_proc(t3f_user_data, t3f_interpolation_alpha);
+	}
+	else
+	{
+		t3f_render_proc(t3f_user_data);
+	}
+	T3F_TRACE_END();
+	T3F_PROFILE_END(T3F_PROFILE_RENDER);
+}
+
+/* call from the logic callback when nothing visible changed this tick, the
+   previous frame stays on screen and no render or flip happens */
+void t3f_set_frame_unchanged(void)
+{
+	t3f_frame_unchanged = true;
+}
+
+/* force the next pass through the main loop to present a frame */
+void t3f_request_redraw(void)
+{
+	t3f_frame_cache_valid = false;
+	t3f_need_redraw = true;
+}
+
+/* keep a copy of the last composed frame so expose and switch events can be
+   handled without calling the render callback, costs one display sized
+   bitmap and an extra blit for every rendered frame */
+void t3f_enable_frame_cache(bool enable)
+{
+	t3f_frame_cache_enabled = enable;
+	if(!enable)
+	{
+		t3f_destroy_frame_cache();
+	}
+}
+
+static void t3f_draw_frame_cache(void)
+{
+	ALLEGRO_STATE old_state;
+	ALLEGRO_TRANSFORM identity;
+	int cx, cy, cw, ch;
+
+	al_store_state(&old_state, ALLEGRO_STATE_BLENDER | ALLEGRO_STATE_TRANSFORM);
+	al_get_clipping_rectangle(&cx, &cy, &cw, &ch);
+	al_set_clipping_rectangle(0, 0, al_get_display_width(t3f_display), al_get_display_height(t3f_display));
+	al_identity_transform(&identity);
+	al_use_transform(&identity);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+	al_draw_bitmap(t3f_frame_cache, 0, 0, 0);
+	al_set_clipping_rectangle(cx, cy, cw, ch);
+	al_restore_state(&old_state);
+}
+
+static bool t3f_create_frame_cache(void)
+{
+	int w = al_get_display_width(t3f_display);
+	int h = al_get_display_height(t3f_display);
+
+	if(t3f_frame_cache && (al_get_bitmap_width(t3f_frame_cache) != w || al_get_bitmap_height(t3f_frame_cache) != h))
+	{
+		t3f_destroy_frame_cache();
+	}
+	if(!t3f_frame_cache)
+	{
+		t3f_frame_cache = al_create_bitmap(w, h);
+	}
+	return t3f_frame_cache != NULL;
+}
+
+/* present a frame from the main loop, reuses the cached frame if the logic
+   hasn't changed anything since it was rendered */
+static void t3f_present(void)
+{
+	if(t3f_frame_cache_enabled && t3f_frame_cache_valid && t3f_display && !t3f_halted)
+	{
+		t3f_draw_frame_cache();
+		if(t3f_profiler_overlay)
 		{
-			al_set_clipping_rectangle(0, 0, al_get_display_width(t3f_display), al_get_display_height(t3f_display));
-			al_clear_to_color(al_map_rgb_f(0.0, 0.0, 0.0));
-			t3f_select_view(t3f_current_view);
+			t3f_draw_profiler_overlay();
 		}
+		t3f_flip();
+		t3f_need_redraw = false;
+	}
+	else
+	{
+		t3f_render(true);
+	}
+}
+
+/* draw a frame to the back buffer */
+static void t3f_render_frame(void)
+{
+	/* some video drivers and compositors may leave junk in the buffers,
+	   this config file setting will work around the issue by clearing the
+	   entire buffer before drawing anything */
+	if(t3f_option[T3F_OPTION_RENDER_MODE] == T3F_RENDER_MODE_ALWAYS_CLEAR)
+	{
+		al_set_clipping_rectangle(0, 0, al_get_display_width(t3f_display), al_get_display_height(t3f_display));
+		al_clear_to_color(al_map_rgb_f(0.0, 0.0, 0.0));
+		t3f_select_view(t3f_current_view);
+	}
+	/* compose into the frame cache and copy it to the back buffer */
+	if(t3f_frame_cache_enabled && t3f_create_frame_cache())
+	{
+		al_set_target_bitmap(t3f_frame_cache);
+		t3f_select_view(t3f_current_view);
 		al_use_transform(&t3f_current_transform);
-		t3f_render_proc(t3f_user_data);
+		t3f_call_render_proc(NULL);
+		al_set_target_backbuffer(t3f_display);
+		t3f_select_view(t3f_current_view);
+		t3f_draw_frame_cache();
+		t3f_frame_cache_valid = true;
+	}
+	else
+	{
+		al_use_transform(&t3f_current_transform);
+		t3f_call_render_proc(NULL);
+	}
+	if(t3f_profiler_overlay)
+	{
+		t3f_draw_profiler_overlay();
+	}
+}
+
+/* draw snapshot i to the back buffer, only uses what was captured with the
+   snapshot so it is safe while logic runs on another thread, never uses the
+   frame cache */
+static void t3f_render_snapshot(int i)
+{
+	T3F_VIEW * vp = &t3f_snapshot_view[i];
+	ALLEGRO_TRANSFORM * tp = &t3f_snapshot_transform[i];
+	float tx = vp->left, ty = vp->top;
+	float twx = vp->right, twy = vp->bottom;
+
+	if(t3f_option[T3F_OPTION_RENDER_MODE] == T3F_RENDER_MODE_ALWAYS_CLEAR)
+	{
+		al_set_clipping_rectangle(0, 0, al_get_display_width(t3f_display), al_get_display_height(t3f_display));
+		al_clear_to_color(al_map_rgb_f(0.0, 0.0, 0.0));
+	}
+
+	/* same clipping t3f_select_view() would give the view */
+	al_transform_coordinates(tp, &tx, &ty);
+	al_transform_coordinates(tp, &twx, &twy);
+	al_set_clipping_rectangle(tx + 0.5, ty + 0.5, twx - tx + 0.5, twy - ty + 0.5);
+	al_use_transform(tp);
+	t3f_call_render_proc(t3f_snapshot[i]);
+	if(t3f_profiler_overlay)
+	{
+		t3f_draw_profiler_overlay();
+	}
+}
+
+/* called when it's time to render */
+void t3f_render(bool flip)
+{
+	if(t3f_display && (t3f_render_proc || t3f_interpolated_render_proc) && !t3f_halted)
+ 	{
+		t3f_render_frame();
 		if(flip)
 		{
-			al_flip_display();
+			t3f_flip();
 			t3f_need_redraw = false;
 		}
 	}
@@ -1438,13 +1736,40 @@ void t3f_process_events(bool ignore)
 	}
 }
 
-/* this function is where it's at
-   somewhere in your logic code you need to set t3f_quit = true to exit */
-void t3f_run(void)
+static void t3f_dispatch_event(ALLEGRO_EVENT * event)
+{
+	T3F_PROFILE_BEGIN(T3F_PROFILE_EVENTS);
+	if(t3f_event_handler_proc)
+	{
+		t3f_event_handler_proc(event, t3f_user_data);
+	}
+	else
+	{
+		t3f_event_handler(event);
+	}
+	T3F_PROFILE_END(T3F_PROFILE_EVENTS);
+}
+
+/* logic is driven by the clock instead of timer events, we run as many ticks
+   as needed to catch up (up to a limit) and then render once, the timer is
+   only used to wake us up when there is nothing else to do */
+static void t3f_run_fixed_step(void)
 {
 	ALLEGRO_EVENT event;
+	double tick_time = al_get_timer_speed(t3f_timer);
+	double last_time, current_time;
+	double accumulator = 0.0;
+	double frame_time, frame_start = 0.0;
+	int max_ticks = t3f_option[T3F_OPTION_MAX_CATCH_UP_TICKS];
+	int ticks, dropped;
+	bool interpolating = false; // the last tick changed what is on screen
 
+	if(max_ticks <= 0)
+	{
+		max_ticks = T3F_DEFAULT_MAX_CATCH_UP_TICKS;
+	}
 	al_start_timer(t3f_timer);
+	last_time = al_get_time();
 	while(!t3f_quit)
 	{
 		/* call queued up procudure */
@@ -1454,20 +1779,386 @@ void t3f_run(void)
 			t3f_queued_call_proc = NULL;
 			t3f_queued_call_data = NULL;
 		}
+
+		/* wait for something to happen unless we are rendering every frame,
+		   then only wait out the rest of the frame if the flip didn't block
+		   so we don't spin without vsync */
+		if(!t3f_interpolated_render_proc || t3f_halted || !interpolating)
+		{
+			al_wait_for_event(t3f_queue, NULL);
+		}
+		else
+		{
+			frame_time = tick_time;
+			if(t3f_display && al_get_display_refresh_rate(t3f_display) > 0)
+			{
+				frame_time = 1.0 / al_get_display_refresh_rate(t3f_display);
+			}
+			if(frame_start + frame_time > al_get_time())
+			{
+				al_wait_for_event_timed(t3f_queue, NULL, frame_start + frame_time - al_get_time());
+			}
+		}
+		while(al_get_next_event(t3f_queue, &event))
+		{
+			/* timer events only wake us up, the clock decides when logic runs */
+			if(event.type == ALLEGRO_EVENT_TIMER && event.timer.source == t3f_timer)
+			{
+				continue;
+			}
+			t3f_dispatch_event(&event);
+		}
+		if(t3f_halted)
+		{
+			if(t3f_halted == 1)
+			{
+				al_acknowledge_drawing_halt(t3f_display);
+				t3f_halted = 2;
+			}
+			last_time = al_get_time();
+			accumulator = 0.0;
+			continue;
+		}
+
+		current_time = al_get_time();
+		accumulator += current_time - last_time;
+		last_time = current_time;
+		for(ticks = 0; accumulator >= tick_time && ticks < max_ticks && !t3f_quit; ticks++)
+		{
+			t3f_timer_tick();
+			accumulator -= tick_time;
+		}
+		if(ticks)
+		{
+			interpolating = !t3f_frame_unchanged;
+		}
+
+		/* we are too far behind, drop the rest instead of spiraling */
+		if(accumulator >= tick_time)
+		{
+			dropped = accumulator / tick_time;
+			t3f_dropped_ticks += dropped;
+			accumulator -= tick_time * dropped;
+		}
+		t3f_interpolation_alpha = accumulator / tick_time;
+
+		/* nothing moves between two unchanged ticks so there is nothing to
+		   interpolate */
+		if(t3f_interpolated_render_proc && (interpolating || t3f_need_redraw))
+		{
+			frame_start = al_get_time();
+			t3f_render(true);
+		}
+		else if(t3f_need_redraw)
+		{
+			t3f_present();
+		}
+	}
+	al_stop_timer(t3f_timer);
+	while(!al_event_queue_is_empty(t3f_queue))
+	{
+		al_wait_for_event(t3f_queue, &event);
+	}
+}
+
+static void t3f_destroy_snapshots(void)
+{
+	int i;
+
+	for(i = 0; i < 3; i++)
+	{
+		if(t3f_snapshot[i])
+		{
+			al_free(t3f_snapshot[i]);
+			t3f_snapshot[i] = NULL;
+		}
+	}
+	if(t3f_snapshot_cond)
+	{
+		al_destroy_cond(t3f_snapshot_cond);
+		t3f_snapshot_cond = NULL;
+	}
+	if(t3f_snapshot_mutex)
+	{
+		al_destroy_mutex(t3f_snapshot_mutex);
+		t3f_snapshot_mutex = NULL;
+	}
+	t3f_snapshot_proc = NULL;
+	t3f_snapshot_render_proc = NULL;
+	t3f_snapshot_fresh = false;
+	t3f_snapshot_published = false;
+}
+
+/* set up state snapshots for T3F_RUN_MODE_THREADED, snapshot_proc is called
+   on the logic thread after each tick that changed something and copies
+   whatever render_proc needs into the snapshot, render_proc is called on the
+   render thread with the view that was current when the snapshot was taken
+   already selected and must only use the snapshot it is given, selecting
+   views from it isn't safe */
+bool t3f_set_snapshot_procs(size_t size, void (*snapshot_proc)(void * snapshot, void * data), void (*render_proc)(void * snapshot, void * data))
+{
+	int i;
+
+	t3f_destroy_snapshots();
+	if(!snapshot_proc || !render_proc)
+	{
+		return true;
+	}
+	for(i = 0; i < 3; i++)
+	{
+		t3f_snapshot[i] = al_malloc(size);
+		if(!t3f_snapshot[i])
+		{
+			goto fail;
+		}
+		memset(t3f_snapshot[i], 0, size);
+	}
+	t3f_snapshot_mutex = al_create_mutex();
+	if(!t3f_snapshot_mutex)
+	{
+		goto fail;
+	}
+	t3f_snapshot_cond = al_create_cond();
+	if(!t3f_snapshot_cond)
+	{
+		goto fail;
+	}
+	t3f_snapshot_write = 0;
+	t3f_snapshot_ready = 1;
+	t3f_snapshot_read = 2;
+	t3f_snapshot_proc = snapshot_proc;
+	t3f_snapshot_render_proc = render_proc;
+	return true;
+
+	fail:
+	{
+		t3f_destroy_snapshots();
+		return false;
+	}
+}
+
+/* fill in the write snapshot and swap it with the ready one, never waits on
+   the render thread */
+static void t3f_publish_snapshot(void)
+{
+	int i;
+
+	t3f_snapshot_proc(t3f_snapshot[t3f_snapshot_write], t3f_user_data);
+	memcpy(&t3f_snapshot_view[t3f_snapshot_write], t3f_current_view, sizeof(T3F_VIEW));
+	al_copy_transform(&t3f_snapshot_transform[t3f_snapshot_write], &t3f_current_transform);
+	al_lock_mutex(t3f_snapshot_mutex);
+	i = t3f_snapshot_ready;
+	t3f_snapshot_ready = t3f_snapshot_write;
+	t3f_snapshot_write = i;
+	t3f_snapshot_fresh = true;
+	t3f_snapshot_published = true;
+	al_signal_cond(t3f_snapshot_cond);
+	al_unlock_mutex(t3f_snapshot_mutex);
+}
+
+static void * t3f_render_thread_proc(ALLEGRO_THREAD * thread, void * arg)
+{
+	int i;
+
+	al_set_target_backbuffer(t3f_display);
+	t3f_create_frame_arena(0);
+	while(1)
+	{
+		al_lock_mutex(t3f_snapshot_mutex);
+		while(!t3f_snapshot_fresh && !al_get_thread_should_stop(thread))
+		{
+			al_wait_cond(t3f_snapshot_cond, t3f_snapshot_mutex);
+		}
+		if(al_get_thread_should_stop(thread))
+		{
+			al_unlock_mutex(t3f_snapshot_mutex);
+			break;
+		}
+		i = t3f_snapshot_read;
+		t3f_snapshot_read = t3f_snapshot_ready;
+		t3f_snapshot_ready = i;
+		t3f_snapshot_fresh = false;
+		al_unlock_mutex(t3f_snapshot_mutex);
+
+		t3f_render_snapshot(t3f_snapshot_read);
+		t3f_flip();
+		t3f_reset_frame_arena();
+	}
+	t3f_destroy_frame_arena();
+
+	/* give the display back to the main thread */
+	al_set_target_bitmap(NULL);
+	return NULL;
+}
+
+/* the render thread owns the display while it is running */
+static bool t3f_start_render_thread(void)
+{
+	al_set_target_bitmap(NULL);
+	al_lock_mutex(t3f_snapshot_mutex);
+	t3f_snapshot_fresh = t3f_snapshot_published;
+	al_unlock_mutex(t3f_snapshot_mutex);
+	t3f_render_thread = al_create_thread(t3f_render_thread_proc, NULL);
+	if(!t3f_render_thread)
+	{
+		al_set_target_backbuffer(t3f_display);
+		return false;
+	}
+	al_start_thread(t3f_render_thread);
+	return true;
+}
+
+static void t3f_stop_render_thread(void)
+{
+	if(t3f_render_thread)
+	{
+		al_set_thread_should_stop(t3f_render_thread);
+		al_lock_mutex(t3f_snapshot_mutex);
+		al_broadcast_cond(t3f_snapshot_cond);
+		al_unlock_mutex(t3f_snapshot_mutex);
+		al_destroy_thread(t3f_render_thread);
+		t3f_render_thread = NULL;
+		al_set_target_backbuffer(t3f_display);
+		t3f_select_view(t3f_current_view);
+	}
+}
+
+/* events that need the display have to be handled while we own it */
+static bool t3f_event_needs_display(ALLEGRO_EVENT * event)
+{
+	switch(event->type)
+	{
+		case ALLEGRO_EVENT_DISPLAY_RESIZE:
+		case ALLEGRO_EVENT_DISPLAY_FOUND:
+		case ALLEGRO_EVENT_DISPLAY_HALT_DRAWING:
+		case ALLEGRO_EVENT_DISPLAY_RESUME_DRAWING:
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/* logic runs on this thread and publishes snapshots, a separate thread draws
+   the newest one so a slow flip doesn't hold up logic */
+static void t3f_run_threaded(void)
+{
+	ALLEGRO_EVENT event;
+	bool loading = false; // we took the display back to finish loads
+
+	al_start_timer(t3f_timer);
+	t3f_start_render_thread();
+	while(!t3f_quit)
+	{
+		/* call queued up procudure */
+		if(t3f_queued_call_proc)
+		{
+			t3f_stop_render_thread();
+			t3f_queued_call_proc(t3f_queued_call_data);
+			t3f_queued_call_proc = NULL;
+			t3f_queued_call_data = NULL;
+			if(!t3f_halted && !loading)
+			{
+				t3f_start_render_thread();
+			}
+		}
 		al_wait_for_event(t3f_queue, &event);
-		if(t3f_event_handler_proc)
+		if(t3f_event_needs_display(&event))
 		{
-			t3f_event_handler_proc(&event, t3f_user_data);
+			t3f_stop_render_thread();
+			t3f_dispatch_event(&event);
+			if(!t3f_halted && !loading)
+			{
+				t3f_start_render_thread();
+			}
 		}
 		else
 		{
-			t3f_event_handler(&event);
+			t3f_dispatch_event(&event);
 		}
 
+		/* the logic tick left finishing loads and recoveries to us, they
+		   need the display so take it back once and keep it, the logic tick
+		   finishes them while we draw the frames, until nothing is left */
+		if(event.type == ALLEGRO_EVENT_TIMER)
+		{
+			if(t3f_render_thread && (t3f_loads_waiting() || t3f_get_pending_recoveries()))
+			{
+				t3f_stop_render_thread();
+				t3f_update_loads();
+				loading = true;
+			}
+			else if(loading && !t3f_get_pending_loads() && !t3f_get_pending_recoveries())
+			{
+				loading = false;
+				if(!t3f_halted)
+				{
+					t3f_start_render_thread();
+				}
+			}
+		}
+
+		/* hand the new state to the render thread */
+		if(t3f_need_redraw && !t3f_halted)
+		{
+			t3f_publish_snapshot();
+			t3f_need_redraw = false;
+
+			/* we have the display or couldn't start the render thread, draw
+			   it ourselves */
+			if(!t3f_render_thread)
+			{
+				t3f_render_snapshot(t3f_snapshot_ready);
+				t3f_flip();
+			}
+		}
+		if(t3f_halted == 1)
+		{
+			al_acknowledge_drawing_halt(t3f_display);
+			t3f_halted = 2;
+		}
+	}
+	t3f_stop_render_thread();
+	al_stop_timer(t3f_timer);
+	while(!al_event_queue_is_empty(t3f_queue))
+	{
+		al_wait_for_event(t3f_queue, &event);
+	}
+}
+
+/* this function is where it's at
+   somewhere in your logic code you need to set t3f_quit = true to exit */
+void t3f_run(void)
+{
+	ALLEGRO_EVENT event;
+
+	if(t3f_option[T3F_OPTION_RUN_MODE] == T3F_RUN_MODE_FIXED_STEP)
+	{
+		t3f_run_fixed_step();
+		return;
+	}
+	if(t3f_option[T3F_OPTION_RUN_MODE] == T3F_RUN_MODE_THREADED && t3f_snapshot_proc && t3f_display)
+	{
+		t3f_run_threaded();
+		return;
+	}
+	al_start_timer(t3f_timer);
+	while(!t3f_quit)
+	{
+		/* call queued up procudure */
+		if(t3f_queued_call_proc)
+		{
+			t3f_queued_call_proc(t3f_queued_call_data);
+			t3f_queued_call_proc = NULL;
+			t3f_queued_call_data = NULL;
+		}
+		al_wait_for_event(t3f_queue, &event);
+		t3f_dispatch_event(&event);
+
        	/* draw after we have run all the logic */
 		if(t3f_need_redraw && al_event_queue_is_empty(t3f_queue))
 		{
-			t3f_render(true);
+			t3f_present();
 		}
 		if(t3f_halted == 1)
 		{
@@ -1485,6 +2176,12 @@ void t3f_run(void)
 void t3f_finish(void)
 {
 	t3f_save_config();
+	t3f_destroy_frame_cache();
+	t3f_destroy_snapshots();
+	t3f_shutdown_loader();
+	t3f_shutdown_job_system();
+	t3f_shutdown_profiler();
+	t3f_destroy_frame_arena();
 	if(t3f_timer)
 	{
 		al_destroy_timer(t3f_timer);
@@ -1497,7 +2194,11 @@ void t3f_finish(void)
 	{
 		al_destroy_event_queue(t3f_queue);
 	}
-	t3f_stop_music();
+	t3f_shutdown_music();
+
+	/* every thread that opens trace zones has stopped by now */
+	t3f_shutdown_trace();
+	t3f_unmount_packs();
 	if(t3f_developer_name)
 	{
 		free(t3f_developer_name);
@@ -34,12 +34,20 @@
 #define T3F_USE_MENU           2048
 #define T3F_NO_SCALE           4096
 #define T3F_USE_FIXED_PIPELINE 8192
-#define T3F_DEFAULT (T3F_USE_KEYBOARD | T3F_USE_MOUSE | T3F_USE_JOYSTICK | T3F_USE_TOUCH | T3F_USE_SOUND | T3F_FORCE_ASPECT)
+#define T3F_USE_JOBS          16384 // start the job system so loads and recovery happen in the background
+#define T3F_DEFAULT (T3F_USE_KEYBOARD | T3F_USE_MOUSE | T3F_USE_JOYSTICK | T3F_USE_TOUCH | T3F_USE_SOUND | T3F_FORCE_ASPECT | T3F_USE_JOBS)
 
 #define T3F_MAX_OPTIONS                 64
 #define T3F_OPTION_RENDER_MODE           0
 	#define T3F_RENDER_MODE_NORMAL       0
 	#define T3F_RENDER_MODE_ALWAYS_CLEAR 1
+#define T3F_OPTION_RUN_MODE              1
+	#define T3F_RUN_MODE_EVENT           0
+	#define T3F_RUN_MODE_FIXED_STEP      1
+	#define T3F_RUN_MODE_THREADED        2
+#define T3F_OPTION_MAX_CATCH_UP_TICKS    2
+
+#define T3F_DEFAULT_MAX_CATCH_UP_TICKS   5
 
 #define T3F_KEY_BUFFER_MAX 256
 #define T3F_KEY_BUFFER_FORCE_LOWER 1
@@ -51,6 +59,13 @@
 
 #define T3F_MAX_STACK     16
 
+/* per-thread storage for modules that are used from several threads */
+#ifdef _MSC_VER
+	#define T3F_THREAD_LOCAL __declspec(thread)
+#else
+	#define T3F_THREAD_LOCAL __thread
+#endif
+
 typedef struct
 {
 
@@ -65,6 +80,7 @@ typedef struct
 /* include all T3F modules */
 #include "android.h"
 #include "animation.h"
+#include "arena.h"
 #include "atlas.h"
 #include "bitmap.h"
 #include "collision.h"
@@ -73,16 +89,23 @@ typedef struct
 #include "draw.h"
 #include "font.h"
 #include "gui.h"
+#include "job.h"
+#include "lighting.h"
+#include "loader.h"
 #include "memory.h"
 #ifndef ALLEGRO_ANDROID
     #include "menu.h"
 #endif
 #include "music.h"
+#include "pack.h"
+#include "pool.h"
 #include "primitives.h"
+#include "profile.h"
 #include "resource.h"
 #include "rng.h"
 #include "sound.h"
 #include "tilemap.h"
+#include "trace.h"
 #include "vector.h"
 #include "view.h"
 
@@ -131,6 +154,13 @@ void t3f_exit(void);
 bool t3f_save_config(void);
 void t3f_event_handler(ALLEGRO_EVENT * event);
 void t3f_process_events(bool ignore);
+void t3f_set_frame_unchanged(void);
+void t3f_request_redraw(void);
+void t3f_enable_frame_cache(bool enable);
+void t3f_set_interpolated_render_proc(void (*proc)(void * data, float alpha));
+float t3f_get_interpolation_alpha(void);
+unsigned long t3f_get_dropped_ticks(void);
+bool t3f_set_snapshot_procs(size_t size, void (*snapshot_proc)(void * snapshot, void * data), void (*render_proc)(void * snapshot, void * data));
 void t3f_render(bool flip);
 void t3f_run(void);
 void t3f_finish(void);
@@ -18,6 +18,8 @@ T3F_TILE * t3f_create_tile(void)
 	return tp;
 }
 
+/* tiles belonging to a tileset are pooled, only use this on tiles made with
+   t3f_create_tile() */
 void t3f_destroy_tile(T3F_TILE * tp)
 {
 	t3f_destroy_animation(tp->ap);
@@ -50,6 +52,7 @@ T3F_TILESET * t3f_create_tileset(int w, int h)
 		return NULL;
 	}
 	tsp->atlas = NULL;
+	tsp->tile_pool = NULL;
 	tsp->tiles = 0;
 	tsp->width = w;
 	tsp->height = h;
@@ -62,7 +65,18 @@ void t3f_destroy_tileset(T3F_TILESET * tsp)
 
 	for(i = 0; i < tsp->tiles; i++)
 	{
-		t3f_destroy_tile(tsp->tile[i]);
+		if(t3f_pool_owns(tsp->tile_pool, tsp->tile[i]))
+		{
+			t3f_destroy_animation(tsp->tile[i]->ap);
+		}
+		else
+		{
+			t3f_destroy_tile(tsp->tile[i]);
+		}
+	}
+	if(tsp->tile_pool)
+	{
+		t3f_destroy_pool(tsp->tile_pool);
 	}
 	if(tsp->atlas)
 	{
@@ -71,7 +85,28 @@ void t3f_destroy_tileset(T3F_TILESET * tsp)
 	free(tsp);
 }
 
-T3F_TILESET * t3f_load_tileset_f(ALLEGRO_FILE * fp, const char * fn)
+static T3F_TILE * create_tileset_tile(T3F_TILESET * tsp, int slab_tiles)
+{
+	T3F_TILE * tp;
+
+	if(!tsp->tile_pool)
+	{
+		tsp->tile_pool = t3f_create_pool(sizeof(T3F_TILE), slab_tiles > 0 ? slab_tiles : T3F_TILE_SLAB);
+		if(!tsp->tile_pool)
+		{
+			return NULL;
+		}
+	}
+	tp = t3f_pool_alloc(tsp->tile_pool);
+	if(!tp)
+	{
+		return NULL;
+	}
+	memset(tp, 0, sizeof(T3F_TILE));
+	return tp;
+}
+
+static T3F_TILESET * load_tileset_f(ALLEGRO_FILE * fp, const char * fn)
 {
 	int i, j;
 	T3F_TILESET * tsp;
@@ -96,7 +131,11 @@ T3F_TILESET * t3f_load_tileset_f(ALLEGRO_FILE * fp, const char * fn)
 			tsp->tiles = al_fread16le(fp);
 			for(i = 0; i < tsp->tiles; i++)
 			{
-				tsp->tile[i] = t3f_create_tile();
+				tsp->tile[i] = create_tileset_tile(tsp, tsp->tiles);
+				if(!tsp->tile[i])
+				{
+					return NULL;
+				}
 				tsp->tile[i]->ap = t3f_load_animation_f(fp, fn);
 				if(!tsp->tile[i]->ap)
 				{
@@ -133,6 +172,16 @@ T3F_TILESET * t3f_load_tileset_f(ALLEGRO_FILE * fp, const char * fn)
 	return tsp;
 }
 
+T3F_TILESET * t3f_load_tileset_f(ALLEGRO_FILE * fp, const char * fn)
+{
+	T3F_TILESET * tsp;
+
+	t3f_push_memory_tag(T3F_MEMORY_TAG_TILEMAP);
+	tsp = load_tileset_f(fp, fn);
+	t3f_pop_memory_tag();
+	return tsp;
+}
+
 T3F_TILESET * t3f_load_tileset(const char * fn)
 {
 	ALLEGRO_FILE * fp;
@@ -206,7 +255,7 @@ bool t3f_add_tile(T3F_TILESET * tsp, T3F_ANIMATION * ap)
 {
 	T3F_TILE * tp;
 
-	tp = t3f_create_tile();
+	tp = create_tileset_tile(tsp, T3F_TILE_SLAB);
 	if(!tp)
 	{
 		return false;
@@ -220,55 +269,71 @@ bool t3f_add_tile(T3F_TILESET * tsp, T3F_ANIMATION * ap)
 bool t3f_atlas_tileset(T3F_TILESET * tsp)
 {
 	int tile_sheet_size = 1024; // may want to calculate this from the tile data for an optimization
-	int i;
-	bool fail = false;
+	ALLEGRO_BITMAP *** bitmap;
+	int i, j, count = 0;
+	bool ret;
 
 	tsp->atlas = t3f_create_atlas(tile_sheet_size, tile_sheet_size);
 	if(!tsp->atlas)
 	{
 		return false;
 	}
+
+	/* add every tile at once so the atlas can sort them */
+	for(i = 0; i < tsp->tiles; i++)
+	{
+		count += tsp->tile[i]->ap->bitmaps->count;
+	}
+	bitmap = al_malloc(sizeof(ALLEGRO_BITMAP **) * (count > 0 ? count : 1));
+	if(!bitmap)
+	{
+		return false;
+	}
+	count = 0;
 	for(i = 0; i < tsp->tiles; i++)
 	{
-		if(!t3f_add_animation_to_atlas(tsp->atlas, tsp->tile[i]->ap, T3F_ATLAS_TILE))
+		for(j = 0; j < tsp->tile[i]->ap->bitmaps->count; j++)
 		{
-			printf("sprite sheet failed\n");
-			fail = true;
+			bitmap[count] = &tsp->tile[i]->ap->bitmaps->bitmap[j];
+			count++;
 		}
 	}
-	return true;
+	ret = t3f_add_bitmaps_to_atlas(tsp->atlas, bitmap, count, T3F_ATLAS_TILE);
+	al_free(bitmap);
+	if(!ret)
+	{
+		printf("sprite sheet failed\n");
+	}
+	return ret;
 }
 
 T3F_TILEMAP_LAYER * t3f_create_tilemap_layer(int w, int h)
 {
 	T3F_TILEMAP_LAYER * tlp;
-	int i, j;
+	int i;
 
 	tlp = malloc(sizeof(T3F_TILEMAP_LAYER));
 	if(!tlp)
 	{
 		return NULL;
 	}
-	tlp->data = malloc(h * sizeof(short *));
+	/* an empty layer still gets a block so data[0] is always valid */
+	tlp->data = malloc((h > 0 ? h : 1) * sizeof(short *));
 	if(!tlp->data)
 	{
 		free(tlp);
 		return NULL;
 	}
-	for(i = 0; i < h; i++)
+	tlp->data[0] = calloc(w * h > 0 ? w * h : 1, sizeof(short));
+	if(!tlp->data[0])
 	{
-		tlp->data[i] = malloc(w * sizeof(short));
-		if(!tlp->data[i])
-		{
-			return NULL;
-		}
+		free(tlp->data);
+		free(tlp);
+		return NULL;
 	}
-	for(i = 0; i < h; i++)
+	for(i = 1; i < h; i++)
 	{
-		for(j = 0; j < w; j++)
-		{
-			tlp->data[i][j] = 0;
-		}
+		tlp->data[i] = tlp->data[0] + i * w;
 	}
 	tlp->bitmap = 0;
 	tlp->width = w;
@@ -285,11 +350,7 @@ T3F_TILEMAP_LAYER * t3f_create_tilemap_layer(int w, int h)
 
 void t3f_destroy_tilemap_layer(T3F_TILEMAP_LAYER * tlp)
 {
-	int i;
-	for(i = 0; i < tlp->height; i++)
-	{
-		free(tlp->data[i]);
-	}
+	free(tlp->data[0]);
 	free(tlp->data);
 	free(tlp);
 }
@@ -325,7 +386,7 @@ void t3f_destroy_tilemap(T3F_TILEMAP * tmp)
 	free(tmp);
 }
 
-T3F_TILEMAP * t3f_load_tilemap_f(ALLEGRO_FILE * fp)
+static T3F_TILEMAP * load_tilemap_f(ALLEGRO_FILE * fp)
 {
 	int i, j, k, w, h;
 	T3F_TILEMAP * tmp;
@@ -348,7 +409,6 @@ T3F_TILEMAP * t3f_load_tilemap_f(ALLEGRO_FILE * fp)
 			tmp->layers = al_fread16le(fp);
 			for(i = 0; i < tmp->layers; i++)
 			{
-				tmp->layer[i] = malloc(sizeof(T3F_TILEMAP_LAYER));
 				w = al_fread16le(fp);
 				h = al_fread16le(fp);
 				tmp->layer[i] = t3f_create_tilemap_layer(w, h);
@@ -374,6 +434,16 @@ T3F_TILEMAP * t3f_load_tilemap_f(ALLEGRO_FILE * fp)
 	return tmp;
 }
 
+T3F_TILEMAP * t3f_load_tilemap_f(ALLEGRO_FILE * fp)
+{
+	T3F_TILEMAP * tmp;
+
+	t3f_push_memory_tag(T3F_MEMORY_TAG_TILEMAP);
+	tmp = load_tilemap_f(fp);
+	t3f_pop_memory_tag();
+	return tmp;
+}
+
 T3F_TILEMAP * t3f_load_tilemap(const char * fn)
 {
 	ALLEGRO_FILE * fp;
@@ -588,6 +658,7 @@ static void t3f_render_normal_tilemap(T3F_TILEMAP * tmp, T3F_TILESET * tsp, int
    figure the dimensions (in tiles) of the screen (including partially visible tiles) */
 void t3f_render_tilemap(T3F_TILEMAP * tmp, T3F_TILESET * tsp, int layer, int tick, float ox, float oy, float oz, ALLEGRO_COLOR color)
 {
+	T3F_TRACE_BEGIN("render_tilemap");
 	if(tmp->layer[layer]->flags & T3F_TILEMAP_LAYER_STATIC)
 	{
 		t3f_render_static_tilemap(tmp, tsp, layer, tick, ox, oy, oz, color);
@@ -596,4 +667,5 @@ void t3f_render_tilemap(T3F_TILEMAP * tmp, T3F_TILESET * tsp, int layer, int tic
 	{
 		t3f_render_normal_tilemap(tmp, tsp, layer, tick, ox, oy, oz, color);
 	}
+	T3F_TRACE_END();
 }
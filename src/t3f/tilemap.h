@@ -13,6 +13,7 @@
 #define T3F_TILE_MAX_DATA       16
 #define T3F_MAX_TILE_SHEETS     16
 #define T3F_MAX_TILESET_BITMAPS 16
+#define T3F_TILE_SLAB           64
 
 #define T3F_TILE_FLAG_ANIMATED   1
 #define T3F_TILE_FLAG_ONCE       2
@@ -43,6 +44,7 @@ typedef struct
 	T3F_ATLAS * atlas;
 
 	T3F_TILE * tile[T3F_MAX_TILES];
+	T3F_POOL * tile_pool;
 	int tiles;
 	int width;
 	int height;
@@ -53,7 +55,7 @@ typedef struct
 typedef struct
 {
 
-	/* map data */
+	/* map data, rows point into one block */
 	short ** data;
 	int width;
 	int height;
@@ -0,0 +1,199 @@
+#include "t3f.h"
+#include "trace.h"
+
+/* zones are written in the Chrome trace event format, load the file in
+   chrome://tracing or Perfetto to view it */
+
+typedef struct
+{
+
+	const char * name; // NULL for the end of a zone
+	double time;
+
+} T3F_TRACE_EVENT;
+
+typedef struct T3F_TRACE_BUFFER T3F_TRACE_BUFFER;
+
+struct T3F_TRACE_BUFFER
+{
+
+	ALLEGRO_MUTEX * mutex; // only contended while the buffer is being written out
+	T3F_TRACE_EVENT event[T3F_TRACE_BUFFER_SIZE];
+	int events;
+	int tid;
+	T3F_TRACE_BUFFER * next;
+
+};
+
+bool t3f_trace_enabled = false;
+static ALLEGRO_MUTEX * t3f_trace_mutex = NULL; // protects the file and the buffer list
+static ALLEGRO_FILE * t3f_trace_file = NULL;
+static double t3f_trace_start_time = 0.0;
+static unsigned long t3f_trace_written = 0;
+static T3F_TRACE_BUFFER * t3f_trace_buffers = NULL;
+static int t3f_trace_threads = 0;
+
+/* buffers live until t3f_shutdown_trace() so a thread never loses its
+   buffer while it is using it */
+static T3F_THREAD_LOCAL T3F_TRACE_BUFFER * t3f_trace_buffer = NULL;
+
+static T3F_TRACE_BUFFER * get_trace_buffer(void)
+{
+	T3F_TRACE_BUFFER * bp;
+
+	if(t3f_trace_buffer)
+	{
+		return t3f_trace_buffer;
+	}
+	bp = malloc(sizeof(T3F_TRACE_BUFFER));
+	if(!bp)
+	{
+		return NULL;
+	}
+	bp->mutex = al_create_mutex();
+	if(!bp->mutex)
+	{
+		free(bp);
+		return NULL;
+	}
+	bp->events = 0;
+	al_lock_mutex(t3f_trace_mutex);
+	bp->tid = ++t3f_trace_threads;
+	bp->next = t3f_trace_buffers;
+	t3f_trace_buffers = bp;
+	al_unlock_mutex(t3f_trace_mutex);
+	t3f_trace_buffer = bp;
+	return bp;
+}
+
+/* caller holds the buffer's mutex */
+static void flush_trace_buffer(T3F_TRACE_BUFFER * bp)
+{
+	T3F_TRACE_EVENT * ep;
+	int i;
+
+	al_lock_mutex(t3f_trace_mutex);
+	if(t3f_trace_file)
+	{
+		for(i = 0; i < bp->events; i++)
+		{
+			ep = &bp->event[i];
+			if(t3f_trace_written)
+			{
+				al_fputs(t3f_trace_file, ",\n");
+			}
+			if(ep->name)
+			{
+				al_fprintf(t3f_trace_file, "{\"name\":\"%s\",\"ph\":\"B\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", ep->name, bp->tid, (ep->time - t3f_trace_start_time) * 1000000.0);
+			}
+			else
+			{
+				al_fprintf(t3f_trace_file, "{\"ph\":\"E\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", bp->tid, (ep->time - t3f_trace_start_time) * 1000000.0);
+			}
+			t3f_trace_written++;
+		}
+	}
+	al_unlock_mutex(t3f_trace_mutex);
+	bp->events = 0;
+}
+
+static void add_trace_event(const char * name)
+{
+	T3F_TRACE_BUFFER * bp = get_trace_buffer();
+
+	if(!bp)
+	{
+		return;
+	}
+	al_lock_mutex(bp->mutex);
+	if(bp->events >= T3F_TRACE_BUFFER_SIZE)
+	{
+		flush_trace_buffer(bp);
+	}
+	bp->event[bp->events].name = name;
+	bp->event[bp->events].time = al_get_time();
+	bp->events++;
+	al_unlock_mutex(bp->mutex);
+}
+
+bool t3f_start_trace(const char * fn)
+{
+	if(!t3f_trace_mutex)
+	{
+		t3f_trace_mutex = al_create_mutex();
+		if(!t3f_trace_mutex)
+		{
+			return false;
+		}
+	}
+	t3f_stop_trace();
+	al_lock_mutex(t3f_trace_mutex);
+	t3f_trace_file = al_fopen(fn, "w");
+	if(t3f_trace_file)
+	{
+		al_fputs(t3f_trace_file, "{\"traceEvents\":[\n");
+		t3f_trace_written = 0;
+		t3f_trace_start_time = al_get_time();
+		t3f_trace_enabled = true;
+	}
+	al_unlock_mutex(t3f_trace_mutex);
+	return t3f_trace_file != NULL;
+}
+
+/* write out what every thread has recorded and close the file */
+void t3f_stop_trace(void)
+{
+	T3F_TRACE_BUFFER * bp;
+
+	if(!t3f_trace_mutex || !t3f_trace_file)
+	{
+		return;
+	}
+	t3f_trace_enabled = false;
+	al_lock_mutex(t3f_trace_mutex);
+	bp = t3f_trace_buffers;
+	al_unlock_mutex(t3f_trace_mutex);
+	while(bp)
+	{
+		al_lock_mutex(bp->mutex);
+		flush_trace_buffer(bp);
+		al_unlock_mutex(bp->mutex);
+		bp = bp->next;
+	}
+	al_lock_mutex(t3f_trace_mutex);
+	al_fputs(t3f_trace_file, "\n]}\n");
+	al_fclose(t3f_trace_file);
+	t3f_trace_file = NULL;
+	al_unlock_mutex(t3f_trace_mutex);
+}
+
+/* only call this once no other threads are tracing */
+void t3f_shutdown_trace(void)
+{
+	T3F_TRACE_BUFFER * bp;
+
+	t3f_stop_trace();
+	while(t3f_trace_buffers)
+	{
+		bp = t3f_trace_buffers;
+		t3f_trace_buffers = bp->next;
+		al_destroy_mutex(bp->mutex);
+		free(bp);
+	}
+	t3f_trace_buffer = NULL;
+	if(t3f_trace_mutex)
+	{
+		al_destroy_mutex(t3f_trace_mutex);
+		t3f_trace_mutex = NULL;
+	}
+}
+
+void t3f_trace_begin(const char * name)
+{
+	add_trace_event(name);
+}
+
+void t3f_trace_end(void)
+{
+	add_trace_event(NULL);
+}
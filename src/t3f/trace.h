@@ -0,0 +1,23 @@
+#ifndef T3F_TRACE_H
+#define T3F_TRACE_H
+
+#include <allegro5/allegro5.h>
+
+#define T3F_TRACE_BUFFER_SIZE 4096 // events a thread holds before writing them out
+
+extern bool t3f_trace_enabled;
+
+/* mark the start and end of a zone, zones nest and must be closed on the
+   thread that opened them, name has to stay valid until the trace is
+   stopped so pass a string literal */
+#define T3F_TRACE_BEGIN(name) do { if(t3f_trace_enabled) { t3f_trace_begin(name); } } while(0)
+#define T3F_TRACE_END() do { if(t3f_trace_enabled) { t3f_trace_end(); } } while(0)
+
+bool t3f_start_trace(const char * fn);
+void t3f_stop_trace(void);
+void t3f_shutdown_trace(void);
+
+void t3f_trace_begin(const char * name);
+void t3f_trace_end(void);
+
+#endif
@@ -13,6 +13,7 @@ T3F_VECTOR_OBJECT * t3f_create_vector_object(void)
 	{
 		return NULL;
 	}
+	vp->segment_pool = NULL;
 	vp->segments = 0;
 	return vp;
 }
@@ -23,7 +24,14 @@ void t3f_destroy_vector_object(T3F_VECTOR_OBJECT * vp)
 
 	for(i = 0; i < vp->segments; i++)
 	{
-		free(vp->segment[i]);
+		if(!t3f_pool_owns(vp->segment_pool, vp->segment[i]))
+		{
+			free(vp->segment[i]);
+		}
+	}
+	if(vp->segment_pool)
+	{
+		t3f_destroy_pool(vp->segment_pool);
 	}
 	free(vp);
 }
@@ -34,7 +42,15 @@ bool t3f_add_vector_segment(T3F_VECTOR_OBJECT * vp, float sx, float sy, float sz
 	{
 		return false;
 	}
-	vp->segment[vp->segments] = malloc(sizeof(T3F_VECTOR_SEGMENT));
+	if(!vp->segment_pool)
+	{
+		vp->segment_pool = t3f_create_pool(sizeof(T3F_VECTOR_SEGMENT), T3F_VECTOR_SEGMENT_SLAB);
+		if(!vp->segment_pool)
+		{
+			return false;
+		}
+	}
+	vp->segment[vp->segments] = t3f_pool_alloc(vp->segment_pool);
 	if(!vp->segment[vp->segments])
 	{
 		return false;
@@ -57,7 +73,14 @@ bool t3f_remove_vector_segment(T3F_VECTOR_OBJECT * vp, unsigned int segment)
 
 	if((int)segment < vp->segments)
 	{
-		free(vp->segment[segment]);
+		if(t3f_pool_owns(vp->segment_pool, vp->segment[segment]))
+		{
+			t3f_pool_free(vp->segment_pool, vp->segment[segment]);
+		}
+		else
+		{
+			free(vp->segment[segment]);
+		}
 		for(i = segment; i < vp->segments - 1; i++)
 		{
 			vp->segment[i] = vp->segment[i + 1];
@@ -94,7 +117,7 @@ void t3f_destroy_vector_font(T3F_VECTOR_FONT * vfp)
 	{
 		if(vfp->character[i])
 		{
-			free(vfp->character[i]->object);
+			t3f_destroy_vector_object(vfp->character[i]->object);
 			free(vfp->character[i]);
 		}
 	}
@@ -115,7 +138,7 @@ bool t3f_add_vector_character(T3F_VECTOR_FONT * vfp, unsigned int character, T3F
 
 bool t3f_remove_vector_character(T3F_VECTOR_FONT * vp, unsigned int character)
 {
-	free(vp->character[character]->object);
+	t3f_destroy_vector_object(vp->character[character]->object);
 	free(vp->character[character]);
 	vp->character[character] = NULL;
 	return true;
@@ -6,9 +6,11 @@
 #endif
 
 #include <allegro5/allegro5.h>
+#include "pool.h"
 
 #define T3F_VECTOR_OBJECT_MAX_SEGMENTS 256
 #define T3F_VECTOR_FONT_MAX_CHARACTERS 256
+#define T3F_VECTOR_SEGMENT_SLAB         32
 
 typedef struct
 {
@@ -30,6 +32,7 @@ typedef struct
 {
 
 	T3F_VECTOR_SEGMENT * segment[T3F_VECTOR_OBJECT_MAX_SEGMENTS];
+	T3F_POOL * segment_pool;
 	int segments;
 	
 } T3F_VECTOR_OBJECT;
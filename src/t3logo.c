@@ -0,0 +1,487 @@
+#include "t3f/t3f.h"
+#include "t3logo.h"
+
+#define _T3LOGO_TARGET_TILT  (0.5)
+#define _T3LOGO_TARGET_ANGLE (ALLEGRO_PI * 2.25)
+#define _T3LOGO_LIGHT_ANGLE  (ALLEGRO_PI * 1.25)
+#define _T3LOGO_AMBIENT 0.75
+#define _T3LOGO_BOTTOM 1.595
+#define _T3LOGO_BAR_BOTTOM -1.235
+#define _T3LOGO_BASE_COLOR al_map_rgb(46, 104, 158)
+#define _T3LOGO_SCALE 47.75
+#define _T3LOGO_FADE_IN 0.015
+#define _T3LOGO_FLASH_ALPHA 0.75
+#define _T3LOGO_SPIN_TICKS 60
+#define _T3LOGO_SPIN_SETTLE_TICKS 8
+#define _T3LOGO_EPSILON 0.0001
+#define _T3LOGO_Y_OFFSET 26
+
+#define _T3LOGO_BITMAP_SIZE 540
+
+#define _T3LOGO_AUTO_SPIN_TICK 300
+#define _T3LOGO_AUTO_EXIT_TICK 1200
+
+static void init_shape(T3LOGO_SHAPE * sp, ALLEGRO_VERTEX * vp)
+{
+	memset(sp, 0, sizeof(T3LOGO_SHAPE));
+	sp->transformed_vertex = vp;
+}
+
+/* the polar form of the vertex never changes, so work it out once here */
+static void add_vertex(T3LOGO_SHAPE * sp, float x, float y, float z)
+{
+	T3LOGO_VERTEX * vp = &sp->vertex[sp->vertex_count];
+
+	vp->x = x;
+	vp->y = y;
+	vp->z = z;
+	vp->angle = atan2(z, x);
+	vp->distance = hypot(x, z);
+	vp->sin_distance = sin(vp->angle) * vp->distance;
+	vp->cos_distance = cos(vp->angle) * vp->distance;
+	sp->vertex_count++;
+}
+
+static void build_shapes(T3LOGO * lp)
+{
+	int i;
+
+	init_shape(&lp->side[0], &lp->vertex[0 * T3LOGO_MAX_VERTICES]);
+	add_vertex(&lp->side[0], -3, -3, -3);
+	add_vertex(&lp->side[0], 3, -3, -3);
+	add_vertex(&lp->side[0], -3, _T3LOGO_BAR_BOTTOM, -3);
+	add_vertex(&lp->side[0], 3, -3, -3);
+	add_vertex(&lp->side[0], 3, _T3LOGO_BAR_BOTTOM, -3);
+	add_vertex(&lp->side[0], -3, _T3LOGO_BAR_BOTTOM, -3);
+	add_vertex(&lp->side[0], -1, _T3LOGO_BAR_BOTTOM, -3);
+	add_vertex(&lp->side[0], 1, _T3LOGO_BAR_BOTTOM, -3);
+	add_vertex(&lp->side[0], -1, _T3LOGO_BOTTOM, -3);
+	add_vertex(&lp->side[0], 1, _T3LOGO_BAR_BOTTOM, -3);
+	add_vertex(&lp->side[0], 1, _T3LOGO_BOTTOM, -3);
+	add_vertex(&lp->side[0], -1, _T3LOGO_BOTTOM, -3);
+
+	init_shape(&lp->side[1], &lp->vertex[1 * T3LOGO_MAX_VERTICES]);
+	add_vertex(&lp->side[1], 3, -3, -3);
+	add_vertex(&lp->side[1], 3, -3, 3);
+	add_vertex(&lp->side[1], 3, _T3LOGO_BAR_BOTTOM, -3);
+	add_vertex(&lp->side[1], 3, -3, 3);
+	add_vertex(&lp->side[1], 3, _T3LOGO_BAR_BOTTOM, 3);
+	add_vertex(&lp->side[1], 3, _T3LOGO_BAR_BOTTOM, -3);
+	add_vertex(&lp->side[1], 3, _T3LOGO_BAR_BOTTOM, -1);
+	add_vertex(&lp->side[1], 3, _T3LOGO_BAR_BOTTOM, 1);
+	add_vertex(&lp->side[1], 3, _T3LOGO_BOTTOM, -1);
+	add_vertex(&lp->side[1], 3, _T3LOGO_BAR_BOTTOM, 1);
+	add_vertex(&lp->side[1], 3, _T3LOGO_BOTTOM, 1);
+	add_vertex(&lp->side[1], 3, _T3LOGO_BOTTOM, -1);
+
+	init_shape(&lp->side[2], &lp->vertex[2 * T3LOGO_MAX_VERTICES]);
+	add_vertex(&lp->side[2], -3, -3, 3);
+	add_vertex(&lp->side[2], 3, -3, 3);
+	add_vertex(&lp->side[2], -3, _T3LOGO_BAR_BOTTOM, 3);
+	add_vertex(&lp->side[2], 3, -3, 3);
+	add_vertex(&lp->side[2], 3, _T3LOGO_BAR_BOTTOM, 3);
+	add_vertex(&lp->side[2], -3, _T3LOGO_BAR_BOTTOM, 3);
+	add_vertex(&lp->side[2], -1, _T3LOGO_BAR_BOTTOM, 3);
+	add_vertex(&lp->side[2], 1, _T3LOGO_BAR_BOTTOM, 3);
+	add_vertex(&lp->side[2], -1, _T3LOGO_BOTTOM, 3);
+	add_vertex(&lp->side[2], 1, _T3LOGO_BAR_BOTTOM, 3);
+	add_vertex(&lp->side[2], 1, _T3LOGO_BOTTOM, 3);
+	add_vertex(&lp->side[2], -1, _T3LOGO_BOTTOM, 3);
+
+	lp->vertex_count = 0;
+	for(i = 0; i < T3LOGO_SIDES; i++)
+	{
+		lp->side_zsort[i] = &lp->side[i];
+		lp->vertex_count += lp->side[i].vertex_count;
+	}
+}
+
+/* rotate the shape by expanding sin/cos(vertex angle + angle) so we only need
+   the sine and cosine of the logo angle, which the caller works out once */
+static void set_shape_orientation(T3LOGO_SHAPE * sp, T3F_LIGHT_RAMP * rp, float ox, float oy, float sin_angle, float cos_angle, float tilt, float scale)
+{
+	int i;
+	float vsin, vcos;
+	float temp_z;
+
+	sp->z_depth = 1000000;
+	sp->color = t3f_get_light_ramp_color(rp, sp->angle);
+	for(i = 0; i < sp->vertex_count; i++)
+	{
+		vsin = sp->vertex[i].sin_distance;
+		vcos = sp->vertex[i].cos_distance;
+		temp_z = vsin * cos_angle + vcos * sin_angle;
+		if(temp_z < sp->z_depth)
+		{
+			sp->z_depth = temp_z;
+		}
+		sp->transformed_vertex[i].x = ox + (vcos * cos_angle - vsin * sin_angle) * scale;
+		sp->transformed_vertex[i].y = oy + (sp->vertex[i].y + temp_z * tilt) * scale;
+		sp->transformed_vertex[i].z = 0;
+		sp->transformed_vertex[i].u = 0;
+		sp->transformed_vertex[i].v = 0;
+		sp->transformed_vertex[i].color = sp->color;
+	}
+}
+
+static void sort_sides(T3LOGO * lp)
+{
+	T3LOGO_SHAPE * temp;
+	int i, j;
+
+	/* insertion sort, there are only three sides */
+	for(i = 1; i < T3LOGO_SIDES; i++)
+	{
+		temp = lp->side_zsort[i];
+		for(j = i; j > 0 && lp->side_zsort[j - 1]->z_depth > temp->z_depth; j--)
+		{
+			lp->side_zsort[j] = lp->side_zsort[j - 1];
+		}
+		lp->side_zsort[j] = temp;
+	}
+}
+
+static float get_acceleration(float distance, float t)
+{
+	return (2.0 * distance) / (t * t);
+}
+
+/* number of ticks it takes to step through amount, counted with the same
+   float arithmetic the old state machine used so the timing matches it,
+   0.75 takes 51 steps of 0.015 rather than 50 */
+static int get_steps(float amount, float step)
+{
+	int steps = 0;
+
+	while(amount > 0.0)
+	{
+		amount -= step;
+		steps++;
+	}
+	return steps;
+}
+
+/* the launch velocity is the smallest multiple of the friction whose
+   triangular sum covers the distance: friction * n * (n + 1) / 2 >= distance */
+static float get_punch_velocity(float distance, float friction)
+{
+	int n = ceil((sqrt(1.0 + 8.0 * distance / friction) - 1.0) / 2.0 - _T3LOGO_EPSILON);
+
+	return n * friction;
+}
+
+/* position after step ticks of launching at the punch velocity and slowing
+   down by the friction each tick */
+static float get_spin_position(float start, float distance, int step)
+{
+	float friction = get_acceleration(distance, _T3LOGO_SPIN_TICKS);
+	float v = get_punch_velocity(distance, friction);
+
+	return start + v * step - friction * step * (step - 1) / 2.0;
+}
+
+T3LOGO * t3logo_create(int flags)
+{
+	T3LOGO * lp;
+
+	lp = malloc(sizeof(T3LOGO));
+	if(!lp)
+	{
+		return NULL;
+	}
+	memset(lp, 0, sizeof(T3LOGO));
+	lp->logo_bitmap = al_load_bitmap("data/logo.png");
+	if(!lp->logo_bitmap)
+	{
+		goto fail;
+	}
+	lp->logo_outline_bitmap = al_load_bitmap("data/logo_outline.png");
+	if(!lp->logo_outline_bitmap)
+	{
+		goto fail;
+	}
+	if(!(flags & T3LOGO_FLAG_SILENT))
+	{
+		lp->logo_bump_sound = al_load_sample("data/movefail.wav");
+		if(!lp->logo_bump_sound)
+		{
+			goto fail;
+		}
+		lp->logo_click_sound = al_load_sample("data/ncd.wav");
+		if(!lp->logo_click_sound)
+		{
+			goto fail;
+		}
+	}
+	lp->light_ramp = t3f_create_light_ramp(_T3LOGO_BASE_COLOR, _T3LOGO_LIGHT_ANGLE, _T3LOGO_AMBIENT, T3F_LIGHT_RAMP_DEFAULT_STEPS);
+	if(!lp->light_ramp)
+	{
+		goto fail;
+	}
+	build_shapes(lp);
+	lp->x = t3f_virtual_display_width / 2;
+	lp->y = t3f_virtual_display_height / 2 + _T3LOGO_Y_OFFSET;
+	lp->flags = flags;
+	t3logo_reset(lp);
+	return lp;
+
+	fail:
+	{
+		t3logo_destroy(lp);
+	}
+	return NULL;
+}
+
+void t3logo_destroy(T3LOGO * lp)
+{
+	if(lp->light_ramp)
+	{
+		t3f_destroy_light_ramp(lp->light_ramp);
+	}
+	if(lp->logo_click_sound)
+	{
+		al_destroy_sample(lp->logo_click_sound);
+	}
+	if(lp->logo_bump_sound)
+	{
+		al_destroy_sample(lp->logo_bump_sound);
+	}
+	if(lp->logo_outline_bitmap)
+	{
+		al_destroy_bitmap(lp->logo_outline_bitmap);
+	}
+	if(lp->logo_bitmap)
+	{
+		al_destroy_bitmap(lp->logo_bitmap);
+	}
+	free(lp);
+}
+
+void t3logo_reset(T3LOGO * lp)
+{
+	lp->tick = 0;
+	lp->timeline.spin_tick = -1;
+	lp->timeline.exit_tick = -1;
+	lp->timeline.start_angle = 0.0;
+	lp->timeline.start_tilt = 0.0;
+	if(lp->flags & T3LOGO_FLAG_AUTO)
+	{
+		/* triggers happen on the tick after the wait has elapsed */
+		lp->timeline.spin_tick = _T3LOGO_AUTO_SPIN_TICK + 1;
+		lp->timeline.exit_tick = _T3LOGO_AUTO_EXIT_TICK + 1;
+	}
+	t3logo_seek(lp, 0);
+}
+
+/* transform the sides for the current angle and tilt and pack them, back to
+   front, into the buffer we hand to al_draw_prim() */
+void t3logo_update(T3LOGO * lp)
+{
+	float sin_angle = sin(lp->angle);
+	float cos_angle = cos(lp->angle);
+	int i, pos = 0;
+
+	lp->side[0].angle = lp->angle + ALLEGRO_PI / 2.0;
+	lp->side[1].angle = lp->angle + ALLEGRO_PI;
+	lp->side[2].angle = lp->angle + ALLEGRO_PI * 1.5;
+	for(i = 0; i < T3LOGO_SIDES; i++)
+	{
+		set_shape_orientation(&lp->side[i], lp->light_ramp, lp->x, lp->y, sin_angle, cos_angle, lp->tilt, _T3LOGO_SCALE);
+	}
+	sort_sides(lp);
+	for(i = 0; i < T3LOGO_SIDES; i++)
+	{
+		memcpy(&lp->render_vertex[pos], lp->side_zsort[i]->transformed_vertex, sizeof(ALLEGRO_VERTEX) * lp->side_zsort[i]->vertex_count);
+		pos += lp->side_zsort[i]->vertex_count;
+	}
+}
+
+/* work out the whole state of the animation at any tick without stepping
+   through the ticks before it */
+void t3logo_state_at(const T3LOGO_TIMELINE * tp, int tick, T3LOGO_FRAME * fp)
+{
+	int fade_ticks = get_steps(1.0, _T3LOGO_FADE_IN);
+	int flash_ticks = get_steps(_T3LOGO_FLASH_ALPHA, _T3LOGO_FADE_IN);
+	int spin_steps = _T3LOGO_SPIN_TICKS + _T3LOGO_SPIN_SETTLE_TICKS;
+	int spin_tick, outline_tick, flash_tick, done_tick, exit_tick;
+
+	memset(fp, 0, sizeof(T3LOGO_FRAME));
+	fp->angle = tp->start_angle;
+	fp->tilt = tp->start_tilt;
+
+	if(tick < fade_ticks)
+	{
+		fp->state = T3LOGO_STATE_FADE_IN;
+		fp->fade = 1.0 - _T3LOGO_FADE_IN * tick;
+		return;
+	}
+
+	/* the spin can't be triggered until the fade in is over */
+	spin_tick = tp->spin_tick;
+	if(spin_tick >= 0 && spin_tick <= fade_ticks)
+	{
+		spin_tick = fade_ticks + 1;
+	}
+	if(spin_tick < 0 || tick < spin_tick)
+	{
+		fp->state = T3LOGO_STATE_WAIT;
+		return;
+	}
+	if(tick <= spin_tick + spin_steps)
+	{
+		fp->state = T3LOGO_STATE_SPIN;
+		if(tick == spin_tick)
+		{
+			fp->cues |= T3LOGO_CUE_BUMP;
+		}
+		fp->angle = get_spin_position(tp->start_angle, _T3LOGO_TARGET_ANGLE, tick - spin_tick);
+		fp->tilt = get_spin_position(tp->start_tilt, _T3LOGO_TARGET_TILT, tick - spin_tick);
+		return;
+	}
+
+	/* the spin snaps to the target orientation when it settles */
+	fp->angle = _T3LOGO_TARGET_ANGLE;
+	fp->tilt = _T3LOGO_TARGET_TILT;
+	outline_tick = spin_tick + spin_steps + 1;
+	if(tick < outline_tick + fade_ticks)
+	{
+		fp->state = T3LOGO_STATE_FADE_OUTLINE;
+		if(tick == outline_tick)
+		{
+			fp->cues |= T3LOGO_CUE_CLICK;
+		}
+		fp->logo_fade = _T3LOGO_FADE_IN * (tick - outline_tick);
+		return;
+	}
+	fp->logo_fade = 1.0;
+	flash_tick = outline_tick + fade_ticks;
+	if(tick < flash_tick + flash_ticks)
+	{
+		fp->state = T3LOGO_STATE_FADE_FLASH;
+		fp->logo_overlay_fade = _T3LOGO_FLASH_ALPHA - _T3LOGO_FADE_IN * (tick - flash_tick);
+		return;
+	}
+
+	/* the fade out can't be triggered until the flash is over */
+	done_tick = flash_tick + flash_ticks;
+	exit_tick = tp->exit_tick;
+	if(exit_tick >= 0 && exit_tick <= done_tick)
+	{
+		exit_tick = done_tick + 1;
+	}
+	if(exit_tick < 0 || tick < exit_tick)
+	{
+		fp->state = T3LOGO_STATE_DONE;
+		return;
+	}
+	fp->state = T3LOGO_STATE_FADE_OUT;
+	fp->fade = _T3LOGO_FADE_IN * (tick - exit_tick);
+	if(fp->fade > 1.0)
+	{
+		fp->fade = 1.0;
+	}
+}
+
+/* returns true if anything that affects the rendered image changed */
+static bool apply_frame(T3LOGO * lp, T3LOGO_FRAME * fp, bool force_update)
+{
+	bool moved = fp->angle != lp->angle || fp->tilt != lp->tilt;
+	bool changed = moved || fp->fade != lp->fade || fp->logo_fade != lp->logo_fade || fp->logo_overlay_fade != lp->logo_overlay_fade;
+
+	lp->state = fp->state;
+	lp->fade = fp->fade;
+	lp->logo_fade = fp->logo_fade;
+	lp->logo_overlay_fade = fp->logo_overlay_fade;
+	lp->angle = fp->angle;
+	lp->tilt = fp->tilt;
+	if(moved || force_update)
+	{
+		t3logo_update(lp);
+	}
+	return changed;
+}
+
+/* jump straight to the given tick, sound cues are not played */
+void t3logo_seek(T3LOGO * lp, int tick)
+{
+	T3LOGO_FRAME frame;
+
+	lp->tick = tick;
+	t3logo_state_at(&lp->timeline, tick, &frame);
+	apply_frame(lp, &frame, true);
+}
+
+/* returns false if the logo looks the same as it did last tick */
+bool t3logo_logic(T3LOGO * lp)
+{
+	T3LOGO_FRAME frame;
+
+	lp->tick++;
+
+	/* input only decides when the spin and fade out start */
+	switch(lp->state)
+	{
+		case T3LOGO_STATE_WAIT:
+		{
+			if(t3f_key[ALLEGRO_KEY_SPACE])
+			{
+				if(lp->timeline.spin_tick < 0 || lp->timeline.spin_tick > lp->tick)
+				{
+					lp->timeline.spin_tick = lp->tick;
+				}
+				t3f_key[ALLEGRO_KEY_SPACE] = 0;
+			}
+			break;
+		}
+		case T3LOGO_STATE_DONE:
+		{
+			if(t3f_key[ALLEGRO_KEY_R])
+			{
+				t3logo_reset(lp);
+				t3f_key[ALLEGRO_KEY_R] = 0;
+				return true;
+			}
+			else if(t3f_key_pressed())
+			{
+				t3f_clear_keys();
+				if(lp->timeline.exit_tick < 0 || lp->timeline.exit_tick > lp->tick)
+				{
+					lp->timeline.exit_tick = lp->tick;
+				}
+			}
+			break;
+		}
+	}
+
+	t3logo_state_at(&lp->timeline, lp->tick, &frame);
+	if((frame.cues & T3LOGO_CUE_BUMP) && lp->logo_bump_sound)
+	{
+		t3f_play_sample(lp->logo_bump_sound, 1.0, 0.0, 1.0);
+	}
+	if((frame.cues & T3LOGO_CUE_CLICK) && lp->logo_click_sound)
+	{
+		t3f_play_sample(lp->logo_click_sound, 1.0, 0.0, 1.0);
+	}
+	if(frame.state == T3LOGO_STATE_DONE && lp->state != T3LOGO_STATE_DONE)
+	{
+		t3f_clear_keys();
+	}
+	return apply_frame(lp, &frame, false);
+}
+
+void t3logo_render(T3LOGO * lp)
+{
+	float bx = lp->x - _T3LOGO_BITMAP_SIZE / 2;
+	float by = lp->y - _T3LOGO_BITMAP_SIZE / 2 - 42;
+
+	al_draw_prim(lp->render_vertex, NULL, NULL, 0, lp->vertex_count, ALLEGRO_PRIM_TRIANGLE_LIST);
+	t3f_draw_scaled_bitmap(lp->logo_bitmap, al_map_rgba_f(lp->logo_fade, lp->logo_fade, lp->logo_fade, lp->logo_fade), bx, by, 0, _T3LOGO_BITMAP_SIZE, _T3LOGO_BITMAP_SIZE, 0);
+	t3f_draw_scaled_bitmap(lp->logo_outline_bitmap, al_map_rgba_f(lp->logo_overlay_fade, lp->logo_overlay_fade, lp->logo_overlay_fade, lp->logo_overlay_fade), bx, by, 0, _T3LOGO_BITMAP_SIZE, _T3LOGO_BITMAP_SIZE, 0);
+	al_draw_filled_rectangle(0, 0, t3f_virtual_display_width, t3f_virtual_display_height, al_map_rgba_f(0.0, 0.0, 0.0, lp->fade));
+}
+
+/* the fade out has finished and the logo is fully covered */
+bool t3logo_done(T3LOGO * lp)
+{
+	return lp->state == T3LOGO_STATE_FADE_OUT && lp->fade >= 1.0;
+}
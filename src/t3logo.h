@@ -0,0 +1,128 @@
+#ifndef T3LOGO_H
+#define T3LOGO_H
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+#include "t3f/t3f.h"
+
+#define T3LOGO_MAX_VERTICES 64
+#define T3LOGO_SIDES         3
+
+#define T3LOGO_STATE_FADE_IN      0
+#define T3LOGO_STATE_WAIT         1
+#define T3LOGO_STATE_SPIN         2
+#define T3LOGO_STATE_FADE_OUTLINE 3
+#define T3LOGO_STATE_FADE_FLASH   4
+#define T3LOGO_STATE_DONE         5
+#define T3LOGO_STATE_FADE_OUT     6
+
+/* advance through the animation on a timer instead of waiting for input */
+#define T3LOGO_FLAG_AUTO   1
+
+/* don't load or play the sound effects */
+#define T3LOGO_FLAG_SILENT 2
+
+/* sounds which start on a given tick */
+#define T3LOGO_CUE_BUMP  1
+#define T3LOGO_CUE_CLICK 2
+
+/* the only things which aren't fixed in the animation are when the spin and
+   the fade out start, everything else is derived from these and the tick */
+typedef struct
+{
+
+	int spin_tick; // tick the spin starts on, -1 if it hasn't been triggered
+	int exit_tick; // tick the fade out starts on, -1 if it hasn't been triggered
+	float start_angle;
+	float start_tilt;
+
+} T3LOGO_TIMELINE;
+
+/* everything needed to draw the logo at a given tick */
+typedef struct
+{
+
+	int state;
+	float fade;
+	float logo_fade;
+	float logo_overlay_fade;
+	float angle;
+	float tilt;
+	int cues;
+
+} T3LOGO_FRAME;
+
+/* vertex with its position in the XZ plane stored in polar form so the shape
+   can be spun around the Y axis without calling atan2()/hypot() each tick */
+typedef struct
+{
+
+	float x, y, z;
+	float angle;
+	float distance;
+	float sin_distance;
+	float cos_distance;
+
+} T3LOGO_VERTEX;
+
+/* shape constructed of triplets of vertices */
+typedef struct
+{
+
+	T3LOGO_VERTEX vertex[T3LOGO_MAX_VERTICES];
+	int vertex_count;
+
+	ALLEGRO_VERTEX * transformed_vertex; // points into the logo's batch buffer
+	ALLEGRO_COLOR color;
+	float z_depth;
+	float angle;
+
+} T3LOGO_SHAPE;
+
+typedef struct
+{
+
+	ALLEGRO_BITMAP * logo_bitmap;
+	ALLEGRO_BITMAP * logo_outline_bitmap;
+	ALLEGRO_SAMPLE * logo_bump_sound;
+	ALLEGRO_SAMPLE * logo_click_sound;
+
+	T3F_LIGHT_RAMP * light_ramp;
+	T3LOGO_SHAPE side[T3LOGO_SIDES];
+	T3LOGO_SHAPE * side_zsort[T3LOGO_SIDES];
+
+	/* all sides are transformed into one buffer so they render in one call */
+	ALLEGRO_VERTEX vertex[T3LOGO_SIDES * T3LOGO_MAX_VERTICES];
+	ALLEGRO_VERTEX render_vertex[T3LOGO_SIDES * T3LOGO_MAX_VERTICES];
+	int vertex_count;
+
+	float x, y;
+	float fade;
+	float logo_fade;
+	float logo_overlay_fade;
+	float angle;
+	float tilt;
+	int state;
+	T3LOGO_TIMELINE timeline;
+	int tick;
+	int flags;
+
+} T3LOGO;
+
+T3LOGO * t3logo_create(int flags);
+void t3logo_destroy(T3LOGO * lp);
+void t3logo_reset(T3LOGO * lp);
+void t3logo_update(T3LOGO * lp);
+void t3logo_state_at(const T3LOGO_TIMELINE * tp, int tick, T3LOGO_FRAME * fp);
+void t3logo_seek(T3LOGO * lp, int tick);
+bool t3logo_logic(T3LOGO * lp);
+void t3logo_render(T3LOGO * lp);
+bool t3logo_done(T3LOGO * lp);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif
@@ -0,0 +1,374 @@
+/* asset pack builder
+
+   usage: t3f-pack [-a alignment] [-z] output.pak path [path ...]
+
+   directories are added recursively, entry names are the paths as given with
+   forward slashes so pack from the directory the game runs in, -z deflates
+   entries that get smaller (needs a build with -DT3F_PACK_ZLIB) */
+
+#include "t3f/t3f.h"
+
+#ifdef T3F_PACK_ZLIB
+	#include <zlib.h>
+#endif
+
+typedef struct
+{
+
+	char * name;
+	uint32_t hash;
+	uint32_t name_offset;
+	uint32_t flags;
+	uint64_t offset;
+	uint64_t stored_size;
+	uint64_t size;
+
+} PACK_ENTRY;
+
+static PACK_ENTRY * pack_entry = NULL;
+static int pack_entries = 0;
+static int pack_entry_size = 0;
+
+static bool add_entry(const char * name)
+{
+	PACK_ENTRY * new_entry;
+	int i;
+
+	if(pack_entries >= pack_entry_size)
+	{
+		new_entry = realloc(pack_entry, sizeof(PACK_ENTRY) * (pack_entry_size ? pack_entry_size * 2 : 256));
+		if(!new_entry)
+		{
+			return false;
+		}
+		pack_entry = new_entry;
+		pack_entry_size = pack_entry_size ? pack_entry_size * 2 : 256;
+	}
+	memset(&pack_entry[pack_entries], 0, sizeof(PACK_ENTRY));
+	while(name[0] == '.' && (name[1] == '/' || name[1] == '\\'))
+	{
+		name += 2;
+	}
+	pack_entry[pack_entries].name = strdup(name);
+	if(!pack_entry[pack_entries].name)
+	{
+		return false;
+	}
+	for(i = 0; pack_entry[pack_entries].name[i]; i++)
+	{
+		if(pack_entry[pack_entries].name[i] == '\\')
+		{
+			pack_entry[pack_entries].name[i] = '/';
+		}
+	}
+	pack_entries++;
+	return true;
+}
+
+static bool add_path(const char * path)
+{
+	ALLEGRO_FS_ENTRY * dir;
+	ALLEGRO_FS_ENTRY * entry;
+	bool ret = true;
+
+	dir = al_create_fs_entry(path);
+	if(!dir || !al_fs_entry_exists(dir))
+	{
+		printf("Can't find %s!\n", path);
+		if(dir)
+		{
+			al_destroy_fs_entry(dir);
+		}
+		return false;
+	}
+	if(!(al_get_fs_entry_mode(dir) & ALLEGRO_FILEMODE_ISDIR))
+	{
+		al_destroy_fs_entry(dir);
+		return add_entry(path);
+	}
+	if(!al_open_directory(dir))
+	{
+		al_destroy_fs_entry(dir);
+		return false;
+	}
+	while(ret && (entry = al_read_directory(dir)))
+	{
+		ret = add_path(al_get_fs_entry_name(entry));
+		al_destroy_fs_entry(entry);
+	}
+	al_close_directory(dir);
+	al_destroy_fs_entry(dir);
+	return ret;
+}
+
+static int entry_sorter(const void * e1, const void * e2)
+{
+	return strcmp(((const PACK_ENTRY *)e1)->name, ((const PACK_ENTRY *)e2)->name);
+}
+
+static bool pad_to(ALLEGRO_FILE * fp, int alignment)
+{
+	while(al_ftell(fp) % alignment)
+	{
+		if(al_fputc(fp, 0) == EOF)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/* write the entry's data, compressed if that saves enough to be worth it */
+static bool write_entry_data(ALLEGRO_FILE * fp, PACK_ENTRY * ep, bool compress)
+{
+	ALLEGRO_FILE * efp;
+	unsigned char * data = NULL;
+	unsigned char * out = NULL;
+	int64_t size;
+
+	efp = al_fopen(ep->name, "rb");
+	if(!efp)
+	{
+		printf("Can't open %s!\n", ep->name);
+		return false;
+	}
+	size = al_fsize(efp);
+	if(size < 0)
+	{
+		goto fail;
+	}
+	data = malloc(size ? size : 1);
+	if(!data || al_fread(efp, data, size) != size)
+	{
+		goto fail;
+	}
+	al_fclose(efp);
+	efp = NULL;
+	ep->size = size;
+	ep->stored_size = size;
+	out = data;
+
+	#ifdef T3F_PACK_ZLIB
+
+		uLongf out_size = compressBound(size);
+		unsigned char * zdata;
+
+		if(compress && size > 0)
+		{
+			zdata = malloc(out_size);
+			if(zdata && compress2(zdata, &out_size, data, size, Z_BEST_COMPRESSION) == Z_OK && out_size < size - size / 8)
+			{
+				ep->flags |= T3F_PACK_ENTRY_DEFLATE;
+				ep->stored_size = out_size;
+				out = zdata;
+			}
+			else
+			{
+				free(zdata);
+			}
+		}
+
+	#endif
+
+	if(al_fwrite(fp, out, ep->stored_size) != ep->stored_size)
+	{
+		goto fail;
+	}
+	if(out != data)
+	{
+		free(out);
+	}
+	free(data);
+	return true;
+
+	fail:
+	{
+		printf("Failed to pack %s!\n", ep->name);
+		if(out && out != data)
+		{
+			free(out);
+		}
+		if(data)
+		{
+			free(data);
+		}
+		if(efp)
+		{
+			al_fclose(efp);
+		}
+		return false;
+	}
+}
+
+static bool write_pack(const char * fn, int alignment, bool compress)
+{
+	ALLEGRO_FILE * fp;
+	uint32_t * bucket;
+	uint32_t buckets = 1;
+	uint32_t toc_size;
+	uint32_t i, j;
+
+	/* keep the table at most half full so probes stay short */
+	while(buckets <= (uint32_t)pack_entries * 2)
+	{
+		buckets *= 2;
+	}
+	bucket = calloc(buckets, sizeof(uint32_t));
+	if(!bucket)
+	{
+		return false;
+	}
+	toc_size = T3F_PACK_HEADER_SIZE + buckets * 4 + pack_entries * T3F_PACK_ENTRY_SIZE;
+	for(i = 0; i < (uint32_t)pack_entries; i++)
+	{
+		pack_entry[i].hash = t3f_pack_hash(pack_entry[i].name);
+		pack_entry[i].name_offset = toc_size;
+		toc_size += strlen(pack_entry[i].name) + 1;
+		for(j = pack_entry[i].hash & (buckets - 1); bucket[j]; j = (j + 1) & (buckets - 1));
+		bucket[j] = i + 1;
+	}
+
+	fp = al_fopen(fn, "wb");
+	if(!fp)
+	{
+		free(bucket);
+		return false;
+	}
+	al_fwrite(fp, T3F_PACK_MAGIC, 4);
+	al_fwrite32le(fp, T3F_PACK_VERSION);
+	al_fwrite32le(fp, pack_entries);
+	al_fwrite32le(fp, buckets);
+	al_fwrite32le(fp, alignment);
+	al_fwrite32le(fp, toc_size);
+	al_fwrite32le(fp, 0);
+	al_fwrite32le(fp, 0);
+	for(i = 0; i < buckets; i++)
+	{
+		al_fwrite32le(fp, bucket[i]);
+	}
+	free(bucket);
+
+	/* entry records are filled in once the data has been written */
+	for(i = 0; i < (uint32_t)pack_entries * T3F_PACK_ENTRY_SIZE; i++)
+	{
+		al_fputc(fp, 0);
+	}
+	for(i = 0; i < (uint32_t)pack_entries; i++)
+	{
+		al_fwrite(fp, pack_entry[i].name, strlen(pack_entry[i].name) + 1);
+	}
+	for(i = 0; i < (uint32_t)pack_entries; i++)
+	{
+		if(!pad_to(fp, alignment))
+		{
+			goto fail;
+		}
+		pack_entry[i].offset = al_ftell(fp);
+		if(!write_entry_data(fp, &pack_entry[i], compress))
+		{
+			goto fail;
+		}
+	}
+	if(!al_fseek(fp, T3F_PACK_HEADER_SIZE + buckets * 4, ALLEGRO_SEEK_SET))
+	{
+		goto fail;
+	}
+	for(i = 0; i < (uint32_t)pack_entries; i++)
+	{
+		al_fwrite32le(fp, pack_entry[i].hash);
+		al_fwrite32le(fp, pack_entry[i].name_offset);
+		al_fwrite32le(fp, strlen(pack_entry[i].name));
+		al_fwrite32le(fp, pack_entry[i].flags);
+		al_fwrite32le(fp, pack_entry[i].offset);
+		al_fwrite32le(fp, pack_entry[i].offset >> 32);
+		al_fwrite32le(fp, pack_entry[i].stored_size);
+		al_fwrite32le(fp, pack_entry[i].stored_size >> 32);
+		al_fwrite32le(fp, pack_entry[i].size);
+		al_fwrite32le(fp, pack_entry[i].size >> 32);
+	}
+	if(al_ferror(fp))
+	{
+		goto fail;
+	}
+	return al_fclose(fp);
+
+	fail:
+	{
+		al_fclose(fp);
+		al_remove_filename(fn);
+		return false;
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	const char * out_fn = NULL;
+	int alignment = T3F_PACK_DEFAULT_ALIGNMENT;
+	bool compress = false;
+	uint64_t size = 0, stored_size = 0;
+	int i;
+
+	if(!al_init())
+	{
+		printf("Failed to initialize Allegro!\n");
+		return -1;
+	}
+	for(i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-a") && i < argc - 1)
+		{
+			alignment = atoi(argv[i + 1]);
+			if(alignment < 1)
+			{
+				printf("Invalid alignment!\n");
+				return -1;
+			}
+			i++;
+		}
+		else if(!strcmp(argv[i], "-z"))
+		{
+			#ifdef T3F_PACK_ZLIB
+				compress = true;
+			#else
+				printf("Built without zlib, entries will be stored.\n");
+			#endif
+		}
+		else if(!out_fn)
+		{
+			out_fn = argv[i];
+		}
+		else if(!add_path(argv[i]))
+		{
+			return -1;
+		}
+	}
+	if(!out_fn || !pack_entries)
+	{
+		printf("Usage: %s [-a alignment] [-z] output.pak path [path ...]\n", argv[0]);
+		return -1;
+	}
+
+	qsort(pack_entry, pack_entries, sizeof(PACK_ENTRY), entry_sorter);
+	for(i = 1; i < pack_entries; i++)
+	{
+		if(!strcmp(pack_entry[i - 1].name, pack_entry[i].name))
+		{
+			printf("%s added more than once!\n", pack_entry[i].name);
+			return -1;
+		}
+	}
+	if(!write_pack(out_fn, alignment, compress))
+	{
+		printf("Failed to write %s!\n", out_fn);
+		return -1;
+	}
+	for(i = 0; i < pack_entries; i++)
+	{
+		size += pack_entry[i].size;
+		stored_size += pack_entry[i].stored_size;
+		free(pack_entry[i].name);
+	}
+	free(pack_entry);
+	printf("Packed %d files, %llu bytes into %llu.\n", i, (unsigned long long)size, (unsigned long long)stored_size);
+	return 0;
+}